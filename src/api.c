@@ -10,6 +10,7 @@
 #include <SDL3/SDL.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include <wchar.h>
 
 #include "z8lua/lauxlib.h"
@@ -17,6 +18,7 @@
 #include "z8lua/fix32.h"
 #include "auxiliary.h"
 #include "app.h"
+#include "cart.h"
 #include "core.h"
 #include "memory.h"
 #include "p8scii.h"
@@ -38,6 +40,13 @@ static fix32_t seconds_since_start;
 uint32_t pico8_frame_start = 0;
 uint32_t pico8_frame_ms = 0;
 
+// Set by run(); core.c restarts the cart once the callback has unwound.
+bool pico8_run_requested = false;
+
+// Registry fields holding the compiled main chunk and its pristine globals.
+#define MAIN_CHUNK_KEY "open8.main_chunk"
+#define BASE_GLOBALS_KEY "open8.base_globals"
+
 // Touch button state (when SDL_HINT_MOUSE_TOUCH_EVENTS is used).
 uint8_t touch_button_state = 0;
 
@@ -498,53 +507,51 @@ static int pico8_coresume(lua_State* L)
     return 1 + nresults;
 }
 
+// The status names are upvalues of costatus, so that the collector never
+// frees them and asking for a status never has to intern a string.
+enum
+{
+    COSTATUS_SUSPENDED = 1,
+    COSTATUS_RUNNING,
+    COSTATUS_NORMAL,
+    COSTATUS_DEAD
+};
+
 static int pico8_costatus(lua_State* L)
 {
     lua_State* co = lua_tothread(L, 1);
-
-    if (!co)
-    {
-        lua_pushstring(L, "dead");
-        return 1;
-    }
+    int status = COSTATUS_DEAD;
 
     if (co == L)
     {
-        lua_pushstring(L, "running");
-        return 1;
+        status = COSTATUS_RUNNING;
     }
-
-    switch (lua_status(co))
+    else if (co)
     {
-        case LUA_YIELD:
-            lua_pushstring(L, "suspended");
-            break;
-
-        case LUA_OK:
+        switch (lua_status(co))
         {
-            lua_Debug ar;
+            case LUA_YIELD:
+                status = COSTATUS_SUSPENDED;
+                break;
 
-            if (lua_getstack(co, 0, &ar))
-            {
-                lua_pushstring(L, "normal");
-            }
-            else if (lua_gettop(co) == 0)
+            case LUA_OK:
             {
-                lua_pushstring(L, "dead");
-            }
-            else
-            {
-                lua_pushstring(L, "suspended");
-            }
+                lua_Debug ar;
 
-            break;
+                if (lua_getstack(co, 0, &ar))
+                {
+                    status = COSTATUS_NORMAL;
+                }
+                else if (lua_gettop(co) > 0)
+                {
+                    status = COSTATUS_SUSPENDED;
+                }
+                break;
+            }
         }
-
-        default:
-            lua_pushstring(L, "dead");
-            break;
     }
 
+    lua_pushvalue(L, lua_upvalueindex(status));
     return 1;
 }
 
@@ -581,6 +588,20 @@ static int pico8_stat(lua_State* L)
 
     switch (id)
     {
+        case 0:
+        {
+            // Lua memory in use, in KB, in Q16.16.
+            uint32_t kb = (uint32_t)lua_gc(L, LUA_GCCOUNT, 0);
+            uint32_t rem = (uint32_t)lua_gc(L, LUA_GCCOUNTB, 0);
+            if (kb > 0x7fff)
+            {
+                // Past 32 MB the value would overflow into the sign bit.
+                kb = 0x7fff;
+                rem = 1023;
+            }
+            lua_pushnumber(L, (lua_Number)((kb << 16) | (rem << 6)));
+            break;
+        }
         case 1:
         {
             // Return CPU usage as fraction [0,1].
@@ -609,6 +630,7 @@ static int pico8_stat(lua_State* L)
             }
             break;
         }
+        case 2: // System CPU usage, which isn't measured.
         case 26:
             lua_pushnumber(L, 0);
             break;
@@ -703,6 +725,29 @@ static int pico8_circ(lua_State* L)
     return 0;
 }
 
+static int pico8_circ_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    int cx = fix32_to_int(args[0]);
+    int cy = fix32_to_int(args[1]);
+
+    apply_camera_offset(&cx, &cy);
+
+    int radius = fix32_to_int(argc >= 3 ? args[2] : fix32_value(4, 0));
+    int color;
+
+    if (argc == 4)
+    {
+        color = fix32_to_int(args[3]);
+        draw_circle(cx, cy, radius, &color, false);
+    }
+    else
+    {
+        draw_circle(cx, cy, radius, NULL, false);
+    }
+
+    return LUA_FASTNONE;
+}
+
 static int pico8_circfill(lua_State* L)
 {
     int cx = fix32_to_int(luaL_checknumber(L, 1));
@@ -726,6 +771,29 @@ static int pico8_circfill(lua_State* L)
     return 0;
 }
 
+static int pico8_circfill_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    int cx = fix32_to_int(args[0]);
+    int cy = fix32_to_int(args[1]);
+
+    apply_camera_offset(&cx, &cy);
+
+    int radius = fix32_to_int(argc >= 3 ? args[2] : fix32_value(4, 0));
+    int color;
+
+    if (argc >= 4)
+    {
+        color = fix32_to_int(args[3]);
+        draw_circle(cx, cy, radius, &color, true);
+    }
+    else
+    {
+        draw_circle(cx, cy, radius, NULL, true);
+    }
+
+    return LUA_FASTNONE;
+}
+
 static int pico8_clip(lua_State* L)
 {
     TO_BE_DONE;
@@ -755,6 +823,12 @@ static int pico8_color(lua_State* L)
     return 0;
 }
 
+static int pico8_color_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    pico8_ram[0x5f25] = fix32_to_uint8(args[0]);
+    return LUA_FASTNONE;
+}
+
 static int pico8_cursor(lua_State* L)
 {
     pico8_ram[0x5f26] = fix32_to_uint8(luaL_checkunsigned(L, 1)); // X.
@@ -793,6 +867,22 @@ static int pico8_fget(lua_State* L)
     return 1;
 }
 
+static int pico8_fget_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    uint8_t n = (uint8_t)(args[0] >> 16);
+    uint8_t flags = pico8_ram[0x3000 + n];
+
+    if (argc >= 2)
+    {
+        int f = (int)(args[1] >> 16);
+        *res = (unsigned)f > 7 ? 0 : (flags >> f) & 1;
+        return LUA_FASTBOOLEAN;
+    }
+
+    *res = fix32_from_uint8(flags);
+    return LUA_FASTNUMBER;
+}
+
 static int pico8_fillp(lua_State* L)
 {
     uint32_t pattern = 0;
@@ -876,6 +966,28 @@ static int pico8_line(lua_State* L)
     return 0;
 }
 
+static int pico8_line_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    int x0 = fix32_to_int(args[0]);
+    int y0 = fix32_to_int(args[1]);
+    int x1 = fix32_to_int(args[2]);
+    int y1 = fix32_to_int(args[3]);
+
+    apply_camera_offset(&x0, &y0);
+    apply_camera_offset(&x1, &y1);
+
+    if (argc == 5)
+    {
+        int color = fix32_to_int(args[4]);
+        draw_line(x0, y0, x1, y1, &color);
+    }
+    else
+    {
+        draw_line(x0, y0, x1, y1, NULL);
+    }
+    return LUA_FASTNONE;
+}
+
 static int pico8_oval(lua_State* L)
 {
     int x0 = fix32_to_int(luaL_checknumber(L, 1));
@@ -899,6 +1011,28 @@ static int pico8_oval(lua_State* L)
     return 0;
 }
 
+static int pico8_oval_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    int x0 = fix32_to_int(args[0]);
+    int y0 = fix32_to_int(args[1]);
+    int x1 = fix32_to_int(args[2]);
+    int y1 = fix32_to_int(args[3]);
+
+    apply_camera_offset(&x0, &y0);
+    apply_camera_offset(&x1, &y1);
+
+    if (argc == 5)
+    {
+        int color = fix32_to_int(args[4]);
+        draw_oval(x0, y0, x1, y1, &color, false);
+    }
+    else
+    {
+        draw_oval(x0, y0, x1, y1, NULL, false);
+    }
+    return LUA_FASTNONE;
+}
+
 static int pico8_ovalfill(lua_State* L)
 {
     int x0 = fix32_to_int(luaL_checknumber(L, 1));
@@ -922,6 +1056,42 @@ static int pico8_ovalfill(lua_State* L)
     return 0;
 }
 
+static int pico8_ovalfill_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    int x0 = fix32_to_int(args[0]);
+    int y0 = fix32_to_int(args[1]);
+    int x1 = fix32_to_int(args[2]);
+    int y1 = fix32_to_int(args[3]);
+
+    apply_camera_offset(&x0, &y0);
+    apply_camera_offset(&x1, &y1);
+
+    if (argc == 5)
+    {
+        int color = fix32_to_int(args[4]);
+        draw_oval(x0, y0, x1, y1, &color, true);
+    }
+    else
+    {
+        draw_oval(x0, y0, x1, y1, NULL, true);
+    }
+    return LUA_FASTNONE;
+}
+
+static void pal_map(int c0, int c1, int p)
+{
+    if (p == 1)
+    {
+        // Display palette remap (0x5f10).
+        pico8_ram[0x5f10 + c0] = (pico8_ram[0x5f10 + c0] & 0xF0) | (uint8_t)c1;
+    }
+    else
+    {
+        // Draw palette remap (0x5f00), preserve transparency bit.
+        pico8_ram[0x5f00 + c0] = (pico8_ram[0x5f00 + c0] & 0xF0) | (uint8_t)c1;
+    }
+}
+
 static int pico8_pal(lua_State* L)
 {
     int argc = lua_gettop(L);
@@ -985,21 +1155,22 @@ static int pico8_pal(lua_State* L)
         }
         int p = fix32_to_int(luaL_optnumber(L, 3, 0));
 
-        if (p == 1)
-        {
-            // Display palette remap (0x5f10).
-            pico8_ram[0x5f10 + c0] = (pico8_ram[0x5f10 + c0] & 0xF0) | (uint8_t)c1;
-        }
-        else
-        {
-            // Draw palette remap (0x5f00), preserve transparency bit.
-            pico8_ram[0x5f00 + c0] = (pico8_ram[0x5f00 + c0] & 0xF0) | (uint8_t)c1;
-        }
+        pal_map(c0, c1, p);
     }
 
     return 0;
 }
 
+static int pico8_pal_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    int c0 = fix32_to_int(args[0]) & 0x0F;
+    int c1 = fix32_to_int(args[1]) & 0x0F;
+    int p = (argc >= 3) ? fix32_to_int(args[2]) : 0;
+
+    pal_map(c0, c1, p);
+    return LUA_FASTNONE;
+}
+
 static int pico8_palt(lua_State* L)
 {
     int argc = lua_gettop(L);
@@ -1042,9 +1213,26 @@ static int pico8_pget(lua_State* L)
     return 1;
 }
 
+static int pico8_pget_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    *res = fix32_from_int(pget(fix32_to_int32(args[0]), fix32_to_int32(args[1])));
+    return LUA_FASTNUMBER;
+}
+
 static int pico8_print(lua_State* L)
 {
-    const char* text = luaL_checkstring(L, 1);
+    // Numbers are formatted on the stack; converting the argument in place
+    // would allocate a string for every score printed.
+    char number[LUAI_MAXNUMBER2STR];
+    const char* text = number;
+    if (lua_type(L, 1) == LUA_TNUMBER)
+    {
+        lua_number2str(number, lua_tonumber(L, 1));
+    }
+    else
+    {
+        text = luaL_checkstring(L, 1);
+    }
     int argc = lua_gettop(L);
     uint8_t cursor_x = pico8_ram[0x5f26];
     uint8_t x_cursor = cursor_x;
@@ -1128,6 +1316,26 @@ static int pico8_pset(lua_State* L)
     return 0;
 }
 
+static int pico8_pset_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    int x = (int)fix32_to_int32(args[0]);
+    int y = (int)fix32_to_int32(args[1]);
+
+    apply_camera_offset(&x, &y);
+
+    if (argc == 3)
+    {
+        int color = (int)fix32_to_int32(args[2]);
+        pset(x, y, &color);
+    }
+    else
+    {
+        pset(x, y, NULL);
+    }
+
+    return LUA_FASTNONE;
+}
+
 static int pico8_rect(lua_State* L)
 {
     int x0 = fix32_to_int(luaL_checknumber(L, 1));
@@ -1151,6 +1359,29 @@ static int pico8_rect(lua_State* L)
     return 0;
 }
 
+static int pico8_rect_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    int x0 = fix32_to_int(args[0]);
+    int y0 = fix32_to_int(args[1]);
+    int x1 = fix32_to_int(args[2]);
+    int y1 = fix32_to_int(args[3]);
+
+    apply_camera_offset(&x0, &y0);
+    apply_camera_offset(&x1, &y1);
+
+    if (argc == 5)
+    {
+        int color = fix32_to_int(args[4]);
+        draw_rect(x0, y0, x1, y1, &color, false);
+    }
+    else
+    {
+        draw_rect(x0, y0, x1, y1, NULL, false);
+    }
+
+    return LUA_FASTNONE;
+}
+
 static int pico8_rectfill(lua_State* L)
 {
     int x0 = fix32_to_int(luaL_checknumber(L, 1));
@@ -1174,19 +1405,54 @@ static int pico8_rectfill(lua_State* L)
     return 0;
 }
 
-static int pico8_sget(lua_State* L)
+static int pico8_rectfill_fast(const fix32_t* args, int argc, fix32_t* res)
 {
-    int x = fix32_to_int32(luaL_checknumber(L, 1)) & 0x7F;
-    int y = fix32_to_int32(luaL_checknumber(L, 2)) & 0x7F;
+    int x0 = fix32_to_int(args[0]);
+    int y0 = fix32_to_int(args[1]);
+    int x1 = fix32_to_int(args[2]);
+    int y1 = fix32_to_int(args[3]);
+
+    apply_camera_offset(&x0, &y0);
+    apply_camera_offset(&x1, &y1);
+
+    if (argc == 5)
+    {
+        int color = fix32_to_int(args[4]);
+        draw_rect(x0, y0, x1, y1, &color, true);
+    }
+    else
+    {
+        draw_rect(x0, y0, x1, y1, NULL, true);
+    }
+
+    return LUA_FASTNONE;
+}
+
+static uint8_t sget(int x, int y)
+{
+    x &= 0x7F;
+    y &= 0x7F;
 
     uint16_t addr = (uint16_t)(y << 6) + (uint16_t)(x >> 1);
     uint8_t byte = pico8_ram[addr];
-    uint8_t color = (x & 1) ? (byte >> 4) : (byte & 0x0F);
+    return (x & 1) ? (byte >> 4) : (byte & 0x0F);
+}
 
-    lua_pushunsigned(L, fix32_value(color, 0));
+static int pico8_sget(lua_State* L)
+{
+    int x = fix32_to_int32(luaL_checknumber(L, 1));
+    int y = fix32_to_int32(luaL_checknumber(L, 2));
+
+    lua_pushunsigned(L, fix32_value(sget(x, y), 0));
     return 1;
 }
 
+static int pico8_sget_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    *res = fix32_value(sget(fix32_to_int32(args[0]), fix32_to_int32(args[1])), 0);
+    return LUA_FASTNUMBER;
+}
+
 static void draw_sprite_n(uint8_t n, int32_t x, int32_t y, uint8_t w, uint8_t h, bool flip_x, bool flip_y)
 {
     int32_t width = w * 8;
@@ -1273,29 +1539,34 @@ static int pico8_spr(lua_State* L)
     return 0;
 }
 
+static int pico8_spr_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    // Numbers are truthy, so any flip argument present turns flipping on.
+    uint8_t n = fix32_to_uint8(args[0]);
+    int32_t x = (argc >= 2) ? fix32_to_int32(args[1]) : 0;
+    int32_t y = (argc >= 3) ? fix32_to_int32(args[2]) : 0;
+    uint8_t w = fix32_to_uint8((argc >= 4) ? args[3] : fix32_value(1, 0));
+    uint8_t h = fix32_to_uint8((argc >= 5) ? args[4] : fix32_value(1, 0));
+
+    apply_camera_offset((int*)&x, (int*)&y);
+
+    draw_sprite_n(n, x, y, w, h, argc >= 6, argc >= 7);
+
+    return LUA_FASTNONE;
+}
+
 static int pico8_sset(lua_State* L)
 {
     TO_BE_DONE;
 }
 
-static int pico8_sspr(lua_State* L)
+static void draw_sspr(int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh, bool flip_x, bool flip_y)
 {
-    int sx = fix32_to_int(luaL_checknumber(L, 1));
-    int sy = fix32_to_int(luaL_checknumber(L, 2));
-    int sw = fix32_to_int(luaL_checknumber(L, 3));
-    int sh = fix32_to_int(luaL_checknumber(L, 4));
-    int dx = fix32_to_int(luaL_checknumber(L, 5));
-    int dy = fix32_to_int(luaL_checknumber(L, 6));
-    int dw = fix32_to_int(luaL_optnumber(L, 7, fix32_from_int(sw)));
-    int dh = fix32_to_int(luaL_optnumber(L, 8, fix32_from_int(sh)));
-    bool flip_x = lua_toboolean(L, 9);
-    bool flip_y = lua_toboolean(L, 10);
-
-    apply_camera_offset((int*)&dx, (int*)&dy);
+    apply_camera_offset(&dx, &dy);
 
     if (sw <= 0 || sh <= 0 || dw == 0 || dh == 0)
     {
-        return 0;
+        return;
     }
 
     // Negative dw/dh: PICO-8 treats them as a flip + draw with abs size.
@@ -1352,10 +1623,40 @@ static int pico8_sspr(lua_State* L)
             }
         }
     }
+}
+
+static int pico8_sspr(lua_State* L)
+{
+    int sx = fix32_to_int(luaL_checknumber(L, 1));
+    int sy = fix32_to_int(luaL_checknumber(L, 2));
+    int sw = fix32_to_int(luaL_checknumber(L, 3));
+    int sh = fix32_to_int(luaL_checknumber(L, 4));
+    int dx = fix32_to_int(luaL_checknumber(L, 5));
+    int dy = fix32_to_int(luaL_checknumber(L, 6));
+    int dw = fix32_to_int(luaL_optnumber(L, 7, fix32_from_int(sw)));
+    int dh = fix32_to_int(luaL_optnumber(L, 8, fix32_from_int(sh)));
+    bool flip_x = lua_toboolean(L, 9);
+    bool flip_y = lua_toboolean(L, 10);
+
+    draw_sspr(sx, sy, sw, sh, dx, dy, dw, dh, flip_x, flip_y);
 
     return 0;
 }
 
+static int pico8_sspr_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    int sw = fix32_to_int(args[2]);
+    int sh = fix32_to_int(args[3]);
+    int dw = (argc >= 7) ? fix32_to_int(args[6]) : sw;
+    int dh = (argc >= 8) ? fix32_to_int(args[7]) : sh;
+
+    // Flipped calls pass booleans, so they always go through pico8_sspr.
+    draw_sspr(fix32_to_int(args[0]), fix32_to_int(args[1]), sw, sh,
+        fix32_to_int(args[4]), fix32_to_int(args[5]), dw, dh, false, false);
+
+    return LUA_FASTNONE;
+}
+
 static int pico8_tline(lua_State* L)
 {
     TO_BE_DONE;
@@ -1395,22 +1696,9 @@ static void map_set(int col, int row, uint8_t sprite)
     }
 }
 
-static int pico8_map(lua_State* L)
+static void draw_map(int celx, int cely, int sx, int sy, int celw, int celh, uint8_t layer)
 {
-    int celx = fix32_to_int(luaL_optnumber(L, 1, 0));
-    int cely = fix32_to_int(luaL_optnumber(L, 2, 0));
-    int sx = fix32_to_int(luaL_optnumber(L, 3, 0));
-    int sy = fix32_to_int(luaL_optnumber(L, 4, 0));
-    int celw = fix32_to_int(luaL_optnumber(L, 5, fix32_value(128, 0)));
-    int celh = fix32_to_int(luaL_optnumber(L, 6, fix32_value(64, 0)));
-    uint8_t layer = 0;
-
-    apply_camera_offset((int*)&sx, (int*)&sy);
-
-    if (lua_gettop(L) >= 7)
-    {
-        layer = (uint8_t)fix32_to_uint32(luaL_checknumber(L, 7));
-    }
+    apply_camera_offset(&sx, &sy);
 
     for (int ty = 0; ty < celh; ty++)
     {
@@ -1431,10 +1719,43 @@ static int pico8_map(lua_State* L)
             draw_sprite_n(sprite, sx + tx * 8, sy + ty * 8, 1, 1, false, false);
         }
     }
+}
+
+static int pico8_map(lua_State* L)
+{
+    int celx = fix32_to_int(luaL_optnumber(L, 1, 0));
+    int cely = fix32_to_int(luaL_optnumber(L, 2, 0));
+    int sx = fix32_to_int(luaL_optnumber(L, 3, 0));
+    int sy = fix32_to_int(luaL_optnumber(L, 4, 0));
+    int celw = fix32_to_int(luaL_optnumber(L, 5, fix32_value(128, 0)));
+    int celh = fix32_to_int(luaL_optnumber(L, 6, fix32_value(64, 0)));
+    uint8_t layer = 0;
+
+    if (lua_gettop(L) >= 7)
+    {
+        layer = (uint8_t)fix32_to_uint32(luaL_checknumber(L, 7));
+    }
+
+    draw_map(celx, cely, sx, sy, celw, celh, layer);
 
     return 0;
 }
 
+static int pico8_map_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    int celx = (argc >= 1) ? fix32_to_int(args[0]) : 0;
+    int cely = (argc >= 2) ? fix32_to_int(args[1]) : 0;
+    int sx = (argc >= 3) ? fix32_to_int(args[2]) : 0;
+    int sy = (argc >= 4) ? fix32_to_int(args[3]) : 0;
+    int celw = (argc >= 5) ? fix32_to_int(args[4]) : 128;
+    int celh = (argc >= 6) ? fix32_to_int(args[5]) : 64;
+    uint8_t layer = (argc >= 7) ? (uint8_t)fix32_to_uint32(args[6]) : 0;
+
+    draw_map(celx, cely, sx, sy, celw, celh, layer);
+
+    return LUA_FASTNONE;
+}
+
 static int pico8_mget(lua_State* L)
 {
     int col = (int)(lua_tonumber(L, 1) >> 16);
@@ -1443,6 +1764,12 @@ static int pico8_mget(lua_State* L)
     return 1;
 }
 
+static int pico8_mget_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    *res = fix32_from_uint8(map_get((int)(args[0] >> 16), (int)(args[1] >> 16)));
+    return LUA_FASTNUMBER;
+}
+
 static int pico8_mset(lua_State* L)
 {
     int col = fix32_to_int(luaL_checknumber(L, 1));
@@ -1452,6 +1779,12 @@ static int pico8_mset(lua_State* L)
     return 0;
 }
 
+static int pico8_mset_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    map_set(fix32_to_int(args[0]), fix32_to_int(args[1]), (uint8_t)fix32_to_uint32(args[2]));
+    return LUA_FASTNONE;
+}
+
 static int pico8_mapdraw(lua_State* L)
 {
     return pico8_map(L);
@@ -1516,6 +1849,21 @@ static int pico8_btn(lua_State* L)
     return 1;
 }
 
+static int pico8_btn_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    if (argc == 0)
+    {
+        *res = fix32_value(pico8_ram[0x5f4c], 0);
+        return LUA_FASTNUMBER;
+    }
+
+    int b = fix32_to_int(args[0]);
+    int p = (argc >= 2) ? fix32_to_int(args[1]) : 0;
+
+    *res = (unsigned)p <= 1 && (unsigned)b <= 5 && (pico8_ram[0x5f4c + p] & (1 << b)) != 0;
+    return LUA_FASTBOOLEAN;
+}
+
 // Test-only helper: set_btnp_frames(b, f [, p])
 // Sets btn_held_frames[p][b] = f so tests can exercise btnp repeat logic
 // without requiring a running emulator loop.
@@ -1533,22 +1881,34 @@ static int pico8_set_btnp_frames(lua_State* L)
     return 0;
 }
 
+// A button fires on the frame it is pressed, then every 4 frames after a
+// 15-frame delay.
+static bool btnp_fired(int p, int b)
+{
+    uint8_t f = btn_held_frames[p][b];
+    return f == 1 || (f > 15 && ((f - 15) % 4 == 0));
+}
+
+static uint8_t btnp_mask(void)
+{
+    uint8_t result = 0;
+    for (int b = 0; b < 6; b++)
+    {
+        if (btnp_fired(0, b))
+        {
+            result |= (1 << b);
+        }
+    }
+    return result;
+}
+
 static int pico8_btnp(lua_State* L)
 {
     int argc = lua_gettop(L);
 
     if (argc == 0)
     {
-        uint8_t result = 0;
-        for (int b = 0; b < 6; b++)
-        {
-            uint8_t f = btn_held_frames[0][b];
-            if (f == 1 || (f > 15 && ((f - 15) % 4 == 0)))
-            {
-                result |= (1 << b);
-            }
-        }
-        lua_pushunsigned(L, fix32_value(result, 0));
+        lua_pushunsigned(L, fix32_value(btnp_mask(), 0));
         return 1;
     }
 
@@ -1561,11 +1921,25 @@ static int pico8_btnp(lua_State* L)
         return 1;
     }
 
-    uint8_t f = btn_held_frames[p][b];
-    lua_pushboolean(L, f == 1 || (f > 15 && ((f - 15) % 4 == 0)));
+    lua_pushboolean(L, btnp_fired(p, b));
     return 1;
 }
 
+static int pico8_btnp_fast(const fix32_t* args, int argc, fix32_t* res)
+{
+    if (argc == 0)
+    {
+        *res = fix32_value(btnp_mask(), 0);
+        return LUA_FASTNUMBER;
+    }
+
+    int b = fix32_to_int(args[0]);
+    int p = (argc >= 2) ? fix32_to_int(args[1]) : 0;
+
+    *res = p >= 0 && p <= 1 && b >= 0 && b <= 5 && btnp_fired(p, b);
+    return LUA_FASTBOOLEAN;
+}
+
 // Math functions.
 
 // Special thanks to pancelor for documenting rnd() and srand()!
@@ -1650,14 +2024,61 @@ static int pico8_srand(lua_State* L)
 
 // Memory functions.
 
+// Other carts are looked up next to the bundled ones.  Like on PICO-8, the
+// extension may be left out.
+static const uint8_t* load_external_rom(const char* file_name)
+{
+    static const char* const extensions[] = { "", ".p8", ".p8.png", ".p8.rom" };
+    const uint8_t* rom = NULL;
+
+    // Only carts right in the carts directory can be read.
+    if (SDL_strstr(file_name, "..") || SDL_strpbrk(file_name, "/\\:"))
+    {
+        SDL_Log("reload(): invalid cart name %s", file_name);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < SDL_arraysize(extensions) && !rom; i++)
+    {
+        char* path;
+
+        if (i > 0 && get_cart_format(file_name) != CART_FORMAT_UNKNOWN)
+        {
+            break;
+        }
+
+        if (SDL_asprintf(&path, "%scarts/%s%s", SDL_GetBasePath(), file_name, extensions[i]) < 0)
+        {
+            return NULL;
+        }
+
+        if (get_cart_format(path) != CART_FORMAT_UNKNOWN && SDL_GetPathInfo(path, NULL))
+        {
+            rom = load_cart_rom(path);
+        }
+        SDL_free(path);
+    }
+
+    if (!rom)
+    {
+        SDL_Log("reload(): couldn't load cart %s", file_name);
+    }
+    return rom;
+}
+
 static int pico8_reload(lua_State* L)
 {
     int argc = lua_gettop(L);
+    const uint8_t* rom = get_cart()->cart_data;
 
     // reload(destaddr, sourceaddr, len [, filename])
     if (argc >= 4 && !lua_isnil(L, 4))
     {
-        return luaL_error(L, "reload(): loading from external cartridges is not supported yet");
+        rom = load_external_rom(luaL_checkstring(L, 4));
+        if (!rom)
+        {
+            return 0;
+        }
     }
 
     uint16_t dest_addr = fix32_to_uint16(luaL_checkunsigned(L, 1));
@@ -1697,7 +2118,7 @@ static int pico8_reload(lua_State* L)
     // Copy from cartridge data to RAM.
     SDL_memcpy(
         &pico8_ram[dest_addr],
-        &get_cart()->cart_data[source_addr],
+        &rom[source_addr],
         len
     );
 
@@ -1938,38 +2359,37 @@ static int pico8_sub(lua_State* L)
 
 static void pico8_split_push_token(lua_State* L, const char* s, size_t len, int convert_numbers)
 {
-    if (convert_numbers)
+    // Fields are converted where they are, without copying them out.
+    fix32_t v;
+    if (convert_numbers && lua_string2number(s, len, &v))
     {
-        char buf[128];
-        const char* parse_str = NULL;
-
-        if (len < sizeof(buf))
-        {
-            SDL_memcpy(buf, s, len);
-            buf[len] = '\0';
-            parse_str = buf;
-        }
+        lua_pushnumber(L, v);
+    }
+    else
+    {
+        lua_pushlstring(L, s, len);
+    }
+}
 
-        if (parse_str)
+static const char* pico8_split_find(const char* s, const char* end, const char* sep, size_t sep_len)
+{
+    while ((size_t)(end - s) >= sep_len)
+    {
+        s = (const char*)memchr(s, sep[0], (size_t)(end - s) - sep_len + 1);
+        if (!s || SDL_memcmp(s, sep, sep_len) == 0)
         {
-            char* endptr;
-            double v = SDL_strtod(parse_str, &endptr);
-
-            if (*parse_str != '\0' && *endptr == '\0')
-            {
-                lua_pushnumber(L, fix32_from_double(v));
-                return;
-            }
+            return s;
         }
+        s++;
     }
-
-    lua_pushlstring(L, s, len);
+    return NULL;
 }
 
 static int pico8_split(lua_State* L)
 {
     size_t str_len;
     const char* str = luaL_checklstring(L, 1, &str_len);
+    const char* end = str + str_len;
 
     int nargs = lua_gettop(L);
 
@@ -1985,37 +2405,8 @@ static int pico8_split(lua_State* L)
     lua_newtable(L);
 
     int index = 1;
-    size_t start = 0;
-    size_t pos = 0;
-
-    // CASE 1: split(str) or nil.
-    if (t2 == LUA_TNIL)
-    {
-        const char* sep = ",";
-        size_t sep_len = 1;
-
-        while (pos + sep_len <= str_len)
-        {
-            if (SDL_memcmp(str + pos, sep, sep_len) == 0)
-            {
-                pico8_split_push_token(L, str + start, pos - start, convert_numbers);
-                lua_rawseti(L, -2, index++);
-                pos += sep_len;
-                start = pos;
-            }
-            else
-            {
-                pos++;
-            }
-        }
-
-        pico8_split_push_token(L, str + start, str_len - start, convert_numbers);
-        lua_rawseti(L, -2, index);
-
-        return 1;
-    }
 
-    // CASE 2: numeric separator.
+    // Numeric separator: fields of that many characters.
     if (t2 == LUA_TNUMBER)
     {
         int n = fix32_to_int(lua_tointeger(L, 2));
@@ -2027,7 +2418,7 @@ static int pico8_split(lua_State* L)
             return 1;
         }
 
-        for (pos = 0; pos < str_len; pos += (size_t)n)
+        for (size_t pos = 0; pos < str_len; pos += (size_t)n)
         {
             size_t len = (pos + n > str_len) ? (str_len - pos) : (size_t)n;
 
@@ -2038,47 +2429,43 @@ static int pico8_split(lua_State* L)
         return 1;
     }
 
-    // CASE 3: string separator.
-    if (t2 != LUA_TSTRING)
+    // String separator, "," by default.
+    const char* sep = ",";
+    size_t sep_len = 1;
+
+    if (t2 != LUA_TNIL)
     {
-        return luaL_error(L,
-            "bad argument #2 to 'split' (string or number expected, got %s)",
-            lua_typename(L, t2));
+        if (t2 != LUA_TSTRING)
+        {
+            return luaL_error(L,
+                "bad argument #2 to 'split' (string or number expected, got %s)",
+                lua_typename(L, t2));
+        }
+        sep = lua_tolstring(L, 2, &sep_len);
     }
 
-    size_t sep_len;
-    const char* sep = lua_tolstring(L, 2, &sep_len);
-
     if (sep_len == 0)
     {
-        for (pos = 0; pos < str_len; pos++)
+        for (const char* p = str; p < end; p++)
         {
-            pico8_split_push_token(L, str + pos, 1, convert_numbers);
+            pico8_split_push_token(L, p, 1, convert_numbers);
             lua_rawseti(L, -2, index++);
         }
         return 1;
     }
 
-    start = 0;
-    pos = 0;
+    const char* start = str;
+    const char* hit;
 
-    while (pos + sep_len <= str_len)
+    while ((hit = pico8_split_find(start, end, sep, sep_len)) != NULL)
     {
-        if (SDL_memcmp(str + pos, sep, sep_len) == 0)
-        {
-            pico8_split_push_token(L, str + start, pos - start, convert_numbers);
-            lua_rawseti(L, -2, index++);
-            pos += sep_len;
-            start = pos;
-        }
-        else
-        {
-            pos++;
-        }
+        pico8_split_push_token(L, start, (size_t)(hit - start), convert_numbers);
+        lua_rawseti(L, -2, index++);
+        start = hit + sep_len;
     }
 
-    pico8_split_push_token(L, str + start, str_len - start, convert_numbers);
-    lua_rawseti(L, -2, index++);
+    pico8_split_push_token(L, start, (size_t)(end - start), convert_numbers);
+    lua_rawseti(L, -2, index);
 
     return 1;
 }
@@ -2097,7 +2484,10 @@ static int pico8_extcmd(lua_State* L)
 
 static int pico8_run(lua_State* L)
 {
-    TO_BE_DONE;
+    // Abort whatever the cart is doing; the restart itself happens between
+    // callbacks where the VM isn't running.
+    pico8_run_requested = true;
+    return luaL_error(L, "run()");
 }
 
 // Table functions.
@@ -2107,95 +2497,126 @@ static int pico8_add(lua_State* L)
     luaL_checktype(L, 1, LUA_TTABLE);
     luaL_checkany(L, 2);
 
-    int index;
-
     if (lua_isnoneornil(L, 3))
     {
-        index = (int)lua_rawlen(L, 1) + 1;
+        lua_pushvalue(L, 2);
+        lua_rawappend(L, 1);
     }
     else
     {
-        index = fix32_to_int(luaL_checkinteger(L, 3));
+        int index = fix32_to_int(luaL_checkinteger(L, 3));
+        lua_pushvalue(L, 2);
+        lua_rawseti(L, 1, index);
     }
 
-    lua_pushvalue(L, 2);
-    lua_rawseti(L, 1, index);
-
     lua_pushvalue(L, 2);
     return 1;
 }
 
-static int pico8_all_iter(lua_State* L)
+/* Steps PICO-8's all() iteration over the table at tbl. The slot at
+ * *index held prev on the previous step: move past it unless it was
+ * del()eted meanwhile, then skip holes up to the border. Pushes the next
+ * element, or nil at the end. This is what makes deleting the current
+ * element (or adding new ones) safe without copying the table. */
+static bool all_step(lua_State* L, int tbl, int* index, int prev)
 {
-    luaL_checktype(L, lua_upvalueindex(1), LUA_TTABLE);
-
-    lua_settop(L, 0);
-    lua_pushvalue(L, lua_upvalueindex(1));
-    int index = fix32_to_int(lua_tointeger(L, lua_upvalueindex(2)));
-
-    while (1)
+    lua_rawgeti(L, tbl, *index);
+    if (lua_rawequal(L, -1, prev))
     {
-        index++;
-        lua_pushinteger(L, index);
-        lua_replace(L, lua_upvalueindex(2));
+        (*index)++;
+    }
+    lua_pop(L, 1);
 
-        lua_rawgeti(L, 1, index);
-        if (!lua_isnil(L, -1))
+    int len = (int)lua_rawlen(L, tbl);
+    for (;;)
+    {
+        lua_rawgeti(L, tbl, *index);
+        if (!lua_isnil(L, -1) || *index > len)
         {
-            return 1;
+            break;
         }
         lua_pop(L, 1);
+        (*index)++;
+    }
 
-        if ((size_t)index > lua_rawlen(L, 1))
-        {
-            return 0;
-        }
+    return !lua_isnil(L, -1);
+}
+
+/* Iterator of all(), called by the generic for with the state table
+ * {tbl, index} and the previous element. Finished states go back to the
+ * pool in upvalue 1, so loops that run to the end allocate nothing once
+ * the pool has warmed up. */
+static int pico8_all_iter(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_settop(L, 2);
+    lua_rawgeti(L, 1, 1);
+    if (!lua_istable(L, -1))
+    {
+        return 0; /* called again after the end */
     }
+    int tbl = lua_gettop(L);
+    lua_rawgeti(L, 1, 2);
+    int index = fix32_to_int(lua_tonumber(L, -1));
+    lua_pop(L, 1);
+
+    if (all_step(L, tbl, &index, 2))
+    {
+        lua_pushnumber(L, fix32_from_int(index));
+        lua_rawseti(L, 1, 2);
+        return 1;
+    }
+
+    /* Release the state and the reference to tbl. */
+    lua_pushnil(L);
+    lua_rawseti(L, 1, 1);
+    lua_pushvalue(L, 1);
+    lua_rawappend(L, lua_upvalueindex(1));
+    return 0;
 }
 
 static int pico8_all(lua_State* L)
 {
     luaL_checktype(L, 1, LUA_TTABLE);
 
-    /* Make a compact snapshot copy of the array portion of the table.
-     * This makes the iterator resilient to mutations (del/add) of the
-     * original table while iterating, matching PICO-8 semantics.
-     * The copy packs non-nil values into a new dense table. */
-    size_t len = lua_rawlen(L, 1);
-    lua_newtable(L); /* copy table */
-    int copy_index = lua_gettop(L);
+    lua_pushvalue(L, lua_upvalueindex(2)); /* iterator */
 
-    size_t dest = 0;
-    for (size_t i = 1; i <= len; i++)
+    /* Reuse a state from the pool, or make a new one. */
+    int n = (int)lua_rawlen(L, lua_upvalueindex(1));
+    if (n > 0)
     {
-        lua_rawgeti(L, 1, (int)i); /* push original[i] */
-        if (!lua_isnil(L, -1))
-        {
-            dest++;
-            lua_rawseti(L, copy_index, (int)dest); /* copy[dest] = value, pops value */
-        }
-        else
-        {
-            lua_pop(L, 1);
-        }
+        lua_rawgeti(L, lua_upvalueindex(1), n);
+        lua_pushnil(L);
+        lua_rawseti(L, lua_upvalueindex(1), n);
+    }
+    else
+    {
+        lua_createtable(L, 2, 0);
     }
 
-    /* Push the snapshot and an initial index 0 as upvalues for the iterator. */
-    lua_pushvalue(L, copy_index); /* push copy */
-    lua_pushinteger(L, 0);
-    lua_pushcclosure(L, pico8_all_iter, 2);
-
-    /* remove the temporary copy table left on the stack so only the
-     * iterator closure remains as the return value */
-    lua_remove(L, copy_index);
+    lua_pushvalue(L, 1);
+    lua_rawseti(L, -2, 1);
+    lua_pushnumber(L, fix32_from_int(1));
+    lua_rawseti(L, -2, 2);
 
-    return 1;
+    lua_pushnil(L); /* no previous element */
+    return 3;
 }
 
 static int pico8_count(lua_State* L)
 {
     luaL_checktype(L, 1, LUA_TTABLE);
-    lua_pushnumber(L, fix32_from_int((int)lua_rawlen(L, 1)));
+
+    if (lua_isnoneornil(L, 2))
+    {
+        lua_pushnumber(L, fix32_from_int((int)lua_rawlen(L, 1)));
+    }
+    else
+    {
+        /* count(tbl, val) counts the occurrences of val. */
+        lua_pushvalue(L, 2);
+        lua_pushnumber(L, fix32_from_int(lua_rawcount(L, 1)));
+    }
     return 1;
 }
 
@@ -2204,31 +2625,16 @@ static int pico8_del(lua_State* L)
     luaL_checktype(L, 1, LUA_TTABLE);
     luaL_checkany(L, 2);
 
-    int len = (int)lua_rawlen(L, 1);
-
-    for (int i = 1; i <= len; i++)
+    /* Removes the first match and shifts the rest of the sequence down. */
+    lua_pushvalue(L, 2);
+    if (lua_rawremove(L, 1))
     {
-        lua_rawgeti(L, 1, i); /* push tbl[i] */
-        if (lua_rawequal(L, -1, 2))
-        {
-            /* Shift tbl[i+1..len] down by one. */
-            for (int j = i; j < len; j++)
-            {
-                lua_rawgeti(L, 1, j + 1); /* push tbl[j+1] */
-                lua_rawseti(L, 1, j); /* tbl[j] = tbl[j+1], pops */
-            }
-
-            /* Nil out the last slot. */
-            lua_pushnil(L);
-            lua_rawseti(L, 1, len);
-
-            /* The matched value is still on the stack - return it. */
-            return 1;
-        }
-        lua_pop(L, 1); /* discard tbl[i] */
+        lua_pushvalue(L, 2); /* the removed value is raw equal to val */
+    }
+    else
+    {
+        lua_pushnil(L);
     }
-
-    lua_pushnil(L);
     return 1;
 }
 
@@ -2237,48 +2643,18 @@ static int pico8_foreach(lua_State* L)
     luaL_checktype(L, 1, LUA_TTABLE);
     luaL_checktype(L, 2, LUA_TFUNCTION);
 
-    /* Make a compact snapshot copy of the array portion of the table so
-     * that mutations (add/del) performed by the callback do not affect the
-     * iteration order or cause duplicate/skip behaviour. This matches PICO-8
-     * semantics and mirrors the approach used by pico8_all(). */
-    size_t len = lua_rawlen(L, 1);
-    lua_newtable(L); /* copy */
-    int copy_index = lua_gettop(L);
-
-    size_t dest = 0;
-    for (size_t i = 1; i <= len; i++)
-    {
-        lua_rawgeti(L, 1, (int)i); /* push original[i] */
-        if (!lua_isnil(L, -1))
-        {
-            dest++;
-            lua_rawseti(L, copy_index, (int)dest); /* copy[dest] = value, pops value */
-        }
-        else
-        {
-            lua_pop(L, 1);
-        }
-    }
-
-    int copy_len = (int)lua_rawlen(L, copy_index);
-    for (int i = 1; i <= copy_len; i++)
+    /* Same stepping as all(), so the callback may del() or add(). */
+    int index = 1;
+    lua_settop(L, 2);
+    lua_pushnil(L); /* previous element */
+    while (all_step(L, 1, &index, 3))
     {
-        lua_pushvalue(L, 2);      /* fn */
-        lua_rawgeti(L, copy_index, i); /* item */
-        /* item should never be nil in our dense copy, but check defensively */
-        if (lua_isnil(L, -1))
-        {
-            lua_pop(L, 2);
-        }
-        else
-        {
-            lua_call(L, 1, 0);
-        }
+        lua_replace(L, 3);
+        lua_pushvalue(L, 2);
+        lua_pushvalue(L, 3);
+        lua_call(L, 1, 0);
     }
 
-    /* remove the temporary copy table */
-    lua_pop(L, 1);
-
     return 0;
 }
 
@@ -2480,6 +2856,29 @@ static int pico8_log(lua_State* L)
 
 // API Registration.
 
+// Builtins with a direct entry point for calls with number arguments only;
+// the last field is the minimum argument count for it.
+static const lua_FastReg fast_btn = { pico8_btn, pico8_btn_fast, 0 };
+static const lua_FastReg fast_btnp = { pico8_btnp, pico8_btnp_fast, 0 };
+static const lua_FastReg fast_circ = { pico8_circ, pico8_circ_fast, 2 };
+static const lua_FastReg fast_circfill = { pico8_circfill, pico8_circfill_fast, 2 };
+static const lua_FastReg fast_color = { pico8_color, pico8_color_fast, 1 };
+static const lua_FastReg fast_fget = { pico8_fget, pico8_fget_fast, 1 };
+static const lua_FastReg fast_line = { pico8_line, pico8_line_fast, 4 };
+static const lua_FastReg fast_map = { pico8_map, pico8_map_fast, 0 };
+static const lua_FastReg fast_mget = { pico8_mget, pico8_mget_fast, 2 };
+static const lua_FastReg fast_mset = { pico8_mset, pico8_mset_fast, 3 };
+static const lua_FastReg fast_oval = { pico8_oval, pico8_oval_fast, 4 };
+static const lua_FastReg fast_ovalfill = { pico8_ovalfill, pico8_ovalfill_fast, 4 };
+static const lua_FastReg fast_pal = { pico8_pal, pico8_pal_fast, 2 };
+static const lua_FastReg fast_pget = { pico8_pget, pico8_pget_fast, 2 };
+static const lua_FastReg fast_pset = { pico8_pset, pico8_pset_fast, 2 };
+static const lua_FastReg fast_rect = { pico8_rect, pico8_rect_fast, 4 };
+static const lua_FastReg fast_rectfill = { pico8_rectfill, pico8_rectfill_fast, 4 };
+static const lua_FastReg fast_sget = { pico8_sget, pico8_sget_fast, 2 };
+static const lua_FastReg fast_spr = { pico8_spr, pico8_spr_fast, 1 };
+static const lua_FastReg fast_sspr = { pico8_sspr, pico8_sspr_fast, 6 };
+
 void init_api(lua_State* L)
 {
     // Draw state defaults.
@@ -2508,7 +2907,11 @@ void init_api(lua_State* L)
     lua_setglobal(L, "cocreate");
     lua_pushcfunction(L, pico8_coresume);
     lua_setglobal(L, "coresume");
-    lua_pushcfunction(L, pico8_costatus);
+    lua_pushstring(L, "suspended");
+    lua_pushstring(L, "running");
+    lua_pushstring(L, "normal");
+    lua_pushstring(L, "dead");
+    lua_pushcclosure(L, pico8_costatus, 4);
     lua_setglobal(L, "costatus");
     lua_pushcfunction(L, pico8_yield);
     lua_setglobal(L, "yield");
@@ -2534,19 +2937,19 @@ void init_api(lua_State* L)
     // Graphics.
     lua_pushcfunction(L, pico8_camera);
     lua_setglobal(L, "camera");
-    lua_pushcfunction(L, pico8_circ);
+    lua_pushfastcfunction(L, &fast_circ);
     lua_setglobal(L, "circ");
-    lua_pushcfunction(L, pico8_circfill);
+    lua_pushfastcfunction(L, &fast_circfill);
     lua_setglobal(L, "circfill");
     lua_pushcfunction(L, pico8_clip);
     lua_setglobal(L, "clip");
     lua_pushcfunction(L, pico8_cls);
     lua_setglobal(L, "cls");
-    lua_pushcfunction(L, pico8_color);
+    lua_pushfastcfunction(L, &fast_color);
     lua_setglobal(L, "color");
     lua_pushcfunction(L, pico8_cursor);
     lua_setglobal(L, "cursor");
-    lua_pushcfunction(L, pico8_fget);
+    lua_pushfastcfunction(L, &fast_fget);
     lua_setglobal(L, "fget");
     lua_pushcfunction(L, pico8_fillp);
     lua_setglobal(L, "fillp");
@@ -2554,51 +2957,51 @@ void init_api(lua_State* L)
     lua_setglobal(L, "flip");
     lua_pushcfunction(L, pico8_fset);
     lua_setglobal(L, "fset");
-    lua_pushcfunction(L, pico8_line);
+    lua_pushfastcfunction(L, &fast_line);
     lua_setglobal(L, "line");
-    lua_pushcfunction(L, pico8_oval);
+    lua_pushfastcfunction(L, &fast_oval);
     lua_setglobal(L, "oval");
-    lua_pushcfunction(L, pico8_ovalfill);
+    lua_pushfastcfunction(L, &fast_ovalfill);
     lua_setglobal(L, "ovalfill");
-    lua_pushcfunction(L, pico8_pal);
+    lua_pushfastcfunction(L, &fast_pal);
     lua_setglobal(L, "pal");
     lua_pushcfunction(L, pico8_palt);
     lua_setglobal(L, "palt");
-    lua_pushcfunction(L, pico8_pget);
+    lua_pushfastcfunction(L, &fast_pget);
     lua_setglobal(L, "pget");
     lua_pushcfunction(L, pico8_print);
     lua_setglobal(L, "print");
-    lua_pushcfunction(L, pico8_pset);
+    lua_pushfastcfunction(L, &fast_pset);
     lua_setglobal(L, "pset");
-    lua_pushcfunction(L, pico8_rect);
+    lua_pushfastcfunction(L, &fast_rect);
     lua_setglobal(L, "rect");
-    lua_pushcfunction(L, pico8_rectfill);
+    lua_pushfastcfunction(L, &fast_rectfill);
     lua_setglobal(L, "rectfill");
-    lua_pushcfunction(L, pico8_sget);
+    lua_pushfastcfunction(L, &fast_sget);
     lua_setglobal(L, "sget");
-    lua_pushcfunction(L, pico8_spr);
+    lua_pushfastcfunction(L, &fast_spr);
     lua_setglobal(L, "spr");
     lua_pushcfunction(L, pico8_sset);
     lua_setglobal(L, "sset");
-    lua_pushcfunction(L, pico8_sspr);
+    lua_pushfastcfunction(L, &fast_sspr);
     lua_setglobal(L, "sspr");
     lua_pushcfunction(L, pico8_tline);
     lua_setglobal(L, "tline");
 
     // Input.
-    lua_pushcfunction(L, pico8_btn);
+    lua_pushfastcfunction(L, &fast_btn);
     lua_setglobal(L, "btn");
-    lua_pushcfunction(L, pico8_btnp);
+    lua_pushfastcfunction(L, &fast_btnp);
     lua_setglobal(L, "btnp");
     lua_pushcfunction(L, pico8_set_btnp_frames);
     lua_setglobal(L, "set_btnp_frames");
 
     // Map.
-    lua_pushcfunction(L, pico8_map);
+    lua_pushfastcfunction(L, &fast_map);
     lua_setglobal(L, "map");
-    lua_pushcfunction(L, pico8_mget);
+    lua_pushfastcfunction(L, &fast_mget);
     lua_setglobal(L, "mget");
-    lua_pushcfunction(L, pico8_mset);
+    lua_pushfastcfunction(L, &fast_mset);
     lua_setglobal(L, "mset");
     lua_pushcfunction(L, pico8_mapdraw);
     lua_setglobal(L, "mapdraw");
@@ -2637,10 +3040,14 @@ void init_api(lua_State* L)
     lua_setglobal(L, "poke2");
     lua_pushcfunction(L, pico8_poke4);
     lua_setglobal(L, "poke4");
+    lua_setpico8poke(L, 1, pico8_poke);
+    lua_setpico8poke(L, 2, pico8_poke2);
+    lua_setpico8poke(L, 4, pico8_poke4);
 
     // Strings.
     lua_pushcfunction(L, pico8_sub);
     lua_setglobal(L, "sub");
+    lua_setpico8sub(L, pico8_sub);
     lua_pushcfunction(L, pico8_split);
     lua_setglobal(L, "split");
 
@@ -2655,7 +3062,10 @@ void init_api(lua_State* L)
     // Tables.
     lua_pushcfunction(L, pico8_add);
     lua_setglobal(L, "add");
-    lua_pushcfunction(L, pico8_all);
+    lua_newtable(L); /* pool of all() states */
+    lua_pushvalue(L, -1);
+    lua_pushcclosure(L, pico8_all_iter, 1);
+    lua_pushcclosure(L, pico8_all, 2);
     lua_setglobal(L, "all");
     lua_pushcfunction(L, pico8_count);
     lua_setglobal(L, "count");
@@ -2804,3 +3214,56 @@ void update_time(void)
     fix32_t elapsed_time = fix32_from_int((Sint32)elapsed_time_ticks) / 1000;
     seconds_since_start = elapsed_time;
 }
+
+// Pushes a shallow copy of the table on top of the stack, with _G pointing
+// at the copy.
+static void push_globals_copy(lua_State* L)
+{
+    lua_newtable(L);
+    lua_pushnil(L);
+    while (lua_next(L, -3))
+    {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, -4);
+    }
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "_G");
+}
+
+void save_base_globals(lua_State* L)
+{
+    lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+    push_globals_copy(L);
+    lua_setfield(L, LUA_REGISTRYINDEX, BASE_GLOBALS_KEY);
+    lua_pop(L, 1);
+}
+
+int call_main_chunk(lua_State* L)
+{
+    lua_pushvalue(L, -1);
+    lua_setfield(L, LUA_REGISTRYINDEX, MAIN_CHUNK_KEY);
+
+    return lua_pcall(L, 0, 0, 0);
+}
+
+int restart_main_chunk(lua_State* L)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, MAIN_CHUNK_KEY);
+    lua_getfield(L, LUA_REGISTRYINDEX, BASE_GLOBALS_KEY);
+    if (!lua_isfunction(L, -2) || !lua_istable(L, -1))
+    {
+        lua_pop(L, 2);
+        lua_pushliteral(L, "no cart to restart");
+        return LUA_ERRRUN;
+    }
+
+    push_globals_copy(L);
+    lua_replace(L, -2);
+    lua_pushvalue(L, -1);
+    lua_rawseti(L, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+
+    // The main chunk's only upvalue is _ENV.
+    lua_setupvalue(L, -2, 1);
+    return lua_pcall(L, 0, 0, 0);
+}
@@ -18,14 +18,28 @@
 #include "z8lua/lauxlib.h"
 #include "z8lua/lua.h"
 
+// Room in the global table for every builtin, so that registering them never
+// has to grow it.
+#define VM_GLOBALS 128
+
 extern fix32_t seconds_since_start;
 
 // Frame timing information (set by core.c each frame) used by stat(1).
 extern uint64_t pico8_frame_start;
 extern uint32_t pico8_frame_ms;
 
+// Set when the cart calls run().
+extern bool pico8_run_requested;
+
 void init_api(lua_State* L);
 void update_input(SDL_Renderer* renderer);
 void update_time(void);
 
+// Keep the main chunk and the globals it first ran with, so that run() can
+// start the cart over without recompiling it. The calls return the
+// lua_pcall() status.
+void save_base_globals(lua_State* L);
+int call_main_chunk(lua_State* L);
+int restart_main_chunk(lua_State* L);
+
 #endif // API_H
@@ -22,6 +22,14 @@ typedef struct cart
     uint8_t* code;
     uint32_t code_size;
 
+    // Contents of a .p8 text cart; code may point straight into it.
+    uint8_t* source;
+    bool owns_code;
+
+    // Code is only decoded when the cart is run for the first time.
+    bool is_text;
+    bool has_code;
+
     bool is_corrupt;
 
 } cart_t;
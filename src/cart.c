@@ -0,0 +1,1055 @@
+﻿/** @file cart.c
+ *
+ *  A portable PICO-8 emulator written in C.
+ *
+ *  Copyright (c) 2025-2026, Michael Fitzmayer. All rights reserved.
+ *  SPDX-License-Identifier: MIT
+ *
+ **/
+
+#include <SDL3/SDL.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lexaloffle/p8_compress.h"
+#include "auxiliary.h"
+#include "cart.h"
+#include "core.h"
+
+#define STBI_ONLY_PNG
+#include "misc/stb_image.h"
+
+// Position of the label (and the game screen) on the cart image.
+#define LABEL_X 16
+#define LABEL_Y 24
+#define LABEL_SIZE 128
+
+typedef enum section
+{
+    SECTION_NONE,
+    SECTION_LUA,
+    SECTION_GFX,
+    SECTION_GFF,
+    SECTION_LABEL,
+    SECTION_MAP,
+    SECTION_SFX,
+    SECTION_MUSIC
+
+} section_t;
+
+typedef struct
+{
+    const char* name;
+    section_t section;
+
+} section_header_t;
+
+typedef struct
+{
+    char* file_name;
+    uint32_t last_used;
+    uint8_t rom[CART_ROM_SIZE];
+
+} cart_cache_entry_t;
+
+static cart_cache_entry_t** cart_cache;
+static int cart_cache_size = CART_CACHE_SIZE;
+static uint32_t cart_cache_clock;
+static uint32_t cart_cache_hits;
+static uint32_t cart_cache_misses;
+
+static const section_header_t section_headers[] =
+{
+    { "__lua__",   SECTION_LUA   },
+    { "__gfx__",   SECTION_GFX   },
+    { "__gff__",   SECTION_GFF   },
+    { "__label__", SECTION_LABEL },
+    { "__map__",   SECTION_MAP   },
+    { "__sfx__",   SECTION_SFX   },
+    { "__music__", SECTION_MUSIC }
+};
+
+// .p8 files store every P8SCII character that is not printable ASCII as
+// Unicode.  NULL entries are stored as the byte itself.
+static const char* const p8scii_low[32] =
+{
+    NULL, "¹", "²", "³", "⁴", "⁵", "⁶", "⁷", "⁸", NULL, NULL, "ᵇ", "ᶜ", NULL, "ᵉ", "ᶠ",
+    "▮", "■", "□", "⁙", "⁘", "‖", "◀", "▶", "「", "」", "¥", "•", "、", "。", "゛", "゜"
+};
+
+static const char* const p8scii_high[128] =
+{
+    "█", "▒", "🐱", "⬇", "░", "✽", "●", "♥", "☉", "웃", "⌂", "⬅", "😐", "♪", "🅾", "◆",
+    "…", "➡", "★", "⧗", "⬆", "ˇ", "∧", "❎", "▤", "▥", "あ", "い", "う", "え", "お", "か",
+    "き", "く", "け", "こ", "さ", "し", "す", "せ", "そ", "た", "ち", "つ", "て", "と", "な", "に",
+    "ぬ", "ね", "の", "は", "ひ", "ふ", "へ", "ほ", "ま", "み", "む", "め", "も", "や", "ゆ", "よ",
+    "ら", "り", "る", "れ", "ろ", "わ", "を", "ん", "っ", "ゃ", "ゅ", "ょ", "ア", "イ", "ウ", "エ",
+    "オ", "カ", "キ", "ク", "ケ", "コ", "サ", "シ", "ス", "セ", "ソ", "タ", "チ", "ツ", "テ", "ト",
+    "ナ", "ニ", "ヌ", "ネ", "ノ", "ハ", "ヒ", "フ", "ヘ", "ホ", "マ", "ミ", "ム", "メ", "モ", "ヤ",
+    "ユ", "ヨ", "ラ", "リ", "ル", "レ", "ロ", "ワ", "ヲ", "ン", "ッ", "ャ", "ュ", "ョ", "◜", "◝"
+};
+
+static const char* p8scii_to_utf8(int c)
+{
+    if (c < 32)
+    {
+        return p8scii_low[c];
+    }
+    else if (c == 127)
+    {
+        return "○";
+    }
+    else if (c >= 128)
+    {
+        return p8scii_high[c - 128];
+    }
+    return NULL;
+}
+
+static bool has_extension(const char* file_name, const char* extension)
+{
+    size_t name_len = SDL_strlen(file_name);
+    size_t ext_len = SDL_strlen(extension);
+
+    return name_len > ext_len && SDL_strcasecmp(&file_name[name_len - ext_len], extension) == 0;
+}
+
+cart_format_t get_cart_format(const char* file_name)
+{
+    if (has_extension(file_name, ".png"))
+    {
+        return CART_FORMAT_PNG;
+    }
+    else if (has_extension(file_name, ".rom"))
+    {
+        return CART_FORMAT_ROM;
+    }
+    else if (has_extension(file_name, ".p8"))
+    {
+        return CART_FORMAT_P8;
+    }
+    return CART_FORMAT_UNKNOWN;
+}
+
+static void extract_pico8_data(uint8_t* image_data, uint8_t* cart_data)
+{
+    size_t data_index = 0;
+    size_t pixel_count = CART_WIDTH * CART_HEIGHT;
+
+    // Each Pico-8 byte is stored as the two least significant bits of each of the four
+    // channels, ordered ARGB (E.g: the A channel stores the 2 most significant bits in
+    // the bytes).  The image is 160 pixels wide and 205 pixels high, for a possible
+    // storage of 32,800 (0x8020) bytes.
+
+    for (size_t i = 0; i < pixel_count; i++)
+    {
+        if (data_index >= CART_DATA_SIZE)
+        {
+            break;
+        }
+
+        // stb_image stores components in RGBA32 order
+        uint8_t R = image_data[i * 4];     // R channel
+        uint8_t G = image_data[i * 4 + 1]; // G channel
+        uint8_t B = image_data[i * 4 + 2]; // B channel
+        uint8_t A = image_data[i * 4 + 3]; // A channel
+
+        // Extract the 2 least significant bits from each channel.
+        uint8_t byte = ((A & 0x03) << 6) | ((R & 0x03) << 4) | ((G & 0x03) << 2) | ((B & 0x03) << 0);
+
+        // Clean up graphical artifacts visible on 32bpp displays
+        image_data[i * 4] = (R & 0xFC) | (R >> 6);
+        image_data[i * 4 + 1] = (G & 0xFC) | (G >> 6);
+        image_data[i * 4 + 2] = (B & 0xFC) | (B >> 6);
+        image_data[i * 4 + 3] = (A & 0xFC) | (A >> 6);
+
+        cart_data[data_index] = byte;
+        data_index++;
+    }
+}
+
+static void set_image_pixel(uint8_t* image, int x, int y, int col)
+{
+    uint8_t* pixel = &image[(y * CART_WIDTH + x) * 4];
+
+    color_lookup(col, &pixel[0], &pixel[1], &pixel[2]);
+    pixel[3] = 0xff;
+}
+
+// Text and ROM carts come without a cartridge picture, so draw a plain
+// one with an empty label for the menu.
+static uint8_t* create_cart_image(void)
+{
+    uint8_t* image = (uint8_t*)SDL_malloc(CART_WIDTH * CART_HEIGHT * 4);
+    if (!image)
+    {
+        SDL_Log("Couldn't allocate memory for cart image");
+        return NULL;
+    }
+
+    for (int y = 0; y < CART_HEIGHT; y++)
+    {
+        for (int x = 0; x < CART_WIDTH; x++)
+        {
+            bool in_label =
+                x >= LABEL_X && x < LABEL_X + LABEL_SIZE &&
+                y >= LABEL_Y && y < LABEL_Y + LABEL_SIZE;
+
+            set_image_pixel(image, x, y, in_label ? 0 : 5);
+        }
+    }
+
+    return image;
+}
+
+static int hex_digit(uint8_t c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    else if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return 0;
+}
+
+static uint8_t hex_byte(const uint8_t* p)
+{
+    return (uint8_t)((hex_digit(p[0]) << 4) | hex_digit(p[1]));
+}
+
+static bool parse_section_header(const uint8_t* line, size_t len, section_t* section)
+{
+    if (len < 4 || line[0] != '_' || line[1] != '_')
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < SDL_arraysize(section_headers); i++)
+    {
+        const char* name = section_headers[i].name;
+        if (SDL_strlen(name) == len && SDL_memcmp(line, name, len) == 0)
+        {
+            *section = section_headers[i].section;
+            return true;
+        }
+    }
+
+    // Sections we don't care about, e.g. __meta:title__.
+    if (len > 9 && line[len - 1] == '_' && line[len - 2] == '_' && SDL_memcmp(line, "__meta:", 7) == 0)
+    {
+        *section = SECTION_NONE;
+        return true;
+    }
+
+    return false;
+}
+
+// Decodes one line of a data section straight into its place in the ROM.
+static void decode_section_row(section_t section, int row, const uint8_t* line, size_t len, uint8_t* cart_data, uint8_t* image)
+{
+    switch (section)
+    {
+        case SECTION_GFX:
+        {
+            // One hex digit per pixel, left pixel in the low nibble.
+            if (row < 128)
+            {
+                for (size_t x = 0; x < 64 && x * 2 + 1 < len; x++)
+                {
+                    cart_data[row * 64 + x] = (uint8_t)(hex_digit(line[x * 2]) | (hex_digit(line[x * 2 + 1]) << 4));
+                }
+            }
+            break;
+        }
+        case SECTION_GFF:
+        case SECTION_MAP:
+        {
+            int rows = (section == SECTION_GFF) ? 2 : 32;
+            uint16_t base = (section == SECTION_GFF) ? 0x3000 : 0x2000;
+
+            if (row < rows)
+            {
+                for (size_t x = 0; x < 128 && x * 2 + 1 < len; x++)
+                {
+                    cart_data[base + row * 128 + x] = hex_byte(&line[x * 2]);
+                }
+            }
+            break;
+        }
+        case SECTION_SFX:
+        {
+            // Editor mode, speed and loop points, then 32 notes of five digits
+            // each: pitch (2), waveform (1), volume (1) and effect (1).
+            if (row < 64 && len >= 168)
+            {
+                uint8_t* sfx = &cart_data[0x3200 + row * 68];
+
+                for (int i = 0; i < 4; i++)
+                {
+                    sfx[64 + i] = hex_byte(&line[i * 2]);
+                }
+
+                for (int i = 0; i < 32; i++)
+                {
+                    const uint8_t* note = &line[8 + i * 5];
+                    int waveform = hex_digit(note[2]);
+                    uint16_t bits = (hex_byte(note) & 0x3f)
+                        | ((waveform & 0x07) << 6)
+                        | ((hex_digit(note[3]) & 0x07) << 9)
+                        | ((hex_digit(note[4]) & 0x07) << 12)
+                        | ((waveform & 0x08) << 12); // Custom instrument.
+
+                    sfx[i * 2] = bits & 0xff;
+                    sfx[i * 2 + 1] = bits >> 8;
+                }
+            }
+            break;
+        }
+        case SECTION_MUSIC:
+        {
+            // Flags, a space and four channel bytes.  The flags end up in the
+            // top bit of the channel bytes.
+            if (row < 64 && len >= 11)
+            {
+                uint8_t flags = hex_byte(line);
+
+                for (int i = 0; i < 4; i++)
+                {
+                    cart_data[0x3100 + row * 4 + i] = hex_byte(&line[3 + i * 2]) | (((flags >> i) & 1) << 7);
+                }
+            }
+            break;
+        }
+        case SECTION_LABEL:
+        {
+            // One digit per pixel, 'g' to 'v' select the secret palette.
+            if (image && row < LABEL_SIZE)
+            {
+                for (size_t x = 0; x < LABEL_SIZE && x < len; x++)
+                {
+                    int col = (line[x] >= 'g' && line[x] <= 'v') ? 128 + (line[x] - 'g') : hex_digit(line[x]);
+                    set_image_pixel(image, LABEL_X + (int)x, LABEL_Y + row, col);
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static bool parse_p8(uint8_t* data, size_t size, cart_t* cart, uint8_t* image)
+{
+    static const char magic[] = "pico-8 cartridge";
+
+    if (size < sizeof(magic) - 1 || SDL_memcmp(data, magic, sizeof(magic) - 1) != 0)
+    {
+        SDL_Log("Not a PICO-8 text cart");
+        return false;
+    }
+
+    section_t section = SECTION_NONE;
+    int row = 0;
+    size_t code_start = 0;
+    size_t code_end = 0;
+    size_t pos = 0;
+
+    while (pos < size)
+    {
+        const uint8_t* line = &data[pos];
+        const uint8_t* eol = (const uint8_t*)memchr(line, '\n', size - pos);
+        size_t next = eol ? (size_t)(eol - data) + 1 : size;
+        size_t len = (eol ? (size_t)(eol - data) : size) - pos;
+
+        if (len > 0 && line[len - 1] == '\r')
+        {
+            len--;
+        }
+
+        section_t header;
+        if (parse_section_header(line, len, &header))
+        {
+            if (section == SECTION_LUA)
+            {
+                code_end = pos;
+            }
+            if (header == SECTION_LUA)
+            {
+                code_start = code_end = next;
+            }
+            section = header;
+            row = 0;
+        }
+        else if (section != SECTION_LUA)
+        {
+            decode_section_row(section, row++, line, len, cart->cart_data, image);
+        }
+
+        pos = next;
+    }
+
+    if (section == SECTION_LUA)
+    {
+        code_end = size;
+    }
+
+    // The code is handed to the VM where it is.
+    cart->code = &data[code_start];
+    cart->code_size = (uint32_t)(code_end - code_start);
+    cart->owns_code = false;
+    return true;
+}
+
+// Converts the Unicode glyphs of text cart code back to P8SCII.  Carts
+// that stick to ASCII are left in place.
+static bool convert_code_to_p8scii(cart_t* cart)
+{
+    uint32_t i = 0;
+
+    while (i < cart->code_size && cart->code[i] < 0x80)
+    {
+        i++;
+    }
+
+    if (i == cart->code_size)
+    {
+        return true;
+    }
+
+    uint8_t* code = (uint8_t*)SDL_malloc(cart->code_size);
+    if (!code)
+    {
+        SDL_Log("Couldn't allocate memory for cart code");
+        return false;
+    }
+
+    SDL_memcpy(code, cart->code, i);
+    uint32_t j = i;
+
+    while (i < cart->code_size)
+    {
+        const uint8_t* p = &cart->code[i];
+        uint32_t left = cart->code_size - i;
+        uint32_t len = 1;
+        int c;
+
+        if (*p < 0x80)
+        {
+            code[j++] = cart->code[i++];
+            continue;
+        }
+
+        if (*p >= 0xf0)
+        {
+            len = 4;
+        }
+        else if (*p >= 0xe0)
+        {
+            len = 3;
+        }
+        else if (*p >= 0xc0)
+        {
+            len = 2;
+        }
+
+        for (c = 1; c < 256; c++)
+        {
+            const char* glyph = p8scii_to_utf8(c);
+            if (glyph && len <= left && SDL_strlen(glyph) == len && SDL_memcmp(p, glyph, len) == 0)
+            {
+                break;
+            }
+        }
+
+        if (c == 256)
+        {
+            // Not a P8SCII glyph; keep the byte as is.
+            code[j++] = cart->code[i++];
+            continue;
+        }
+
+        code[j++] = (uint8_t)c;
+        i += len;
+
+        // Skip the emoji variation selector that follows some glyphs.
+        if (i + 3 <= cart->code_size && SDL_memcmp(&cart->code[i], "\xef\xb8\x8f", 3) == 0)
+        {
+            i += 3;
+        }
+    }
+
+    if (cart->owns_code)
+    {
+        SDL_free(cart->code);
+    }
+    cart->code = code;
+    cart->code_size = j;
+    cart->owns_code = true;
+    return true;
+}
+
+// It's in fact easier to patch the code than parsing the preset
+// fill-pattern characters using the Lua C-API.
+static void patch_cart_code(cart_t* cart)
+{
+    // State machine: 0=normal, 1=double-quote string, 2=single-quote string,
+    //                3=line comment, 4=long string [[...]].
+    // Special bytes are only wrapped when in normal code (state 0).
+    size_t count = 0;
+    int state = 0;
+
+    // Pass 1: count special bytes that appear outside string literals and comments.
+    for (size_t i = 0; i < cart->code_size; i++)
+    {
+        unsigned char c = (unsigned char)cart->code[i];
+
+        if (state == 1) // Double-quoted string.
+        {
+            if (c == '\\')
+            {
+                i++; // Skip escaped character.
+            }
+            else if (c == '"')
+            {
+                state = 0;
+            }
+        }
+        else if (state == 2) // Single-quoted string.
+        {
+            if (c == '\\')
+            {
+                i++; // Skip escaped character.
+            }
+            else if (c == '\'')
+            {
+                state = 0;
+            }
+        }
+        else if (state == 3) // Line comment.
+        {
+            if (c == '\n')
+            {
+                state = 0;
+            }
+        }
+        else if (state == 4) // Long string.
+        {
+            if (c == ']' && i + 1 < cart->code_size && (unsigned char)cart->code[i + 1] == ']')
+            {
+                state = 0;
+                i++;
+            }
+        }
+        else // Normal code.
+        {
+            if (c == '"')
+            {
+                state = 1;
+            }
+            else if (c == '\'')
+            {
+                state = 2;
+            }
+            else if (c == '-' && i + 1 < cart->code_size && (unsigned char)cart->code[i + 1] == '-')
+            {
+                i++;
+                if (i + 2 < cart->code_size && (unsigned char)cart->code[i + 1] == '[' && (unsigned char)cart->code[i + 2] == '[')
+                {
+                    state = 4;
+                    i += 2;
+                }
+                else
+                {
+                    state = 3;
+                }
+            }
+            else if (c == '[' && i + 1 < cart->code_size && (unsigned char)cart->code[i + 1] == '[')
+            {
+                state = 4;
+                i++;
+            }
+            else if ((c >= 128 && c <= 135)
+                || c == 139  // Left key.
+                || c == 142  // O key.
+                || c == 145  // Right key.
+                || c == 148  // Up key.
+                || c == 151) // X key.
+            {
+                count++;
+            }
+        }
+    }
+
+    if (count == 0)
+    {
+        return; // No changes needed.
+    }
+
+    // Compute new size with added quotes.
+    size_t new_size = cart->code_size + count * 2;
+    uint8_t* new_code = (uint8_t*)SDL_malloc(new_size + 1); // +1 for null terminator.
+    if (!new_code)
+    {
+        SDL_Log("Memory reallocation failed!");
+        return;
+    }
+
+    // Pass 2: copy bytes into new_code, wrapping special bytes outside string literals.
+    state = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < cart->code_size; i++)
+    {
+        unsigned char c = (unsigned char)cart->code[i];
+
+        if (state == 1) // Double-quoted string.
+        {
+            new_code[j++] = c;
+            if (c == '\\' && i + 1 < cart->code_size)
+                new_code[j++] = (unsigned char)cart->code[++i]; // Copy escaped character.
+            else if (c == '"')
+                state = 0;
+        }
+        else if (state == 2) // Single-quoted string.
+        {
+            new_code[j++] = c;
+            if (c == '\\' && i + 1 < cart->code_size)
+            {
+                new_code[j++] = (unsigned char)cart->code[++i]; // Copy escaped character.
+            }
+            else if (c == '\'')
+            {
+                state = 0;
+            }
+        }
+        else if (state == 3) // Line comment.
+        {
+            new_code[j++] = c;
+            if (c == '\n')
+            {
+                state = 0;
+            }
+        }
+        else if (state == 4) // Long string.
+        {
+            new_code[j++] = c;
+            if (c == ']' && i + 1 < cart->code_size && (unsigned char)cart->code[i + 1] == ']')
+            {
+                new_code[j++] = (unsigned char)cart->code[++i];
+                state = 0;
+            }
+        }
+        else // Normal code.
+        {
+            if (c == '"') {
+                state = 1; new_code[j++] = c;
+            }
+            else if (c == '\'') {
+                state = 2; new_code[j++] = c;
+            }
+            else if (c == '-' && i + 1 < cart->code_size && (unsigned char)cart->code[i + 1] == '-')
+            {
+                new_code[j++] = c;
+                new_code[j++] = (unsigned char)cart->code[++i];
+                if (i + 2 < cart->code_size && (unsigned char)cart->code[i + 1] == '[' && (unsigned char)cart->code[i + 2] == '[')
+                {
+                    new_code[j++] = (unsigned char)cart->code[++i];
+                    new_code[j++] = (unsigned char)cart->code[++i];
+                    state = 4;
+                }
+                else state = 3;
+            }
+            else if (c == '[' && i + 1 < cart->code_size && (unsigned char)cart->code[i + 1] == '[')
+            {
+                state = 4;
+                new_code[j++] = c;
+                new_code[j++] = (unsigned char)cart->code[++i];
+            }
+            else if ((c >= 128 && c <= 135)
+                || c == 139  // Left key.
+                || c == 142  // O key.
+                || c == 145  // Right key.
+                || c == 148  // Up key.
+                || c == 151) // X key.
+            {
+                new_code[j++] = '"';
+                new_code[j++] = c;
+                new_code[j++] = '"';
+            }
+            else
+            {
+                new_code[j++] = c;
+            }
+        }
+    }
+    new_code[j] = '\0';
+
+    if (cart->owns_code)
+    {
+        SDL_free(cart->code);
+    }
+    cart->code = new_code;
+    cart->code_size = new_size;
+    cart->owns_code = true;
+}
+
+// Unpacks the code stored in the ROM at 0x4300.
+static void decode_rom_code(cart_t* cart)
+{
+    uint8_t* rom_code = &cart->cart_data[0x4300];
+    uint32_t header = *(uint32_t*)rom_code;
+    int status;
+
+    if (0x003a633a != header && 0x61787000 != header)
+    {
+        // Uncompressed code is run in place.
+        uint32_t size = 0;
+        while (size < CART_DATA_SIZE - 0x4300 && rom_code[size] != 0)
+        {
+            size++;
+        }
+
+        cart->code = rom_code;
+        cart->code_size = size;
+        cart->owns_code = false;
+        return;
+    }
+
+    cart->code = SDL_calloc(MAX_CODE_SIZE, sizeof(uint8_t));
+    if (!cart->code)
+    {
+        SDL_Log("Could not allocate code memory: %s", SDL_GetError());
+        cart->is_corrupt = true;
+        return;
+    }
+    cart->owns_code = true;
+
+    if (0x003a633a == header) // :c: followed by \x00
+    {
+        // Code is compressed (old format).
+        status = decompress_mini(rom_code, CART_DATA_SIZE - 0x4300, cart->code, MAX_CODE_SIZE);
+    }
+    else // \x00 followed by pxa
+    {
+        // Code is compressed (new format, v0.2.0+).
+        status = pxa_decompress(rom_code, CART_DATA_SIZE - 0x4300, cart->code, MAX_CODE_SIZE);
+    }
+
+    if (status <= 0)
+    {
+        SDL_free(cart->code);
+        cart->code = NULL;
+        cart->owns_code = false;
+        cart->is_corrupt = (status < 0);
+        return;
+    }
+    cart->code_size = (uint32_t)status;
+
+    // Release the allocated memory we don't need.
+    uint8_t* code = SDL_realloc(cart->code, cart->code_size);
+    if (code)
+    {
+        cart->code = code;
+    }
+}
+
+bool parse_cart(uint8_t* data, size_t size, cart_format_t format, cart_t* cart, uint8_t** image)
+{
+    uint8_t* picture = NULL;
+
+    free_cart_code(cart);
+    SDL_memset(cart->cart_data, 0, sizeof(cart->cart_data));
+    cart->is_corrupt = false;
+
+    switch (format)
+    {
+        case CART_FORMAT_PNG:
+        {
+            int width, height, bpp;
+
+            picture = stbi_load_from_memory(data, (int)size, &width, &height, &bpp, 4);
+            if (!picture)
+            {
+                SDL_Log("Couldn't load image data: %s", stbi_failure_reason());
+                return false;
+            }
+
+            if (width != CART_WIDTH || height != CART_HEIGHT)
+            {
+                SDL_Log("Invalid image size: %dx%d", width, height);
+                SDL_free(picture);
+                return false;
+            }
+
+            extract_pico8_data(picture, cart->cart_data);
+            break;
+        }
+        case CART_FORMAT_ROM:
+        {
+            if (size < 0x4300)
+            {
+                SDL_Log("Invalid ROM size: %u bytes", (unsigned)size);
+                return false;
+            }
+
+            SDL_memcpy(cart->cart_data, data, size < CART_DATA_SIZE ? size : CART_DATA_SIZE);
+            break;
+        }
+        case CART_FORMAT_P8:
+        {
+            if (image && !(picture = create_cart_image()))
+            {
+                return false;
+            }
+
+            if (!parse_p8(data, size, cart, picture))
+            {
+                SDL_free(picture);
+                return false;
+            }
+            break;
+        }
+        default:
+        {
+            SDL_Log("Unknown cart format");
+            return false;
+        }
+    }
+
+    cart->is_text = (format == CART_FORMAT_P8);
+
+    if (image)
+    {
+        if (!picture && !(picture = create_cart_image()))
+        {
+            free_cart_code(cart);
+            return false;
+        }
+        *image = picture;
+    }
+    else
+    {
+        SDL_free(picture);
+    }
+
+    return true;
+}
+
+bool read_cart(const char* file_name, cart_t* cart, uint8_t** image)
+{
+    FILE* file = fopen(file_name, "rb");
+    if (!file)
+    {
+        SDL_Log("Couldn't open file: %s", file_name);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t* data = (file_size > 0) ? (uint8_t*)SDL_calloc(file_size, sizeof(uint8_t)) : NULL;
+    if (!data)
+    {
+        SDL_Log("Couldn't allocate memory for cart data");
+        fclose(file);
+        return false;
+    }
+    fread(data, 1, file_size, file);
+    fclose(file);
+
+    cart_format_t format = get_cart_format(file_name);
+    if (!parse_cart(data, (size_t)file_size, format, cart, image))
+    {
+        SDL_free(data);
+        return false;
+    }
+
+    // Keep the file around, the code still lives in it.
+    if (format == CART_FORMAT_P8)
+    {
+        cart->source = data;
+    }
+    else
+    {
+        SDL_free(data);
+    }
+
+    return true;
+}
+
+bool load_cart_code(cart_t* cart)
+{
+    if (cart->has_code)
+    {
+        return !cart->is_corrupt;
+    }
+
+    if (cart->is_text)
+    {
+        cart->is_corrupt = !convert_code_to_p8scii(cart);
+    }
+    else
+    {
+        decode_rom_code(cart);
+    }
+
+    if (!cart->is_corrupt)
+    {
+        patch_cart_code(cart);
+    }
+
+    // Once the code has its own copy, the file isn't needed any more.
+    if (cart->owns_code && cart->source)
+    {
+        SDL_free(cart->source);
+        cart->source = NULL;
+    }
+
+    cart->has_code = true;
+    return !cart->is_corrupt;
+}
+
+void free_cart_code(cart_t* cart)
+{
+    if (cart->owns_code)
+    {
+        SDL_free(cart->code);
+    }
+
+    if (cart->source)
+    {
+        SDL_free(cart->source);
+    }
+
+    cart->code = NULL;
+    cart->code_size = 0;
+    cart->source = NULL;
+    cart->owns_code = false;
+    cart->has_code = false;
+}
+
+const uint8_t* load_cart_rom(const char* file_name)
+{
+    cart_cache_entry_t* entry = NULL;
+    int victim = -1;
+
+    if (!cart_cache)
+    {
+        cart_cache = (cart_cache_entry_t**)SDL_calloc(cart_cache_size, sizeof(cart_cache_entry_t*));
+        if (!cart_cache)
+        {
+            SDL_Log("Couldn't allocate memory for cart cache");
+            return NULL;
+        }
+    }
+
+    // Look the cart up and pick a free or the least recently used entry in
+    // case it isn't there.
+    for (int i = 0; i < cart_cache_size; i++)
+    {
+        if (!cart_cache[i])
+        {
+            if (victim < 0 || cart_cache[victim])
+            {
+                victim = i;
+            }
+            continue;
+        }
+
+        if (SDL_strcmp(cart_cache[i]->file_name, file_name) == 0)
+        {
+            cart_cache_hits++;
+            cart_cache[i]->last_used = ++cart_cache_clock;
+            return cart_cache[i]->rom;
+        }
+
+        if (victim < 0 || (cart_cache[victim] && cart_cache[i]->last_used < cart_cache[victim]->last_used))
+        {
+            victim = i;
+        }
+    }
+
+    cart_t* cart = (cart_t*)SDL_calloc(1, sizeof(cart_t));
+    if (!cart)
+    {
+        SDL_Log("Couldn't allocate memory for cart data");
+        return NULL;
+    }
+
+    if (!read_cart(file_name, cart, NULL))
+    {
+        SDL_free(cart);
+        return NULL;
+    }
+    free_cart_code(cart);
+
+    cart_cache_misses++;
+
+    entry = cart_cache[victim];
+    if (!entry)
+    {
+        entry = (cart_cache_entry_t*)SDL_calloc(1, sizeof(cart_cache_entry_t));
+        if (!entry)
+        {
+            SDL_Log("Couldn't allocate memory for cart cache");
+            SDL_free(cart);
+            return NULL;
+        }
+        cart_cache[victim] = entry;
+    }
+
+    SDL_free(entry->file_name);
+    entry->file_name = SDL_strdup(file_name);
+    if (!entry->file_name)
+    {
+        SDL_free(entry);
+        cart_cache[victim] = NULL;
+        SDL_free(cart);
+        return NULL;
+    }
+
+    SDL_memcpy(entry->rom, cart->cart_data, CART_ROM_SIZE);
+    entry->last_used = ++cart_cache_clock;
+    SDL_free(cart);
+
+    return entry->rom;
+}
+
+void get_cart_cache_stats(uint32_t* hits, uint32_t* misses)
+{
+    *hits = cart_cache_hits;
+    *misses = cart_cache_misses;
+}
+
+void clear_cart_cache(void)
+{
+    if (!cart_cache)
+    {
+        return;
+    }
+
+    for (int i = 0; i < cart_cache_size; i++)
+    {
+        if (cart_cache[i])
+        {
+            SDL_free(cart_cache[i]->file_name);
+            SDL_free(cart_cache[i]);
+        }
+    }
+    SDL_free(cart_cache);
+    cart_cache = NULL;
+}
+
+void set_cart_cache_size(int entries)
+{
+    clear_cart_cache();
+    cart_cache_size = SDL_max(entries, 1);
+}
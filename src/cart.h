@@ -0,0 +1,62 @@
+/** @file cart.h
+ *
+ *  A portable PICO-8 emulator written in C.
+ *
+ *  Copyright (c) 2025-2026, Michael Fitzmayer. All rights reserved.
+ *  SPDX-License-Identifier: MIT
+ *
+ **/
+
+#ifndef CART_H
+#define CART_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "auxiliary.h"
+
+// Number of cart ROMs kept around for reload() from other carts by default,
+// each one takes 17 KB.  See set_cart_cache_size.
+#define CART_CACHE_SIZE 4
+
+#define CART_ROM_SIZE 0x4300
+
+typedef enum cart_format
+{
+    CART_FORMAT_UNKNOWN,
+    CART_FORMAT_PNG, // .p8.png: data hidden in the image.
+    CART_FORMAT_P8,  // .p8: plain text.
+    CART_FORMAT_ROM  // .p8.rom: raw memory image.
+
+} cart_format_t;
+
+cart_format_t get_cart_format(const char* file_name);
+
+// Decodes the ROM of a cart held in memory into cart->cart_data; the code
+// is left for load_cart_code.  Text carts are not copied: cart->code may
+// point into data, which must then outlive it.  If image is not NULL, it
+// receives a CART_WIDTH x CART_HEIGHT RGBA32 picture for the menu, to be
+// released with SDL_free.  Returns false if the data is not a cart.
+bool parse_cart(uint8_t* data, size_t size, cart_format_t format, cart_t* cart, uint8_t** image);
+
+// Same as parse_cart, but reads the cart from a file and keeps the contents
+// of text carts alive in cart->source.
+bool read_cart(const char* file_name, cart_t* cart, uint8_t** image);
+
+// Decompresses and patches the code on first use and keeps it for the
+// following runs.  Returns false if the code can't be decoded.
+bool load_cart_code(cart_t* cart);
+void free_cart_code(cart_t* cart);
+
+// Returns the ROM (0x0000-0x42ff) of another cart, decoding it only if it
+// isn't cached yet.  The pointer is valid until the next call.
+const uint8_t* load_cart_rom(const char* file_name);
+void get_cart_cache_stats(uint32_t* hits, uint32_t* misses);
+void clear_cart_cache(void);
+
+// Sets how many ROMs load_cart_rom keeps, no less than 1, and drops the ones
+// it kept so far.  Lower it for targets that are short on memory.
+void set_cart_cache_size(int entries);
+
+#endif // CART_H
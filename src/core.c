@@ -13,16 +13,20 @@
 #include <string.h>
 
 #include "auxiliary.h"
-#include "lexaloffle/p8_compress.h"
 #include "z8lua/lua.h"
 #include "z8lua/lualib.h"
 #include "api.h"
 #include "app.h"
+#include "cart.h"
 #include "core.h"
 #include "memory.h"
+#include "pool.h"
 
 #define STBI_ONLY_PNG
 #define STBI_NO_THREAD_LOCALS
+#define STBI_MALLOC SDL_malloc
+#define STBI_REALLOC SDL_realloc
+#define STBI_FREE SDL_free
 #define STB_IMAGE_IMPLEMENTATION
 #include "misc/stb_image.h"
 
@@ -49,6 +53,7 @@ static int num_carts;
 
 static state_t state;
 static lua_State* vm;
+static pool_t vm_pool;
 
 static int prev_selection;
 static int selection;
@@ -57,6 +62,77 @@ static bool has_update;
 static bool has_update60;
 static bool has_draw;
 
+// The names of the cart's entry points are interned once and kept in the
+// registry, so calling them does not hash a string every frame. The functions
+// themselves are still looked up each time, as carts swap _update and _draw.
+typedef enum
+{
+    ENTRY_INIT,
+    ENTRY_UPDATE,
+    ENTRY_UPDATE60,
+    ENTRY_DRAW,
+    ENTRY_COUNT
+
+} entry_t;
+
+static const char* const entry_names[ENTRY_COUNT] = { "_init", "_update", "_update60", "_draw" };
+static int entry_refs[ENTRY_COUNT];
+
+// The GC does its work in the time left over after each frame is presented.
+// The collector's own pause is raised so that it only starts a cycle inside
+// _update/_draw as a backstop, if the cart allocates faster than the slack
+// can keep up with.
+#define GC_PAUSE 400           // Backstop: auto cycle once the heap has grown 4x.
+#define GC_SLACK_GROWTH 2      // Slack cycle once the heap has doubled.
+#define GC_SLACK_RESERVE_NS 1000000 // Left to SDL_Delay's granularity.
+
+static int gc_live_kb;         // Heap size after the last finished cycle.
+static bool gc_in_cycle;
+static Uint64 gc_slack_ns;     // Time spent in the slack, logged with the pool stats.
+static Uint64 gc_slack_max_ns;
+static int gc_slack_work;      // LUA_GCWORK done in the slack, in KB.
+static uint32_t gc_frames;
+
+// The last GC_STATS_FRAMES frames, logged as percentiles when the VM closes.
+// Busy time runs from the start of the frame until it is presented, so it
+// includes the steps the allocator triggers inside _update/_draw. Those
+// steps can't be timed apart from the cart, so their work is priced at the
+// rate the slack collects at.
+#define GC_STATS_FRAMES 1024
+
+static Uint32 frame_busy_ns[GC_STATS_FRAMES];
+static Uint32 frame_slack_ns[GC_STATS_FRAMES];
+static Uint32 frame_cart_kb[GC_STATS_FRAMES]; // LUA_GCWORK inside the callbacks.
+
+// Lua heap limit in KB, from the OPEN8_HEAP_KB hint (or environment variable).
+// Defaults to the 2 MB PICO-8 gives a cart; 0 disables the limit.
+#define HEAP_LIMIT_HINT "OPEN8_HEAP_KB"
+#define HEAP_LIMIT_KB 2048
+
+// Number of cart ROMs cached for reload(), from the OPEN8_CART_CACHE hint (or
+// environment variable).  Defaults to CART_CACHE_SIZE.
+#define CART_CACHE_HINT "OPEN8_CART_CACHE"
+
+// GC mode, from the OPEN8_GC hint (or environment variable): "incremental",
+// "generational" or "auto". Auto, the default, runs the first frames of a
+// cart in each mode and keeps the one that did less GC work.
+#define GC_MODE_HINT "OPEN8_GC"
+#define GC_SAMPLE_FRAMES 120
+
+typedef enum
+{
+    GC_INCREMENTAL,
+    GC_GENERATIONAL,
+    GC_AUTO
+
+} gc_mode_t;
+
+static gc_mode_t gc_mode;
+static bool gc_generational;
+static int gc_sample_frame;
+static int gc_sample_start;    // LUA_GCWORK at the start of a sample.
+static int gc_sample_work;     // GC work of the incremental sample.
+
 static SDL_Texture* overlay;
 
 SDL_FRect cart_rect;
@@ -80,22 +156,6 @@ static const touch_region* get_touch_regions(int* count)
     return touch_regions;
 }
 
-static void* mem_allocator(void* ud, void* ptr, size_t osize, size_t nsize)
-{
-    (void)ud;
-    (void)osize;
-
-    if (nsize == 0)
-    {
-        SDL_free(ptr);
-        return NULL;
-    }
-    else
-    {
-        return SDL_realloc(ptr, nsize);
-    }
-}
-
 static void update_touch_input(SDL_Renderer* renderer)
 {
     // Poll all active fingers for simultaneous multi-touch input in emulator mode.
@@ -171,323 +231,151 @@ static void update_touch_input(SDL_Renderer* renderer)
     }
 }
 
+static gc_mode_t get_gc_mode(void)
+{
+    const char* hint = SDL_GetHint(GC_MODE_HINT);
+
+    if (hint && SDL_strcasecmp(hint, "incremental") == 0)
+    {
+        return GC_INCREMENTAL;
+    }
+    if (hint && SDL_strcasecmp(hint, "generational") == 0)
+    {
+        return GC_GENERATIONAL;
+    }
+    return GC_AUTO;
+}
+
+static size_t get_heap_limit(void)
+{
+    const char* hint = SDL_GetHint(HEAP_LIMIT_HINT);
+    int limit_kb = hint ? SDL_atoi(hint) : HEAP_LIMIT_KB;
+
+    return limit_kb > 0 ? (size_t)limit_kb * 1024 : 0;
+}
+
+static void set_gc_generational(bool generational)
+{
+    lua_gc(vm, generational ? LUA_GCGEN : LUA_GCINC, 0);
+    gc_generational = generational;
+    gc_in_cycle = false;
+    gc_live_kb = lua_gc(vm, LUA_GCCOUNT, 0);
+}
+
 static bool init_vm(SDL_Renderer* renderer)
 {
-    vm = lua_newstate(mem_allocator, NULL);
+    Uint64 start = SDL_GetTicksNS();
+    init_pool(&vm_pool);
+    vm_pool.limit = get_heap_limit();
+    vm = lua_newstate(pool_allocator, &vm_pool);
     if (!vm)
     {
         SDL_Log("Couldn't create Lua state.");
         return false;
     }
     lua_setpico8memory(vm, pico8_ram);
-    luaL_openlibs(vm);
+    lua_gc(vm, LUA_GCSETPAUSE, GC_PAUSE);
+    gc_live_kb = 0;
+    gc_in_cycle = false;
+    gc_slack_ns = 0;
+    gc_slack_max_ns = 0;
+    gc_slack_work = 0;
+    gc_frames = 0;
+    gc_generational = false;
+    gc_sample_frame = 0;
+    gc_mode = get_gc_mode();
+    if (gc_mode == GC_GENERATIONAL)
+    {
+        set_gc_generational(true);
+    }
+    luaL_opencartlibs(vm, VM_GLOBALS);
     init_api(vm);
+    for (int i = 0; i < ENTRY_COUNT; i++)
+    {
+        lua_pushstring(vm, entry_names[i]);
+        entry_refs[i] = luaL_ref(vm, LUA_REGISTRYINDEX);
+    }
 
     if (luaL_dostring(vm, "log('Lua VM initialized successfully')"))
     {
         SDL_Log("Lua VM could not be initialised: %s", lua_tostring(vm, -1));
         return false;
     }
-    SDL_Log("Lua memory usage: %d bytes",
-        lua_gc(vm, LUA_GCCOUNT, 0) * 1024 + lua_gc(vm, LUA_GCCOUNTB, 0));
+    SDL_Log("Lua memory usage: %d bytes, set up in %.3f ms",
+        lua_gc(vm, LUA_GCCOUNT, 0) * 1024 + lua_gc(vm, LUA_GCCOUNTB, 0),
+        (SDL_GetTicksNS() - start) / 1e6);
 
     return true;
 }
 
-static void destroy_vm(void)
+static int compare_uint32(const void* a, const void* b)
 {
-    if (vm)
-    {
-        lua_close(vm);
-        vm = NULL;
-    }
+    Uint32 x = *(const Uint32*)a;
+    Uint32 y = *(const Uint32*)b;
+    return (x > y) - (x < y);
 }
 
-static void extract_pico8_data(uint8_t* image_data, uint8_t* cart_data)
+// Sorts the first count values in place and returns the given percentile.
+static Uint32 percentile(Uint32* values, uint32_t count, uint32_t percent)
 {
-    size_t data_index = 0;
-    size_t pixel_count = CART_WIDTH * CART_HEIGHT;
-
-    // Each Pico-8 byte is stored as the two least significant bits of each of the four
-    // channels, ordered ARGB (E.g: the A channel stores the 2 most significant bits in
-    // the bytes).  The image is 160 pixels wide and 205 pixels high, for a possible
-    // storage of 32,800 (0x8020) bytes.
-
-    for (size_t i = 0; i < pixel_count; i++)
-    {
-        if (data_index >= CART_DATA_SIZE)
-        {
-            break;
-        }
-
-        // stb_image stores components in RGBA32 order
-        uint8_t R = image_data[i * 4];     // R channel
-        uint8_t G = image_data[i * 4 + 1]; // G channel
-        uint8_t B = image_data[i * 4 + 2]; // B channel
-        uint8_t A = image_data[i * 4 + 3]; // A channel
-
-        // Extract the 2 least significant bits from each channel.
-        uint8_t byte = ((A & 0x03) << 6) | ((R & 0x03) << 4) | ((G & 0x03) << 2) | ((B & 0x03) << 0);
-
-        // Clean up graphical artifacts visible on 32bpp displays
-        image_data[i * 4] = (R & 0xFC) | (R >> 6);
-        image_data[i * 4 + 1] = (G & 0xFC) | (G >> 6);
-        image_data[i * 4 + 2] = (B & 0xFC) | (B >> 6);
-        image_data[i * 4 + 3] = (A & 0xFC) | (A >> 6);
-
-        cart_data[data_index] = byte;
-        data_index++;
-    }
+    SDL_qsort(values, count, sizeof(Uint32), compare_uint32);
+    return values[(count - 1) * percent / 100];
 }
 
-// It's in fact easier to patch the code than parsing the preset
-// fill-pattern characters using the Lua C-API.
-static void patch_cart_code(cart_t* cart)
+static void log_frame_stats(void)
 {
-    // State machine: 0=normal, 1=double-quote string, 2=single-quote string,
-    //                3=line comment, 4=long string [[...]].
-    // Special bytes are only wrapped when in normal code (state 0).
-    size_t count = 0;
-    int state = 0;
-
-    // Pass 1: count special bytes that appear outside string literals and comments.
-    for (size_t i = 0; i < cart->code_size; i++)
-    {
-        unsigned char c = (unsigned char)cart->code[i];
-
-        if (state == 1) // Double-quoted string.
-        {
-            if (c == '\\')
-            {
-                i++; // Skip escaped character.
-            }
-            else if (c == '"')
-            {
-                state = 0;
-            }
-        }
-        else if (state == 2) // Single-quoted string.
-        {
-            if (c == '\\')
-            {
-                i++; // Skip escaped character.
-            }
-            else if (c == '\'')
-            {
-                state = 0;
-            }
-        }
-        else if (state == 3) // Line comment.
-        {
-            if (c == '\n')
-            {
-                state = 0;
-            }
-        }
-        else if (state == 4) // Long string.
-        {
-            if (c == ']' && i + 1 < cart->code_size && (unsigned char)cart->code[i + 1] == ']')
-            {
-                state = 0;
-                i++;
-            }
-        }
-        else // Normal code.
-        {
-            if (c == '"')
-            {
-                state = 1;
-            }
-            else if (c == '\'')
-            {
-                state = 2;
-            }
-            else if (c == '-' && i + 1 < cart->code_size && (unsigned char)cart->code[i + 1] == '-')
-            {
-                i++;
-                if (i + 2 < cart->code_size && (unsigned char)cart->code[i + 1] == '[' && (unsigned char)cart->code[i + 2] == '[')
-                {
-                    state = 4;
-                    i += 2;
-                }
-                else
-                {
-                    state = 3;
-                }
-            }
-            else if (c == '[' && i + 1 < cart->code_size && (unsigned char)cart->code[i + 1] == '[')
-            {
-                state = 4;
-                i++;
-            }
-            else if ((c >= 128 && c <= 135)
-                || c == 139  // Left key.
-                || c == 142  // O key.
-                || c == 145  // Right key.
-                || c == 148  // Up key.
-                || c == 151) // X key.
-            {
-                count++;
-            }
-        }
-    }
-
+    static Uint32 gc_ns[GC_STATS_FRAMES];
+    static Uint32 cart_gc_ns[GC_STATS_FRAMES];
+    uint32_t count = SDL_min(gc_frames, GC_STATS_FRAMES);
     if (count == 0)
     {
-        return; // No changes needed.
-    }
-
-    // Compute new size with added quotes.
-    size_t new_size = cart->code_size + count * 2;
-    uint8_t* new_code = (uint8_t*)SDL_malloc(new_size + 1); // +1 for null terminator.
-    if (!new_code)
-    {
-        SDL_Log("Memory reallocation failed!");
         return;
     }
 
-    // Pass 2: copy bytes into new_code, wrapping special bytes outside string literals.
-    state = 0;
-    size_t j = 0;
-    for (size_t i = 0; i < cart->code_size; i++)
+    double ns_per_kb = gc_slack_work > 0 ? (double)gc_slack_ns / gc_slack_work : 0.0;
+    for (uint32_t i = 0; i < count; i++)
     {
-        unsigned char c = (unsigned char)cart->code[i];
-
-        if (state == 1) // Double-quoted string.
-        {
-            new_code[j++] = c;
-            if (c == '\\' && i + 1 < cart->code_size)
-                new_code[j++] = (unsigned char)cart->code[++i]; // Copy escaped character.
-            else if (c == '"')
-                state = 0;
-        }
-        else if (state == 2) // Single-quoted string.
-        {
-            new_code[j++] = c;
-            if (c == '\\' && i + 1 < cart->code_size)
-            {
-                new_code[j++] = (unsigned char)cart->code[++i]; // Copy escaped character.
-            }
-            else if (c == '\'')
-            {
-                state = 0;
-            }
-        }
-        else if (state == 3) // Line comment.
-        {
-            new_code[j++] = c;
-            if (c == '\n')
-            {
-                state = 0;
-            }
-        }
-        else if (state == 4) // Long string.
-        {
-            new_code[j++] = c;
-            if (c == ']' && i + 1 < cart->code_size && (unsigned char)cart->code[i + 1] == ']')
-            {
-                new_code[j++] = (unsigned char)cart->code[++i];
-                state = 0;
-            }
-        }
-        else // Normal code.
-        {
-            if (c == '"') {
-                state = 1; new_code[j++] = c;
-            }
-            else if (c == '\'') {
-                state = 2; new_code[j++] = c;
-            }
-            else if (c == '-' && i + 1 < cart->code_size && (unsigned char)cart->code[i + 1] == '-')
-            {
-                new_code[j++] = c;
-                new_code[j++] = (unsigned char)cart->code[++i];
-                if (i + 2 < cart->code_size && (unsigned char)cart->code[i + 1] == '[' && (unsigned char)cart->code[i + 2] == '[')
-                {
-                    new_code[j++] = (unsigned char)cart->code[++i];
-                    new_code[j++] = (unsigned char)cart->code[++i];
-                    state = 4;
-                }
-                else state = 3;
-            }
-            else if (c == '[' && i + 1 < cart->code_size && (unsigned char)cart->code[i + 1] == '[')
-            {
-                state = 4;
-                new_code[j++] = c;
-                new_code[j++] = (unsigned char)cart->code[++i];
-            }
-            else if ((c >= 128 && c <= 135)
-                || c == 139  // Left key.
-                || c == 142  // O key.
-                || c == 145  // Right key.
-                || c == 148  // Up key.
-                || c == 151) // X key.
-            {
-                new_code[j++] = '"';
-                new_code[j++] = c;
-                new_code[j++] = '"';
-            }
-            else
-            {
-                new_code[j++] = c;
-            }
-        }
+        cart_gc_ns[i] = (Uint32)SDL_min(frame_cart_kb[i] * ns_per_kb, (double)SDL_MAX_UINT32);
+        gc_ns[i] = (Uint32)SDL_min((Uint64)frame_slack_ns[i] + cart_gc_ns[i], SDL_MAX_UINT32);
     }
-    new_code[j] = '\0';
 
-    SDL_free(cart->code);
-    cart->code = new_code;
-    cart->code_size = new_size;
+    SDL_Log("Last %u frames: busy p50 %.3f ms, p99 %.3f ms; GC p50 %.3f ms, p99 %.3f ms",
+        count, percentile(frame_busy_ns, count, 50) / 1e6, percentile(frame_busy_ns, count, 99) / 1e6,
+        percentile(gc_ns, count, 50) / 1e6, percentile(gc_ns, count, 99) / 1e6);
+    SDL_Log("GC inside the callbacks: p50 %.3f ms, p99 %.3f ms (%u KB of work at p99, %.3f ms per MB)",
+        percentile(cart_gc_ns, count, 50) / 1e6, percentile(cart_gc_ns, count, 99) / 1e6,
+        percentile(frame_cart_kb, count, 99), ns_per_kb * 1024 / 1e6);
 }
 
-static int load_cart(SDL_Renderer* renderer, const char* file_name, cart_t* cart)
+static void destroy_vm(void)
 {
-    int width, height, bpp;
-
-    FILE* file = fopen(file_name, "rb");
-    if (!file)
-    {
-        SDL_Log("Couldn't open file: %s", file_name);
-        return 0;
-    }
-
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    uint8_t* data = (uint8_t*)SDL_calloc(file_size, sizeof(uint8_t));
-    if (!data)
+    if (vm)
     {
-        SDL_Log("Couldn't allocate memory for cart data");
-        fclose(file);
-        return 0;
+        lua_close(vm);
+        vm = NULL;
+        SDL_Log("GC in the frame slack: %.3f ms over %u frames, at most %.3f ms per frame",
+            gc_slack_ns / 1e6, gc_frames, gc_slack_max_ns / 1e6);
+        log_frame_stats();
+        log_pool_stats(&vm_pool);
     }
-    fread(data, 1, file_size, file);
-    fclose(file);
+    destroy_pool(&vm_pool);
+}
 
-    uint8_t* image_data = stbi_load_from_memory(data, file_size, &width, &height, &bpp, 4);
-    if (!image_data)
-    {
-        SDL_Log("Couldn't load image data: %s", stbi_failure_reason());
-        SDL_free(data);
-        return 0;
-    }
-    SDL_free(data);
+static int load_cart(SDL_Renderer* renderer, const char* file_name, cart_t* cart)
+{
+    uint8_t* image_data = NULL;
 
-    if (width != CART_WIDTH || height != CART_HEIGHT)
+    if (!read_cart(file_name, cart, &image_data))
     {
-        SDL_Log("Invalid image size: %dx%d", width, height);
-        stbi_image_free(image_data);
         return 0;
     }
 
-    extract_pico8_data(image_data, cart->cart_data);
-
-    cart->image = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, width, height);
+    cart->image = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, CART_WIDTH, CART_HEIGHT);
     if (!cart->image)
     {
         SDL_Log("Couldn't create texture: %s", SDL_GetError());
-        stbi_image_free(image_data);
+        SDL_free(image_data);
+        free_cart_code(cart);
         return 0;
     }
 
@@ -496,124 +384,162 @@ static int load_cart(SDL_Renderer* renderer, const char* file_name, cart_t* cart
         SDL_Log("Couldn't set texture blend mode: %s", SDL_GetError());
     }
 
-    if (!SDL_UpdateTexture(cart->image, NULL, image_data, width * 4))
+    if (!SDL_UpdateTexture(cart->image, NULL, image_data, CART_WIDTH * 4))
     {
         SDL_Log("Couldn't update texture: %s", SDL_GetError());
         SDL_DestroyTexture(cart->image);
-        stbi_image_free(image_data);
+        cart->image = NULL;
+        SDL_free(image_data);
+        free_cart_code(cart);
         return 0;
     }
 
-    stbi_image_free(image_data);
+    SDL_free(image_data);
 
     if (!SDL_SetTextureScaleMode(cart->image, SDL_SCALEMODE_NEAREST))
     {
         SDL_Log("Couldn't set texture scale mode: %s", SDL_GetError());
     }
 
-    uint32_t header = *(uint32_t*)&cart->cart_data[0x4300];
-    int status = 0;
+    return 1;
+}
 
-    cart->code = SDL_calloc(MAX_CODE_SIZE, sizeof(uint8_t));
-    if (!cart->code)
+static void destroy_cart(cart_t* cart)
+{
+    if (!cart)
     {
-        SDL_Log("Could not allocate code memory: %s", SDL_GetError());
-        SDL_DestroyTexture(cart->image);
-        return 0;
+        return;
     }
 
-    if (0x003a633a == header) // :c: followed by \x00
+    if (cart->image)
     {
-        // Code is compressed (old format).
-        status = decompress_mini(&cart->cart_data[0x4300], cart->code, MAX_CODE_SIZE);
-        cart->code_size = cart->cart_data[0x4304] << 8 | cart->cart_data[0x4305];
+        SDL_DestroyTexture(cart->image);
+        cart->image = NULL;
     }
-    else if (0x61787000 == header) // \x00 followed by pxa
+
+    free_cart_code(cart);
+}
+
+static void push_entry(lua_State* L, entry_t entry)
+{
+    lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, entry_refs[entry]);
+    lua_gettable(L, -2);
+    lua_remove(L, -2);
+}
+
+static bool is_function_present(lua_State* L, entry_t entry)
+{
+    push_entry(L, entry);
+    bool exists = lua_isfunction(L, -1);
+    lua_pop(L, 1);
+    return exists;
+}
+
+static void call_pico8_function(lua_State* L, entry_t entry)
+{
+    push_entry(L, entry);
+
+    if (!lua_isfunction(L, -1))
     {
-        // Code is compressed (new format, v0.2.0+).
-        status = pxa_decompress(&cart->cart_data[0x4300], cart->code, MAX_CODE_SIZE);
-        cart->code_size = cart->cart_data[0x4304] << 8 | cart->cart_data[0x4305];
+        SDL_Log("%s is not a function (type=%s)", entry_names[entry], lua_typename(L, lua_type(L, -1)));
+        lua_pop(L, 1);
+        return;
     }
-    else
+
+    if (lua_pcall(L, 0, 0, 0) != LUA_OK)
     {
-        for (cart->code_size = 0; cart->code_size < MAX_CODE_SIZE; cart->code_size++)
+        // run() unwinds the cart with an error, that's expected.
+        if (!pico8_run_requested)
         {
-            if (cart->cart_data[0x4300 + cart->code_size] == 0)
-            {
-                break;
-            }
-            else
-            {
-                cart->code[cart->code_size] = cart->cart_data[0x4300 + cart->code_size];
-            }
+            SDL_Log("Error calling %s: %s", entry_names[entry], lua_tostring(L, -1));
         }
+        lua_pop(L, 1);
     }
+}
+
+// Runs incremental GC steps until deadline (SDL_GetTicksNS) and returns the
+// time spent. A new cycle is only started once the heap has grown enough
+// since the last one, and none at all while the collector is stopped.
+static Uint64 collect_in_slack(Uint64 deadline)
+{
+    Uint64 start = SDL_GetTicksNS();
 
-    // Release the allocated memory we don't need.
-    cart->code = SDL_realloc(cart->code, cart->code_size);
-    if (!cart->code)
+    if (!lua_gc(vm, LUA_GCISRUNNING, 0))
     {
-        SDL_Log("Could not re-allocate code memory: %s", SDL_GetError());
-        SDL_DestroyTexture(cart->image);
         return 0;
     }
 
-    if (status == 1)
+    if (!gc_in_cycle && lua_gc(vm, LUA_GCCOUNT, 0) < gc_live_kb * GC_SLACK_GROWTH)
     {
-        cart->is_corrupt = true;
+        return 0;
     }
-    else
+
+    if (gc_generational)
     {
-        cart->is_corrupt = false;
-        patch_cart_code(cart);
+        // A step is a whole minor (or major) collection.
+        lua_gc(vm, LUA_GCSTEP, 0);
+        gc_live_kb = lua_gc(vm, LUA_GCCOUNT, 0);
+        return SDL_GetTicksNS() - start;
     }
 
-    return 1;
+    while (SDL_GetTicksNS() + GC_SLACK_RESERVE_NS < deadline)
+    {
+        gc_in_cycle = true;
+        if (lua_gc(vm, LUA_GCSTEP, 0))
+        {
+            gc_in_cycle = false;
+            gc_live_kb = lua_gc(vm, LUA_GCCOUNT, 0);
+            break;
+        }
+    }
+
+    return SDL_GetTicksNS() - start;
 }
 
-static void destroy_cart(cart_t* cart)
+// In auto mode, measures the GC work of the first GC_SAMPLE_FRAMES frames in
+// incremental mode, then of as many in generational mode, and keeps
+// generational only if it did clearly less.
+static void sample_gc_mode(void)
 {
-    if (!cart)
+    if (gc_mode != GC_AUTO || gc_sample_frame > 2 * GC_SAMPLE_FRAMES)
     {
         return;
     }
 
-    if (cart->image)
+    if (gc_sample_frame == 0)
     {
-        SDL_DestroyTexture(cart->image);
+        gc_sample_start = lua_gc(vm, LUA_GCWORK, 0);
     }
-
-    if (cart->code)
+    else if (gc_sample_frame == GC_SAMPLE_FRAMES)
     {
-        SDL_free(cart->code);
+        gc_sample_work = lua_gc(vm, LUA_GCWORK, 0) - gc_sample_start;
+        set_gc_generational(true);
+        gc_sample_start = lua_gc(vm, LUA_GCWORK, 0);
     }
-    cart->code = NULL;
-}
-
-static bool is_function_present(lua_State* L, const char* func_name)
-{
-    lua_getglobal(L, func_name);
-    bool exists = lua_isfunction(L, -1);
-    lua_pop(L, 1);
-    return exists;
-}
-
-static void call_pico8_function(lua_State* L, const char* func_name)
-{
-    lua_getglobal(L, func_name);
-
-    if (!lua_isfunction(L, -1))
+    else if (gc_sample_frame == 2 * GC_SAMPLE_FRAMES)
     {
-        SDL_Log("%s is not a function (type=%s)", func_name, lua_typename(L, lua_type(L, -1)));
-        lua_pop(L, 1);
-        return;
+        int gen_work = lua_gc(vm, LUA_GCWORK, 0) - gc_sample_start;
+        bool keep = gen_work < gc_sample_work - gc_sample_work / 4;
+        if (!keep)
+        {
+            set_gc_generational(false);
+        }
+        SDL_Log("GC work over %d frames: incremental %d KB, generational %d KB; using %s mode",
+            GC_SAMPLE_FRAMES, gc_sample_work, gen_work, keep ? "generational" : "incremental");
     }
+    gc_sample_frame++;
+}
 
-    if (lua_pcall(L, 0, 0, 0) != LUA_OK)
+static void start_cartridge(lua_State* L)
+{
+    if (is_function_present(L, ENTRY_INIT))
     {
-        SDL_Log("Error calling %s: %s", func_name, lua_tostring(L, -1));
-        lua_pop(L, 1);
+        call_pico8_function(L, ENTRY_INIT);
     }
+    has_update = is_function_present(L, ENTRY_UPDATE);
+    has_update60 = is_function_present(L, ENTRY_UPDATE60);
+    has_draw = is_function_present(L, ENTRY_DRAW);
 }
 
 static void print_memory_usage(lua_State* L)
@@ -622,6 +548,33 @@ static void print_memory_usage(lua_State* L)
         lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0));
 }
 
+static void print_heap_census(lua_State* L)
+{
+    static const struct
+    {
+        int type;
+        const char* name;
+    } types[] = {
+        { LUA_TSTRING, "strings" },
+        { LUA_TTABLE, "tables" },
+        { LUA_TFUNCTION, "closures" },
+        { LUA_TTHREAD, "threads" },
+        { LUA_TUSERDATA, "userdata" },
+        { LUA_NUMTAGS, "prototypes" },
+        { LUA_NUMTAGS + 1, "upvalues" },
+    };
+    size_t count[LUA_NUMCENSUS];
+    size_t bytes[LUA_NUMCENSUS];
+
+    lua_census(L, count, bytes);
+    print_memory_usage(L);
+    for (int i = 0; i < (int)SDL_arraysize(types); i++)
+    {
+        SDL_Log("  %-10s %7u objects %9u bytes", types[i].name,
+            (unsigned)count[types[i].type], (unsigned)bytes[types[i].type]);
+    }
+}
+
 static bool run_script(SDL_Renderer* renderer, const char* file_name)
 {
     if (luaL_loadfile(vm, file_name) || lua_pcall(vm, 0, 0, 0))
@@ -634,13 +587,13 @@ static bool run_script(SDL_Renderer* renderer, const char* file_name)
 
     print_memory_usage(vm);
 
-    if (is_function_present(vm, "_init"))
+    if (is_function_present(vm, ENTRY_INIT))
     {
-        call_pico8_function(vm, "_init");
+        call_pico8_function(vm, ENTRY_INIT);
     }
-    has_update = is_function_present(vm, "_update");
-    has_update60 = is_function_present(vm, "_update60");
-    has_draw = is_function_present(vm, "_draw");
+    has_update = is_function_present(vm, ENTRY_UPDATE);
+    has_update60 = is_function_present(vm, ENTRY_UPDATE60);
+    has_draw = is_function_present(vm, ENTRY_DRAW);
     state = STATE_EMULATOR;
     return true;
 }
@@ -659,16 +612,20 @@ static bool run_cartridge(SDL_Renderer* renderer)
     // 0x0000-0x42ff
     SDL_memcpy(pico8_ram, get_cart()->cart_data, 0x42ff * sizeof(uint8_t));
 
-    if (!get_cart()->is_corrupt)
+    // The code is decoded on the first run only.
+    if (load_cart_code(get_cart()))
     {
         state = STATE_EMULATOR;
 
+        // Remember the pristine globals, so run() can start over from them.
+        save_base_globals(vm);
+
         // Try to load the (possibly patched) code buffer first. If that fails,
         // fall back to the original raw code bytes embedded in the cart data
         // (starting at 0x4300). Some carts rely on subtle encoding/escaping that
         // can be altered by our patcher; attempt the original on failure so
         // carts that work on real PICO-8 still run.
-        if (luaL_loadbuffer(vm, (const char*)get_cart()->code, get_cart()->code_size, "cart") || lua_pcall(vm, 0, 0, 0))
+        if (luaL_loadbuffer(vm, (const char*)get_cart()->code, get_cart()->code_size, "cart") || call_main_chunk(vm))
         {
             // Preserve the error message from the failed attempt.
             const char* err = lua_tostring(vm, -1);
@@ -677,14 +634,14 @@ static bool run_cartridge(SDL_Renderer* renderer)
             // Try loading original code bytes from cart.cart_data (offset 0x4300)
             // up to the first null terminator.
             size_t orig_size = 0;
-            while (orig_size < MAX_CODE_SIZE && get_cart()->cart_data[0x4300 + orig_size] != 0)
+            while (orig_size < CART_DATA_SIZE - 0x4300 && get_cart()->cart_data[0x4300 + orig_size] != 0)
             {
                 orig_size++;
             }
 
             if (orig_size > 0)
             {
-                if (luaL_loadbuffer(vm, (const char*)&get_cart()->cart_data[0x4300], orig_size, "cart") || lua_pcall(vm, 0, 0, 0))
+                if (luaL_loadbuffer(vm, (const char*)&get_cart()->cart_data[0x4300], orig_size, "cart") || call_main_chunk(vm))
                 {
                     SDL_Log("Could not run cartridge (patched or original): %s", lua_tostring(vm, -1));
                     lua_pop(vm, 1);
@@ -705,14 +662,7 @@ static bool run_cartridge(SDL_Renderer* renderer)
         }
 
         print_memory_usage(vm);
-
-        if (is_function_present(vm, "_init"))
-        {
-            call_pico8_function(vm, "_init");
-        }
-        has_update = is_function_present(vm, "_update");
-        has_update60 = is_function_present(vm, "_update60");
-        has_draw = is_function_present(vm, "_draw");
+        start_cartridge(vm);
     }
     else
     {
@@ -722,6 +672,33 @@ static bool run_cartridge(SDL_Renderer* renderer)
     return true;
 }
 
+// Restarts the running cart without recompiling it: the ROM is copied back
+// into memory and the main chunk runs again on a fresh copy of the globals.
+static bool restart_cartridge(SDL_Renderer* renderer)
+{
+    pico8_run_requested = false;
+
+    if (!vm)
+    {
+        return run_cartridge(renderer);
+    }
+
+    reset_memory();
+    SDL_memcpy(pico8_ram, get_cart()->cart_data, 0x42ff * sizeof(uint8_t));
+
+    if (restart_main_chunk(vm) != LUA_OK)
+    {
+        SDL_Log("Could not restart cartridge: %s", lua_tostring(vm, -1));
+        lua_pop(vm, 1);
+        return false;
+    }
+
+    // Drop what's left of the previous run before the cart starts again.
+    lua_gc(vm, LUA_GCCOLLECT, 0);
+    start_cartridge(vm);
+    return true;
+}
+
 static void select_next_cartridge(SDL_Renderer* renderer)
 {
     destroy_cart(get_cart());
@@ -809,7 +786,7 @@ void handle_resize(SDL_Renderer* renderer) {
 
 static SDL_EnumerationResult dir_callback(void* userdata, const char* dirname, const char* fname)
 {
-    if (SDL_strstr(fname, ".PNG") || (SDL_strstr(fname, ".png")))
+    if (get_cart_format(fname) != CART_FORMAT_UNKNOWN)
     {
         available_carts = SDL_realloc(available_carts, (num_carts + 1) * sizeof(char*));
         SDL_asprintf(&available_carts[num_carts], "%s%s", dirname, fname);
@@ -925,6 +902,9 @@ bool init_core(SDL_Renderer* renderer)
         SDL_Log("Failed to load overlay.");
     }
 
+    const char* hint = SDL_GetHint(CART_CACHE_HINT);
+    set_cart_cache_size(hint ? SDL_atoi(hint) : CART_CACHE_SIZE);
+
     if (!load_cart(renderer, (const char*)available_carts[0], get_cart()))
     {
         return false;
@@ -943,6 +923,7 @@ void destroy_core(void)
     destroy_memory();
     destroy_vm();
     destroy_cart(get_cart());
+    clear_cart_cache();
     for (int i = 0; i < num_carts; i++)
     {
         SDL_free(available_carts[i]);
@@ -1034,6 +1015,16 @@ bool handle_events(SDL_Renderer* renderer, SDL_Event* event)
                     case SDLK_EQUALS:
                         SDL_Log("Screen data CRC: 0x%x", crc32(pico8_ram, 0x6000, 0x2000));
                         break;
+                    case SDLK_MINUS:
+                        print_heap_census(vm);
+                        break;
+                    case SDLK_R: // Ctrl+R resets the cart.
+                        if (event->key.mod & SDL_KMOD_CTRL)
+                        {
+                            restart_cartridge(renderer);
+                            return true;
+                        }
+                        break;
                     case SDLK_SOFTLEFT:
                     case SDLK_ESCAPE:
                         destroy_vm();
@@ -1381,24 +1372,36 @@ bool iterate_core(SDL_Renderer* renderer)
         // Expose timing to API for stat(1) CPU usage reporting.
         pico8_frame_start = frame_start;
         pico8_frame_ms = frame_ms;
+        Uint64 busy_start = SDL_GetTicksNS();
+        int work_start = lua_gc(vm, LUA_GCWORK, 0);
+
+        if (pico8_run_requested)
+        {
+            restart_cartridge(renderer);
+        }
 
         if (has_update)
         {
             update_input(renderer);
             update_touch_input(renderer);
-            call_pico8_function(vm, "_update");
+            call_pico8_function(vm, ENTRY_UPDATE);
         }
         else if (has_update60)
         {
             update_input(renderer);
             update_touch_input(renderer);
-            call_pico8_function(vm, "_update60");
+            call_pico8_function(vm, ENTRY_UPDATE60);
+        }
+
+        if (pico8_run_requested)
+        {
+            restart_cartridge(renderer);
         }
 
         if (has_draw)
         {
             reset_draw_state();
-            call_pico8_function(vm, "_draw");
+            call_pico8_function(vm, ENTRY_DRAW);
         }
 
         update_time();
@@ -1406,6 +1409,22 @@ bool iterate_core(SDL_Renderer* renderer)
         update_from_virtual_memory(renderer);
         SDL_RenderPresent(renderer);
 
+        Uint64 busy_ns = SDL_GetTicksNS() - busy_start;
+        int cart_work = lua_gc(vm, LUA_GCWORK, 0) - work_start;
+
+        // Spend what is left of the frame on the GC.
+        Uint64 gc_ns = collect_in_slack(SDL_MS_TO_NS(frame_start + frame_ms));
+        gc_slack_ns += gc_ns;
+        gc_slack_max_ns = SDL_max(gc_slack_max_ns, gc_ns);
+        gc_slack_work += lua_gc(vm, LUA_GCWORK, 0) - work_start - cart_work;
+
+        uint32_t slot = gc_frames % GC_STATS_FRAMES;
+        frame_busy_ns[slot] = (Uint32)SDL_min(busy_ns, SDL_MAX_UINT32);
+        frame_slack_ns[slot] = (Uint32)SDL_min(gc_ns, SDL_MAX_UINT32);
+        frame_cart_kb[slot] = (Uint32)cart_work;
+        gc_frames++;
+        sample_gc_mode();
+
 #ifndef __SYMBIAN32__
         Uint64 elapsed = SDL_GetTicks() - frame_start;
         if (elapsed < frame_ms)
@@ -31,8 +31,6 @@
 
 #define LITERALS 60
 
-#define codo_malloc malloc
-#define codo_free free
 #define codo_memset memset
 
 // removed from end of decompressed if it exists
@@ -41,18 +39,57 @@
 #define FUTURE_CODE2 "if(_update60)_update=function()_update60()_update_buttons()_update60()end"
 
 // ^ is dummy -- not a literal. forgot '-', but nevermind! (gets encoded as rare literal)
-char *literal = "^\n 0123456789abcdefghijklmnopqrstuvwxyz!#%(){}[]<>+=/*:;.,~_";
-int literal_index[256]; // map literals to 0..LITERALS-1. 0 is reserved (not listed in literals string)
+static const char literal[] = "^\n 0123456789abcdefghijklmnopqrstuvwxyz!#%(){}[]<>+=/*:;.,~_";
 
-#define READ_VAL(val) {val = *in; in++;}
-int decompress_mini(uint8 *in_p, uint8 *out_p, int max_len)
+// All decoder state is kept in a reader owned by the caller, so that
+// several carts can be decompressed concurrently.
+typedef struct mini_reader
+{
+    const uint8 *in;
+    const uint8 *in_end;
+    int overrun;
+
+} mini_reader;
+
+static inline int mini_read(mini_reader *r)
+{
+    if (r->in < r->in_end) return *r->in++;
+    r->overrun = 1;
+    return 0;
+}
+
+// strip suffix from the end of the NUL-terminated text in out_p[0..len)
+static int remove_future_code(uint8 *out_p, int len, const char *suffix)
+{
+    int text_len = 0;
+    int suffix_len = (int)strlen(suffix);
+
+    while (text_len < len && out_p[text_len] != 0)
+        text_len++;
+
+    if (text_len >= suffix_len && memcmp(out_p + text_len - suffix_len, suffix, suffix_len) == 0)
+    {
+        out_p[text_len - suffix_len] = 0;
+        return text_len - suffix_len;
+    }
+
+    return len;
+}
+
+#define READ_VAL(val) {val = mini_read(&reader);}
+int decompress_mini(const uint8 *in_p, int in_len, uint8 *out_p, int max_len)
 {
     int block_offset;
     int block_length;
     int val;
-    uint8 *in = in_p;
     uint8 *out = out_p;
+    uint8 *out_end;
     int len;
+    mini_reader reader;
+
+    reader.in = in_p;
+    reader.in_end = in_p + in_len;
+    reader.overrun = 0;
 
     // header tag ":c:"
     READ_VAL(val);
@@ -70,11 +107,13 @@ int decompress_mini(uint8 *in_p, uint8 *out_p, int max_len)
     READ_VAL(val);
     READ_VAL(val);
 
+    if (reader.overrun || len > max_len) return -1; // corrupt data
+
     codo_memset(out_p, 0, max_len);
 
-    if (len > max_len) return 1; // corrupt data
+    out_end = out_p + len;
 
-    while (out < out_p + len)
+    while (out < out_end)
     {
         READ_VAL(val);
 
@@ -84,12 +123,10 @@ int decompress_mini(uint8 *in_p, uint8 *out_p, int max_len)
             if (val == 0)
             {
                 READ_VAL(val);
-                //printf("rare literal: %d\n", val);
                 *out = val;
             }
             else
             {
-                // printf("common literal: %d (%c)\n", literal[val], literal[val]);
                 *out = literal[val];
             }
             out++;
@@ -103,28 +140,27 @@ int decompress_mini(uint8 *in_p, uint8 *out_p, int max_len)
             block_offset += val % 16;
             block_length = (val / 16) + 2;
 
-            memcpy(out, out - block_offset, block_length);
-            out += block_length;
+            if (block_offset == 0 || block_offset > out - out_p || block_length > out_p + max_len - out)
+                return -1;
+
+            // blocks may overlap themselves for repeating patterns: copy forwards
+            {
+                const uint8 *src = out - block_offset;
+                while (block_length-- > 0)
+                    *out++ = *src++;
+            }
         }
+
+        if (reader.overrun) return -1; // truncated input
     }
 
     // remove injected code (needed to be future compatible with PICO-8 C 0.1.7 / FILE_VERSION 8)
     // older versions will leave this code intact, allowing it to implement fallback 60fps support
 
-    if (strstr((char *)out_p, FUTURE_CODE))
-    if (strlen((char *)out_p)-((char *)strstr((char *)out_p, FUTURE_CODE) - (char *)out_p) == strlen(FUTURE_CODE)) // at end
-    {
-        out = out_p + strlen((char *)out_p) - strlen(FUTURE_CODE);
-        *out = 0;
-    }
+    len = remove_future_code(out_p, len, FUTURE_CODE);
 
     // queue circus music
-    if (strstr((char *)out_p, FUTURE_CODE2))
-    if (strlen((char *)out_p)-((char *)strstr((char *)out_p, FUTURE_CODE2) - (char *)out_p) == strlen(FUTURE_CODE2)) // at end
-    {
-        out = out_p + strlen((char *)out_p) - strlen(FUTURE_CODE2);
-        *out = 0;
-    }
+    len = remove_future_code(out_p, len, FUTURE_CODE2);
 
-    return out - out_p;
+    return len;
 }
@@ -29,7 +29,11 @@
 
 typedef unsigned char uint8;
 
-int decompress_mini(uint8* in_p, uint8* out_p, int max_len);
-int pxa_decompress(uint8* in_p, uint8* out_p, int max_len);
+// Both decoders read at most in_len bytes from in_p and write at most max_len
+// bytes to out_p. They return the decompressed length, or -1 if the input is
+// corrupt or truncated. Neither keeps any global state, so they are safe to
+// call from several threads at once.
+int decompress_mini(const uint8* in_p, int in_len, uint8* out_p, int max_len);
+int pxa_decompress(const uint8* in_p, int in_len, uint8* out_p, int max_len);
 
 #endif // P8_COMPRESS_H
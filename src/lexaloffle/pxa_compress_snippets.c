@@ -48,65 +48,92 @@
 #define MINI_HASH(pp, i) ((pp[i+0]*7 + pp[i+1]*1503 + pp[i+2]*51717) & (HASH_MAX-1))
 
 typedef unsigned short int uint16;
-typedef unsigned char uint8;
-
-#define WRITE_VAL(x) {*p_8 = (x); p_8++;}
-
-static int bit = 1;
-static int byte = 0;
-static int dest_pos = 0;
-static int src_pos = 0;
 
 //-------------------------------------------------
-// pxa bit-level read/write help functions
+// pxa bit-level read help functions
+//
+// All reader state lives in a pxa_reader owned by the caller, so several
+// carts can be decompressed concurrently. Bits are consumed LSB-first from
+// a register-wide buffer that is refilled a byte at a time; reads past the
+// end of the input yield zero bits and are reported by pxa_overrun().
 //-------------------------------------------------
 
-static uint8* dest_buf = NULL;
-static uint8* src_buf = NULL;
+#if UINTPTR_MAX > 0xffffffffu
+typedef uint64_t pxa_bits;
+#else
+typedef uint32_t pxa_bits;
+#endif
+
+#define PXA_BITS_WIDTH ((int)(sizeof(pxa_bits) * 8))
 
-static int getbit()
+typedef struct pxa_reader
 {
-    int ret;
+    const uint8* src;
+    int src_len;
+    int load_pos;  // Next byte to move into the bit buffer.
+    pxa_bits bits; // Buffered bits, next bit in the LSB.
+    int bit_count;
+
+} pxa_reader;
 
-    ret = (src_buf[src_pos] & bit) ? 1 : 0;
-    bit <<= 1;
-    if (bit == 256)
+static void pxa_init_reader(pxa_reader* r, const uint8* src, int src_len)
+{
+    r->src = src;
+    r->src_len = src_len;
+    r->load_pos = 0;
+    r->bits = 0;
+    r->bit_count = 0;
+}
+
+static inline void pxa_refill(pxa_reader* r)
+{
+    while (r->bit_count <= PXA_BITS_WIDTH - 8)
     {
-        bit = 1;
-        src_pos++;
+        pxa_bits byte = (r->load_pos < r->src_len) ? r->src[r->load_pos] : 0;
+        r->bits |= byte << r->bit_count;
+        r->bit_count += 8;
+        r->load_pos++;
     }
-    return ret;
 }
 
-void putbit(int bval)
+// Index of the input byte holding the next unread bit.
+static inline int pxa_src_pos(const pxa_reader* r)
 {
-    dest_buf[dest_pos] &= ~bit; // 0.2.0j: per-bit
-    if (bval) dest_buf[dest_pos] |= bit;
+    return r->load_pos - ((r->bit_count + 7) >> 3);
+}
 
-    bit <<= 1;
+static inline int pxa_overrun(const pxa_reader* r)
+{
+    return (r->load_pos * 8 - r->bit_count) > r->src_len * 8;
+}
 
-    if (bit == 256)
-    {
-        bit = 1;
-        dest_pos++;
-        byte = dest_buf[dest_pos]; // 0.2.0j: so that don't clobber existing bits (can overwrite at bit level)
-    }
+static inline int getbit(pxa_reader* r)
+{
+    int ret;
+
+    if (r->bit_count == 0) pxa_refill(r);
+
+    ret = (int)(r->bits & 1);
+    r->bits >>= 1;
+    r->bit_count--;
+    return ret;
 }
 
-static int getval(int bits)
+// bits must not exceed PXA_BITS_WIDTH - 8 (the longest read is 20 bits).
+static inline int getval(pxa_reader* r, int bits)
 {
-    int i;
-    int val = 0;
+    int val;
     if (bits == 0) return 0;
 
-    for (i = 0; i < bits; i++)
-        if (getbit())
-            val |= (1 << i);
+    if (r->bit_count < bits) pxa_refill(r);
 
+    val = (int)(r->bits & (((pxa_bits)1 << bits) - 1));
+    r->bits >>= bits;
+    r->bit_count -= bits;
     return val;
 }
 
-static int getchain(int link_bits, int max_bits)
+static int getchain(pxa_reader* r, int link_bits, int max_bits)
 {
     int max_link_val = (1 << link_bits) - 1;
     int val = 0;
@@ -115,7 +142,7 @@ static int getchain(int link_bits, int max_bits)
 
     while (vv == max_link_val)
     {
-        vv = getval(link_bits);
+        vv = getval(r, link_bits);
         bits_read += link_bits;
         val += vv;
         if (bits_read >= max_bits) return val; // next val is implicitly 0
@@ -124,18 +151,17 @@ static int getchain(int link_bits, int max_bits)
     return val;
 }
 
-static int getnum()
+static int getnum(pxa_reader* r)
 {
-    int jump = BLOCK_DIST_BITS;
-    int bits = jump;
+    int bits;
     int val;
 
     // 1  15 bits // more frequent so put first
     // 01 10 bits
     // 00  5 bits
-    bits = (3 - getchain(1, 2)) * BLOCK_DIST_BITS;
+    bits = (3 - getchain(r, 1, 2)) * BLOCK_DIST_BITS;
 
-    val = getval(bits);
+    val = getval(r, bits);
 
     if (val == 0 && bits == 10)
         return -1; // raw block marker
@@ -145,66 +171,52 @@ static int getnum()
 
 // ---------------------
 
-#define PXA_READ_VAL(x) getval(x)
-
-static void init_literals_state(int* literal, int* literal_pos)
+int pxa_decompress(const uint8* in_p, int in_len, uint8* out_p, int max_len)
 {
     int i;
+    uint8 literal[256];
+    int dest_pos = 0;
+    pxa_reader reader;
+    pxa_reader* r = &reader;
+
+    if (in_len < 8 || max_len <= 0) return -1;
+
+    pxa_init_reader(r, in_p, in_len);
 
     // starting state makes little difference
     // using 255-i (which seems terrible) only costs 10 bytes more.
 
     for (i = 0; i < 256; i++)
-        literal[i] = i;
-
-    for (i = 0; i < 256; i++)
-        literal_pos[literal[i]] = i;
-}
-
-int pxa_decompress(uint8* in_p, uint8* out_p, int max_len)
-{
-    int i;
-    int literal[256];
-    int literal_pos[256];
-    int dest_pos = 0;
-
-    bit = 1;
-    byte = 0;
-    src_buf = in_p;
-    src_pos = 0;
-
-    init_literals_state(literal, literal_pos);
+        literal[i] = (uint8)i;
 
     // header
 
     int header[8];
     for (i = 0; i < 8; i++)
-        header[i] = PXA_READ_VAL(8);
+        header[i] = getval(r, 8);
 
     int raw_len = header[4] * 256 + header[5];
     int comp_len = header[6] * 256 + header[7];
 
-    // printf(" read raw_len:  %d\n", raw_len);
-    // printf(" read comp_len: %d\n", comp_len);
+    if (raw_len > max_len) return -1;
+    if (comp_len > in_len) return -1; // truncated input
 
-    while (src_pos < comp_len && dest_pos < raw_len && dest_pos < max_len)
+    while (pxa_src_pos(r) < comp_len && dest_pos < raw_len)
     {
-        int block_type = getbit();
-
-        // printf("%d %d\n", src_pos, block_type); fflush(stdout);
+        int block_type = getbit(r);
 
         if (block_type == 0)
         {
             // block
 
-            int block_offset = getnum() + 1;
+            int block_offset = getnum(r) + 1;
 
             if (block_offset == 0)
             {
                 // 0.2.0j: raw block
                 while (dest_pos < raw_len)
                 {
-                    out_p[dest_pos] = getval(8);
+                    out_p[dest_pos] = (uint8)getval(r, 8);
                     if (out_p[dest_pos] == 0) // found end -- don't advance dest_pos
                         break;
                     dest_pos++;
@@ -212,14 +224,16 @@ int pxa_decompress(uint8* in_p, uint8* out_p, int max_len)
             }
             else
             {
-                int block_len = getchain(BLOCK_LEN_CHAIN_BITS, 100000) + PXA_MIN_BLOCK_LEN;
+                int block_len = getchain(r, BLOCK_LEN_CHAIN_BITS, 100000) + PXA_MIN_BLOCK_LEN;
+
+                if (block_offset > dest_pos || block_len > max_len - dest_pos) return -1;
 
                 // copy // don't just memcpy because might be copying self for repeating pattern
-                while (block_len > 0) {
-                    out_p[dest_pos] = out_p[dest_pos - block_offset];
-                    dest_pos++;
-                    block_len--;
-                }
+                uint8* dst = out_p + dest_pos;
+                const uint8* src = dst - block_offset;
+                dest_pos += block_len;
+                while (block_len-- > 0)
+                    *dst++ = *src++;
 
                 // safety: null terminator. to do: just do at end
                 if (dest_pos < max_len - 1)
@@ -234,40 +248,36 @@ int pxa_decompress(uint8* in_p, uint8* out_p, int max_len)
             int bits = 0;
 
             int safety = 0;
-            while (getbit() == 1 && safety++ < 16)
+            while (getbit(r) == 1 && safety++ < 16)
             {
                 lpos += (1 << (TINY_LITERAL_BITS + bits));
                 bits++;
             }
 
             bits += TINY_LITERAL_BITS;
-            lpos += getval(bits);
+            lpos += getval(r, bits);
 
-            if (lpos > 255) return 0; // something wrong
+            if (lpos > 255) return -1; // something wrong
 
-            // grab character and write
-            int c = literal[lpos];
+            // grab character and write, then move it to the front
+            uint8 c = literal[lpos];
 
             out_p[dest_pos] = c;
             dest_pos++;
-            out_p[dest_pos] = 0;
+            if (dest_pos < max_len)
+                out_p[dest_pos] = 0;
 
-            int i;
-            for (i = lpos; i > 0; i--)
-            {
-                literal[i] = literal[i - 1];
-                literal_pos[literal[i]]++;
-            }
+            SDL_memmove(&literal[1], &literal[0], lpos);
             literal[0] = c;
-            literal_pos[c] = 0;
         }
-    }
 
+        if (pxa_overrun(r)) return -1; // truncated input
+    }
 
-    return 0;
+    return dest_pos;
 }
 
-int is_compressed_format_header(uint8* dat)
+int is_compressed_format_header(const uint8* dat)
 {
     if (dat[0] == ':' && dat[1] == 'c' && dat[2] == ':' && dat[3] == 0) return 1;
     if (dat[0] == 0 && dat[1] == 'p' && dat[2] == 'x' && dat[3] == 'a') return 2;
@@ -276,12 +286,13 @@ int is_compressed_format_header(uint8* dat)
 
 // max_len should be 0x10000 (64k max code size)
 // out_p should allocate 0x10001 (includes null terminator)
-int pico8_code_section_decompress(uint8* in_p, uint8* out_p, int max_len)
+int pico8_code_section_decompress(const uint8* in_p, int in_len, uint8* out_p, int max_len)
 {
-    if (is_compressed_format_header(in_p) == 0) {
-        memcpy(out_p, in_p, 0x3d00); out_p[0x3d00] = '\0'; return 0;
+    if (in_len < 4 || is_compressed_format_header(in_p) == 0) {
+        int len = MIN(MIN(in_len, 0x3d00), max_len);
+        SDL_memcpy(out_p, in_p, len); out_p[len] = '\0'; return len;
     } // legacy: no header -> is raw text
-    if (is_compressed_format_header(in_p) == 1) return decompress_mini(in_p, out_p, max_len);
-    if (is_compressed_format_header(in_p) == 2) return pxa_decompress(in_p, out_p, max_len);
+    if (is_compressed_format_header(in_p) == 1) return decompress_mini(in_p, in_len, out_p, max_len);
+    if (is_compressed_format_header(in_p) == 2) return pxa_decompress(in_p, in_len, out_p, max_len);
     return 0;
 }
@@ -0,0 +1,275 @@
+/** @file pool.c
+ *
+ *  A portable PICO-8 emulator written in C.
+ *
+ *  Copyright (c) 2025-2026, Michael Fitzmayer. All rights reserved.
+ *  SPDX-License-Identifier: MIT
+ *
+ **/
+
+#include <SDL3/SDL.h>
+#include <stdint.h>
+
+#include "pool.h"
+
+// The first granule of a slab holds the link to the previous slab.
+SDL_COMPILE_TIME_ASSERT(pool_slab_link, sizeof(uint8_t*) <= POOL_GRANULE);
+
+static int size_class(size_t size)
+{
+    return (int)((size - 1) / POOL_GRANULE);
+}
+
+// Whether 'size' more bytes may be taken from the system.
+static bool can_reserve(const pool_t* pool, size_t size)
+{
+    return !pool->limit || pool->reserved + size <= pool->limit;
+}
+
+static void* carve_block(pool_t* pool, int class)
+{
+    size_t size = (size_t)(class + 1) * POOL_GRANULE;
+
+    if (pool->slab_top + size > pool->slab_end)
+    {
+        if (!can_reserve(pool, POOL_SLAB_SIZE))
+        {
+            return NULL;
+        }
+        uint8_t* slab = (uint8_t*)SDL_malloc(POOL_SLAB_SIZE);
+        if (!slab)
+        {
+            return NULL;
+        }
+        *(uint8_t**)slab = pool->slabs;
+        pool->slabs = slab;
+        pool->slab_top = slab + POOL_GRANULE;
+        pool->slab_end = slab + POOL_SLAB_SIZE;
+        pool->slab_count++;
+        pool->reserved += POOL_SLAB_SIZE;
+    }
+
+    void* block = pool->slab_top;
+    pool->slab_top += size;
+    return block;
+}
+
+static void free_block(pool_t* pool, void* ptr, int class)
+{
+    pool_block_t* block = (pool_block_t*)ptr;
+
+    block->next = pool->free_list[class];
+    pool->free_list[class] = block;
+}
+
+// Splits a free block of a bigger class, for when the limit leaves no room
+// for another slab; the rest of it joins the free list of its own size.
+static void* split_block(pool_t* pool, int class)
+{
+    for (int bigger = class + 1; bigger < POOL_NUM_CLASSES; bigger++)
+    {
+        pool_block_t* block = pool->free_list[bigger];
+        if (block)
+        {
+            pool->free_list[bigger] = block->next;
+            free_block(pool, (uint8_t*)block + (size_t)(class + 1) * POOL_GRANULE,
+                bigger - class - 1);
+            return block;
+        }
+    }
+    return NULL;
+}
+
+static void* alloc_block(pool_t* pool, int class)
+{
+    pool_block_t* block = pool->free_list[class];
+
+    if (block)
+    {
+        pool->free_list[class] = block->next;
+        pool->hits[class]++;
+        return block;
+    }
+
+    pool->misses[class]++;
+    void* carved = carve_block(pool, class);
+    return carved ? carved : split_block(pool, class);
+}
+
+// Shrinks a large block into a slab of its own that holds a single block,
+// for when a large block has to become a small one and no other block can
+// be had. As a slab it is returned to the system by destroy_pool.
+static void* adopt_block(pool_t* pool, void* ptr, size_t osize, size_t nsize)
+{
+    size_t size = POOL_GRANULE + (size_t)(size_class(nsize) + 1) * POOL_GRANULE;
+    uint8_t* slab = (uint8_t*)SDL_realloc(ptr, size);
+    if (!slab)
+    {
+        return NULL;
+    }
+    SDL_memmove(slab + POOL_GRANULE, slab, nsize);
+
+    // Chained behind the current slab, which keeps carving.
+    if (pool->slabs)
+    {
+        *(uint8_t**)slab = *(uint8_t**)pool->slabs;
+        *(uint8_t**)pool->slabs = slab;
+    }
+    else
+    {
+        *(uint8_t**)slab = NULL;
+        pool->slabs = slab;
+    }
+    pool->slab_count++;
+    pool->reserved = pool->reserved - osize + size;
+    return slab + POOL_GRANULE;
+}
+
+void init_pool(pool_t* pool)
+{
+    SDL_zerop(pool);
+}
+
+void destroy_pool(pool_t* pool)
+{
+    uint8_t* slab = pool->slabs;
+
+    while (slab)
+    {
+        uint8_t* next = *(uint8_t**)slab;
+        SDL_free(slab);
+        slab = next;
+    }
+    init_pool(pool);
+}
+
+// Lua always passes the exact size of an existing block in osize, so the
+// class of a block never has to be stored.
+static void* pool_realloc(pool_t* pool, void* ptr, size_t osize, size_t nsize)
+{
+    bool old_small = osize > 0 && osize <= POOL_MAX_SIZE;
+    bool new_small = nsize > 0 && nsize <= POOL_MAX_SIZE;
+
+    if (nsize == 0)
+    {
+        if (old_small)
+        {
+            free_block(pool, ptr, size_class(osize));
+        }
+        else
+        {
+            SDL_free(ptr);
+            pool->reserved -= osize;
+        }
+        return NULL;
+    }
+
+    if (old_small && new_small)
+    {
+        int class = size_class(nsize);
+        if (class == size_class(osize))
+        {
+            return ptr;
+        }
+
+        void* block = alloc_block(pool, class);
+        if (!block)
+        {
+            // Shrinking must not fail; keep the bigger block.
+            return nsize < osize ? ptr : NULL;
+        }
+        SDL_memcpy(block, ptr, SDL_min(osize, nsize));
+        free_block(pool, ptr, size_class(osize));
+        return block;
+    }
+
+    if (!old_small && !new_small)
+    {
+        if (nsize > osize && !can_reserve(pool, nsize - osize))
+        {
+            return NULL;
+        }
+        pool->large++;
+        void* block = SDL_realloc(ptr, nsize);
+        if (block)
+        {
+            pool->reserved = pool->reserved - osize + nsize;
+        }
+        return block;
+    }
+
+    void* block;
+    if (new_small)
+    {
+        block = alloc_block(pool, size_class(nsize));
+        if (!block)
+        {
+            // Shrinking a system block must not fail either, and it must
+            // not join a free list as it is, where it would never be freed.
+            return ptr ? adopt_block(pool, ptr, osize, nsize) : NULL;
+        }
+    }
+    else
+    {
+        if (!can_reserve(pool, nsize))
+        {
+            return NULL;
+        }
+        pool->large++;
+        block = SDL_malloc(nsize);
+        if (!block)
+        {
+            return NULL;
+        }
+        pool->reserved += nsize;
+    }
+
+    if (ptr)
+    {
+        SDL_memcpy(block, ptr, SDL_min(osize, nsize));
+        if (old_small)
+        {
+            free_block(pool, ptr, size_class(osize));
+        }
+        else
+        {
+            SDL_free(ptr);
+            pool->reserved -= osize;
+        }
+    }
+    return block;
+}
+
+// lua_Alloc compatible; ud is the pool.
+void* pool_allocator(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+    pool_t* pool = (pool_t*)ud;
+
+    // For new blocks osize holds the type of the object instead.
+    if (!ptr)
+    {
+        osize = 0;
+    }
+
+    void* block = pool_realloc(pool, ptr, osize, nsize);
+    if (block || nsize == 0)
+    {
+        pool->used = pool->used - osize + nsize;
+    }
+    return block;
+}
+
+void log_pool_stats(const pool_t* pool)
+{
+    SDL_Log("Lua allocator: %u slabs, %u large allocations",
+        pool->slab_count, pool->large);
+
+    for (int i = 0; i < POOL_NUM_CLASSES; i++)
+    {
+        if (pool->hits[i] || pool->misses[i])
+        {
+            SDL_Log("  %3d bytes: %u hits, %u misses",
+                (i + 1) * POOL_GRANULE, pool->hits[i], pool->misses[i]);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+/** @file pool.h
+ *
+ *  A portable PICO-8 emulator written in C.
+ *
+ *  Copyright (c) 2025-2026, Michael Fitzmayer. All rights reserved.
+ *  SPDX-License-Identifier: MIT
+ *
+ **/
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Blocks up to POOL_MAX_SIZE bytes are served from size classes spaced
+// POOL_GRANULE bytes apart; anything larger goes to the system allocator.
+#define POOL_GRANULE 8
+#define POOL_MAX_SIZE 64
+#define POOL_NUM_CLASSES (POOL_MAX_SIZE / POOL_GRANULE)
+#define POOL_SLAB_SIZE 8192
+
+typedef struct pool_block
+{
+    struct pool_block* next;
+
+} pool_block_t;
+
+typedef struct pool
+{
+    pool_block_t* free_list[POOL_NUM_CLASSES];
+
+    // A hit reuses a freed block, a miss carves a new one from a slab.
+    uint32_t hits[POOL_NUM_CLASSES];
+    uint32_t misses[POOL_NUM_CLASSES];
+    uint32_t large;
+
+    // Bytes handed out to Lua, and bytes taken from the system for slabs
+    // and large blocks. Taking more than a non-zero limit fails, which
+    // makes Lua run an emergency full collection and try once more.
+    size_t used;
+    size_t reserved;
+    size_t limit;
+
+    // Slabs are chained through their first word and only returned to the
+    // system when the pool is destroyed.
+    uint8_t* slabs;
+    uint8_t* slab_top;
+    uint8_t* slab_end;
+    uint32_t slab_count;
+
+} pool_t;
+
+void init_pool(pool_t* pool);
+void destroy_pool(pool_t* pool);
+void* pool_allocator(void* ud, void* ptr, size_t osize, size_t nsize);
+void log_pool_stats(const pool_t* pool);
+
+#endif // POOL_H
@@ -15,6 +15,7 @@
 
 #include <stdint.h> // int32_t, int64_t, …
 #include <math.h> // pow()
+#include <string.h> // strlen()
 
 #ifdef __SYMBIAN32__
 static inline long long llabs(long long x) {
@@ -34,6 +35,7 @@ typedef int32_t fix32_t;
 
 static inline fix32_t fix32_value(int16_t i, uint16_t f);
 static inline fix32_t fix32_from_string(const char* s, char** endptr);
+static inline fix32_t fix32_from_chars(const char* s, const char* end, const char** endptr);
 static inline fix32_t fix32_from_double(double d);
 static inline double fix32_to_double(fix32_t x);
 static inline fix32_t fix32_from_int(int i);
@@ -103,7 +105,67 @@ static inline fix32_t fix32_value(int16_t i, uint16_t f)
 
 static inline fix32_t fix32_from_string(const char* s, char** endptr)
 {
-    return fix32_from_double(strtod(s, endptr));
+    return fix32_from_chars(s, s + strlen(s), (const char**)endptr);
+}
+
+// Parses a decimal number in [s, end) like strtod() does, but with integer
+// arithmetic only: targets without an FPU would spend most of the time in
+// soft-float routines. The fraction is rounded to the nearest 1/65536 like
+// PICO-8 does (0.1 is 0x0000.199a) and the integer part wraps around.
+static inline fix32_t fix32_from_chars(const char* s, const char* end, const char** endptr)
+{
+    const char* int_digits;
+    const char* frac_digits;
+    int int_count = 0, frac_count = 0, exponent = 0, point, k;
+    int neg = 0;
+    uint32_t int_part = 0, frac_part = 0, bits;
+
+#define FIX32_ISDIGIT(p) ((p) < end && *(p) >= '0' && *(p) <= '9')
+#define FIX32_DIGIT(k) \
+    ((k) < int_count ? int_digits[k] - '0' : frac_digits[(k) - int_count] - '0')
+
+    *endptr = s;
+    while (s < end && (*s == ' ' || (*s >= '\t' && *s <= '\r'))) s++;
+    if (s < end && (*s == '-' || *s == '+')) neg = *s++ == '-';
+    for (int_digits = s; FIX32_ISDIGIT(s); s++) int_count++;
+    frac_digits = s;
+    if (s < end && *s == '.')
+        for (frac_digits = ++s; FIX32_ISDIGIT(s); s++) frac_count++;
+    if (int_count + frac_count == 0)
+        return 0;
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        const char* p = s + 1;
+        int exp_neg = 0;
+        if (p < end && (*p == '-' || *p == '+')) exp_neg = *p++ == '-';
+        if (FIX32_ISDIGIT(p)) {
+            for (; FIX32_ISDIGIT(p); p++)
+                if (exponent < 10000) exponent = exponent * 10 + (*p - '0');
+            if (exp_neg) exponent = -exponent;
+            s = p;
+        }
+    }
+    *endptr = s;
+
+    // The digits before 'point' make up the integer part. Only its low 16
+    // bits matter, and 10^16 is a multiple of 2^16.
+    point = int_count + exponent;
+    for (k = 0; k < point && k < int_count + frac_count; k++)
+        int_part = int_part * 10 + FIX32_DIGIT(k);
+    for (; k < point && k < int_count + frac_count + 16; k++)
+        int_part *= 10;
+
+    // Multiplying the fraction by 2^17 from its last digit on gives the
+    // exact floor; the extra bit decides the rounding.
+    for (k = int_count + frac_count - 1; k >= point && k >= 0; k--)
+        frac_part = (FIX32_DIGIT(k) * 0x20000u + frac_part) / 10;
+    for (k = point; k < 0 && frac_part; k++)
+        frac_part /= 10;
+
+#undef FIX32_DIGIT
+#undef FIX32_ISDIGIT
+
+    bits = (int_part << 16) + ((frac_part + 1) >> 1);
+    return (fix32_t)(neg ? 0u - bits : bits);
 }
 
 static inline fix32_t fix32_from_double(double d) {
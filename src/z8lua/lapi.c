@@ -69,7 +69,7 @@ static TValue *index2addr (lua_State *L, int idx) {
   else {  /* upvalues */
     idx = LUA_REGISTRYINDEX - idx;
     api_check(L, idx <= MAXUPVAL + 1, "upvalue index too large");
-    if (ttislcf(ci->func))  /* light C function? */
+    if (ttislcf(ci->func) || ttisfcf(ci->func))  /* light C function? */
       return NONVALIDVALUE;  /* it has no upvalues */
     else {
       CClosure *func = clCvalue(ci->func);
@@ -134,13 +134,50 @@ LUA_API lua_CFunction lua_atpanic (lua_State *L, lua_CFunction panicf) {
 }
 
 
-LUA_API void lua_setpico8memory (lua_State *L, unsigned char const *p) {
+LUA_API void lua_setpico8memory (lua_State *L, unsigned char *p) {
   lua_lock(L);
   G(L)->pico8memory = p;
   lua_unlock(L);
 }
 
 
+/*
+** Registers 'f' as the builtin that pokes 'size' (1, 2 or 4) bytes, so
+** that OP_POKE may do its stores directly while the global still holds it.
+*/
+LUA_API void lua_setpico8poke (lua_State *L, int size, lua_CFunction f) {
+  lua_lock(L);
+  api_check(L, size == 1 || size == 2 || size == 4, "invalid poke size");
+  G(L)->pico8poke[size >> 1] = f;
+  lua_unlock(L);
+}
+
+
+/*
+** Register 'f' as the builtin 'sub' or 'ord', so that OP_CALL may do the
+** calls with a string and numbers itself while a variable still holds it.
+*/
+LUA_API void lua_setpico8sub (lua_State *L, lua_CFunction f) {
+  lua_lock(L);
+  G(L)->pico8sub = f;
+  lua_unlock(L);
+}
+
+
+LUA_API void lua_setpico8ord (lua_State *L, lua_CFunction f) {
+  lua_lock(L);
+  G(L)->pico8ord = f;
+  lua_unlock(L);
+}
+
+
+LUA_API void lua_census (lua_State *L, size_t *count, size_t *bytes) {
+  lua_lock(L);
+  luaC_census(L, count, bytes);
+  lua_unlock(L);
+}
+
+
 LUA_API const lua_Number *lua_version (lua_State *L) {
   static const lua_Number version = LUA_VERSION_NUM;
   if (L == NULL) return &version;
@@ -267,7 +304,7 @@ LUA_API const char *lua_typename (lua_State *L, int t) {
 
 LUA_API int lua_iscfunction (lua_State *L, int idx) {
   StkId o = index2addr(L, idx);
-  return (ttislcf(o) || (ttisCclosure(o)));
+  return (ttislcf(o) || ttisfcf(o) || (ttisCclosure(o)));
 }
 
 
@@ -426,6 +463,7 @@ LUA_API size_t lua_rawlen (lua_State *L, int idx) {
 LUA_API lua_CFunction lua_tocfunction (lua_State *L, int idx) {
   StkId o = index2addr(L, idx);
   if (ttislcf(o)) return fvalue(o);
+  else if (ttisfcf(o)) return fcfvalue(o)->f;
   else if (ttisCclosure(o))
     return clCvalue(o)->f;
   else return NULL;  /* not a C function */
@@ -455,6 +493,7 @@ LUA_API const void *lua_topointer (lua_State *L, int idx) {
     case LUA_TLCL: return clLvalue(o);
     case LUA_TCCL: return clCvalue(o);
     case LUA_TLCF: return cast(void *, cast(size_t, fvalue(o)));
+    case LUA_TFCF: return fcfvalue(o);
     case LUA_TTHREAD: return thvalue(o);
     case LUA_TUSERDATA:
     case LUA_TLIGHTUSERDATA:
@@ -582,6 +621,20 @@ LUA_API void lua_pushcclosure (lua_State *L, lua_CFunction fn, int n) {
 }
 
 
+/*
+** Pushes a builtin with two entry points: 'r->f' is a regular C function,
+** and OP_CALL uses 'r->ff' instead when it gets at least 'r->minargs'
+** arguments, all of them numbers, and no call hooks are set.  'r' must
+** outlive the state.
+*/
+LUA_API void lua_pushfastcfunction (lua_State *L, const lua_FastReg *r) {
+  lua_lock(L);
+  setfcfvalue(L->top, r);
+  api_incr_top(L);
+  lua_unlock(L);
+}
+
+
 LUA_API void lua_pushboolean (lua_State *L, int b) {
   lua_lock(L);
   setbvalue(L->top, (b != 0));  /* ensure that true is 1 */
@@ -802,6 +855,53 @@ LUA_API void lua_rawseti (lua_State *L, int idx, int n) {
 }
 
 
+/*
+** PICO-8 sequence operations: each one takes the value at the top of the
+** stack and pops it.
+*/
+LUA_API int lua_rawappend (lua_State *L, int idx) {
+  StkId t;
+  int n;
+  lua_lock(L);
+  api_checknelems(L, 1);
+  t = index2addr(L, idx);
+  api_check(L, ttistable(t), "table expected");
+  n = luaH_append(L, hvalue(t), L->top - 1);
+  luaC_barrierback(L, gcvalue(t), L->top-1);
+  L->top--;
+  lua_unlock(L);
+  return n;
+}
+
+
+LUA_API int lua_rawremove (lua_State *L, int idx) {
+  StkId t;
+  int n;
+  lua_lock(L);
+  api_checknelems(L, 1);
+  t = index2addr(L, idx);
+  api_check(L, ttistable(t), "table expected");
+  n = luaH_remove(L, hvalue(t), L->top - 1);
+  L->top--;
+  lua_unlock(L);
+  return n;
+}
+
+
+LUA_API int lua_rawcount (lua_State *L, int idx) {
+  StkId t;
+  int n;
+  lua_lock(L);
+  api_checknelems(L, 1);
+  t = index2addr(L, idx);
+  api_check(L, ttistable(t), "table expected");
+  n = luaH_count(hvalue(t), L->top - 1);
+  L->top--;
+  lua_unlock(L);
+  return n;
+}
+
+
 LUA_API void lua_rawsetp (lua_State *L, int idx, const void *p) {
   StkId t;
   TValue k;
@@ -912,6 +1012,7 @@ LUA_API void lua_callk (lua_State *L, int nargs, int nresults, int ctx,
   else  /* no continuation or no yieldable */
     luaD_call(L, func, nresults, 0);  /* just do the call */
   adjustresults(L, nresults);
+  G(L)->lastcat = NULL;  /* C may keep the results anywhere */
   lua_unlock(L);
 }
 
@@ -972,6 +1073,7 @@ LUA_API int lua_pcallk (lua_State *L, int nargs, int nresults, int errfunc,
     L->errfunc = ci->u.c.old_errfunc;
     status = LUA_OK;  /* if it is here, there were no errors */
   }
+  G(L)->lastcat = NULL;  /* C may keep the results anywhere */
   adjustresults(L, nresults);
   lua_unlock(L);
   return status;
@@ -1097,6 +1199,11 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
       luaC_changemode(L, KGC_NORMAL);
       break;
     }
+    case LUA_GCWORK: {
+      /* total work in Kbytes traversed/swept, to compare over intervals */
+      res = cast_int(g->GCwork >> 10);
+      break;
+    }
     default: res = -1;  /* invalid option */
   }
   lua_unlock(L);
@@ -1141,7 +1248,7 @@ LUA_API void lua_concat (lua_State *L, int n) {
   api_checknelems(L, n);
   if (n >= 2) {
     luaC_checkGC(L);
-    luaV_concat(L, n);
+    luaV_concat(L, n, -1);
   }
   else if (n == 0) {  /* push empty string */
     setsvalue2s(L, L->top, luaS_newlstr(L, "", 0));
@@ -1224,6 +1331,7 @@ LUA_API const char *lua_getupvalue (lua_State *L, int funcindex, int n) {
   lua_lock(L);
   name = aux_upvalue(index2addr(L, funcindex), n, &val, NULL);
   if (name) {
+    luaS_escape(L, val);  /* C may keep it anywhere */
     setobj2s(L, L->top, val);
     api_incr_top(L);
   }
@@ -1290,13 +1398,45 @@ LUA_API void lua_upvaluejoin (lua_State *L, int fidx1, int n1,
   luaC_objbarrier(L, f1, *up2);
 }
 
+/*
+** Same output as "%1.4f" without the trailing zeros, halfway cases going
+** to even like the C library does, but with integer arithmetic only.
+*/
 int lua_number2str(char* s, fix32_t n) {
-    int i = sprintf(s, "%1.4f", fix32_to_double(n));
-    while (i > 0 && s[i - 1] == '0') {
-		s[--i] = '\0';
-	}
-    if (i > 0 && s[i - 1] == '.') {
-		s[--i] = '\0';
-	}
-    return i;
+    uint32_t bits = n < 0 ? 0u - (uint32_t)n : (uint32_t)n;
+    uint32_t int_part = bits >> 16;
+    uint32_t scaled = (bits & 0xffff) * 10000u;
+    uint32_t frac = scaled >> 16;
+    uint32_t rest = scaled & 0xffff;
+    char digits[8];
+    int i = 0, len = 0;
+    if (rest > 0x8000 || (rest == 0x8000 && (frac & 1)))
+        frac++;
+    if (frac == 10000) {
+        int_part++;
+        frac = 0;
+    }
+    if (n < 0)
+        s[len++] = '-';
+    do {
+        digits[i++] = (char)('0' + int_part % 10);
+        int_part /= 10;
+    } while (int_part);
+    while (i > 0)
+        s[len++] = digits[--i];
+    if (frac) {
+        uint32_t place;
+        s[len++] = '.';
+        for (place = 1000; frac; place /= 10) {
+            s[len++] = (char)('0' + frac / place);
+            frac %= place;
+        }
+    }
+    s[len] = '\0';
+    return len;
+}
+
+/* parse a number the way tonum() does; tell whether it was one */
+int lua_string2number(const char* s, size_t len, fix32_t* n) {
+    return luaO_str2d(s, len, n);
 }
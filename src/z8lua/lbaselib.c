@@ -467,3 +467,32 @@ LUAMOD_API int luaopen_base (lua_State *L) {
   return 1;
 }
 
+
+/*
+** the part of the base library that carts can see: nothing that loads
+** code or files, raises or catches errors, or drives the collector.
+** 'assert', 'print', 'setmetatable' and the iterators are PICO-8's own
+** and come with the rest of its API
+*/
+static const luaL_Reg cart_funcs[] = {
+  {"getmetatable", luaB_getmetatable},
+  {"rawequal", luaB_rawequal},
+  {"rawlen", luaB_rawlen},
+  {"rawget", luaB_rawget},
+  {"rawset", luaB_rawset},
+  {"select", luaB_select},
+  {"tonumber", luaB_tonumber},
+  {"tostring", luaB_tostring},
+  {"type", luaB_type},
+  {NULL, NULL}
+};
+
+
+LUAMOD_API int luaopen_cartbase (lua_State *L) {
+  lua_pushglobaltable(L);
+  lua_pushglobaltable(L);
+  lua_setfield(L, -2, "_G");
+  luaL_setfuncs(L, cart_funcs, 0);
+  return 1;
+}
+
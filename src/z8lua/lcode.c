@@ -599,7 +599,7 @@ static void invertjump (FuncState *fs, expdesc *e) {
   Instruction *pc = getjumpcontrol(fs, e->u.info);
   lua_assert(testTMode(GET_OPCODE(*pc)) && GET_OPCODE(*pc) != OP_TESTSET &&
                                            GET_OPCODE(*pc) != OP_TEST);
-  SETARG_A(*pc, !(GETARG_A(*pc)));
+  SETARG_A(*pc, GETARG_A(*pc) ^ 1);  /* keep OP_LTK/OP_LEK swap bit */
 }
 
 
@@ -728,8 +728,10 @@ static void codearith (FuncState *fs, OpCode op,
   if (constfolding(op, e1, e2))
     return;
   else {
-    int o2 = (op != OP_UNM && op != OP_BNOT && op != OP_LEN) ?
-             luaK_exp2RK(fs, e2) : 0;
+    /* register +-* numeric constant gets its own opcode */
+    int knum = (op == OP_ADD || op == OP_SUB || op == OP_MUL) &&
+               isnumeral(e2);
+    int o2 = (op < OP_UNM || op > OP_LEN) ? luaK_exp2RK(fs, e2) : 0;
     int o1 = luaK_exp2RK(fs, e1);
     if (o1 > o2) {
       freeexp(fs, e1);
@@ -739,6 +741,8 @@ static void codearith (FuncState *fs, OpCode op,
       freeexp(fs, e2);
       freeexp(fs, e1);
     }
+    if (knum && ISK(o2) && !ISK(o1))
+      op = cast(OpCode, op - OP_ADD + OP_ADDK);
     e1->u.info = luaK_codeABC(fs, op, 0, o1, o2);
     e1->k = VRELOCABLE;
     luaK_fixline(fs, line);
@@ -757,6 +761,20 @@ static void codecomp (FuncState *fs, OpCode op, int cond, expdesc *e1,
     temp = o1; o1 = o2; o2 = temp;  /* o1 <==> o2 */
     cond = 1;
   }
+  if (ISK(o1) != ISK(o2)) {  /* register against a constant? */
+    if (ISK(o1)) {  /* constant goes to C; note the swap in A (bit 1) */
+      int temp = o1; o1 = o2; o2 = temp;
+      if (op != OP_EQ) cond |= 2;
+    }
+    /* constants have no metamethods, so any one can be tested for
+       equality; order needs a number to take the fast path */
+    if (op == OP_EQ || ttisnumber(&fs->f->k[INDEXK(o2)]))
+      op = cast(OpCode, op - OP_EQ + OP_EQK);
+    else if (cond & 2) {  /* keep the original order for the slow path */
+      int temp = o1; o1 = o2; o2 = temp;
+      cond &= 1;
+    }
+  }
   e1->u.info = condjump(fs, op, cond, o1, o2);
   e1->k = VJMP;
 }
@@ -784,8 +802,7 @@ void luaK_prefix (FuncState *fs, UnOpr op, expdesc *e, int line) {
       }
       break;
     }
-    case OPR_PEEK: case OPR_PEEK2: case OPR_PEEK4: {
-      luaK_exp2anyreg(fs, e);  /* cannot operate on constants */
+    case OPR_PEEK: case OPR_PEEK2: case OPR_PEEK4: {  /* address may be K */
       codearith(fs, (OpCode)(op - OPR_PEEK + OP_PEEK), e, &e2, line);
       break;
     }
@@ -165,6 +165,7 @@ LUA_API const char *lua_getlocal (lua_State *L, const lua_Debug *ar, int n) {
     StkId pos = 0;  /* to avoid warnings */
     name = findlocal(L, ar->i_ci, n, &pos);
     if (name) {
+      luaS_escape(L, pos);  /* C may keep it anywhere */
       setobj2s(L, L->top, pos);
       api_incr_top(L);
     }
@@ -374,7 +375,7 @@ static int findsetreg (Proto *p, int lastpc, int reg) {
           setreg = filterpc(pc, jmptarget);
         break;
       }
-      case OP_CALL:
+      case OP_CALL: case OP_POKE:
       case OP_TAILCALL: {
         if (reg >= a)  /* affect all registers above base */
           setreg = filterpc(pc, jmptarget);
@@ -465,7 +466,7 @@ static const char *getfuncname (lua_State *L, CallInfo *ci, const char **name) {
   int pc = currentpc(ci);  /* calling instruction index */
   Instruction i = p->code[pc];  /* calling instruction */
   switch (GET_OPCODE(i)) {
-    case OP_CALL:
+    case OP_CALL: case OP_POKE:
     case OP_TAILCALL:  /* get function name */
       return getobjname(p, pc, GETARG_A(i), name);
     case OP_TFORCALL: {  /* for iterator */
@@ -479,9 +480,9 @@ static const char *getfuncname (lua_State *L, CallInfo *ci, const char **name) {
     case OP_SETTABUP:
     case OP_SETTABLE: tm = TM_NEWINDEX; break;
     case OP_EQ: tm = TM_EQ; break;
-    case OP_ADD: tm = TM_ADD; break;
-    case OP_SUB: tm = TM_SUB; break;
-    case OP_MUL: tm = TM_MUL; break;
+    case OP_ADD: case OP_ADDK: tm = TM_ADD; break;
+    case OP_SUB: case OP_SUBK: tm = TM_SUB; break;
+    case OP_MUL: case OP_MULK: tm = TM_MUL; break;
     case OP_DIV: tm = TM_DIV; break;
     case OP_MOD: tm = TM_MOD; break;
     case OP_POW: tm = TM_POW; break;
@@ -497,8 +498,8 @@ static const char *getfuncname (lua_State *L, CallInfo *ci, const char **name) {
     case OP_UNM: tm = TM_UNM; break;
     case OP_BNOT: tm = TM_BNOT; break;
     case OP_LEN: tm = TM_LEN; break;
-    case OP_LT: tm = TM_LT; break;
-    case OP_LE: tm = TM_LE; break;
+    case OP_LT: case OP_LTK: tm = TM_LT; break;
+    case OP_LE: case OP_LEK: tm = TM_LE; break;
     case OP_CONCAT: tm = TM_CONCAT; break;
     default:
       return NULL;  /* else no useful name can be found */
@@ -206,8 +206,11 @@ void luaD_shrinkstack (lua_State *L) {
   int inuse = stackinuse(L);
   int goodsize = inuse + (inuse / 8) + 2*EXTRA_STACK;
   if (goodsize > LUAI_MAXSTACK) goodsize = LUAI_MAXSTACK;
+  if (goodsize < BASIC_STACK_SIZE) goodsize = BASIC_STACK_SIZE;
   if (inuse > LUAI_MAXSTACK ||  /* handling stack overflow? */
-      goodsize >= L->stacksize)  /* would grow instead of shrink? */
+      goodsize >= L->stacksize ||  /* would grow instead of shrink? */
+      (L->stacksize <= LUAI_MAXSTACK &&  /* not worth it, as the next */
+       L->stacksize <= 2 * goodsize))  /* calls would grow it again? */
     condmovestack(L);  /* don't change stack (change only for debugging) */
   else
     luaD_reallocstack(L, goodsize);  /* shrink it */
@@ -293,6 +296,18 @@ static StkId tryfuncTM (lua_State *L, StkId func) {
 /*
 ** returns true if function has been executed (C function)
 */
+/*
+** C may keep its arguments anywhere, so the last concatenation result is
+** forgotten when it is one of them
+*/
+static void escapeargs (lua_State *L, StkId func) {
+  StkId o;
+  if (G(L)->lastcat == NULL) return;
+  for (o = func + 1; o < L->top; o++)
+    luaS_escape(L, o);
+}
+
+
 int luaD_precall (lua_State *L, StkId func, int nresults) {
   lua_CFunction f;
   CallInfo *ci;
@@ -302,9 +317,13 @@ int luaD_precall (lua_State *L, StkId func, int nresults) {
     case LUA_TLCF:  /* light C function */
       f = fvalue(func);
       goto Cfunc;
+    case LUA_TFCF:  /* fast C function, called the regular way */
+      f = fcfvalue(func)->f;
+      goto Cfunc;
     case LUA_TCCL: {  /* C closure */
       f = clCvalue(func)->f;
      Cfunc:
+      escapeargs(L, func);
       luaD_checkstack(L, LUA_MINSTACK);  /* ensure minimum stack size */
       ci = next_ci(L);  /* now 'enter' new function */
       ci->nresults = nresults;
@@ -416,6 +435,7 @@ static void finishCcall (lua_State *L) {
   }
   /* finish 'lua_callk'/'lua_pcall' */
   adjustresults(L, ci->nresults);
+  G(L)->lastcat = NULL;  /* C may keep the results anywhere */
   /* call continuation function */
   if (!(ci->callstatus & CIST_STAT))  /* no call status? */
     ci->u.c.status = LUA_YIELD;  /* 'default' status */
@@ -537,6 +557,7 @@ LUA_API int lua_resume (lua_State *L, lua_State *from, int nargs) {
   int oldnny = L->nny;  /* save 'nny' */
   lua_lock(L);
   luai_userstateresume(L, nargs);
+  G(L)->lastcat = NULL;  /* the other thread's stack is not checked */
   L->nCcalls = (from) ? from->nCcalls + 1 : 1;
   L->nny = 0;  /* allow yields */
   api_checknelems(L, (L->status == LUA_OK) ? nargs + 1 : nargs);
@@ -556,6 +577,7 @@ LUA_API int lua_resume (lua_State *L, lua_State *from, int nargs) {
     }
     lua_assert(status == L->status);
   }
+  G(L)->lastcat = NULL;
   L->nny = oldnny;  /* restore 'nny' */
   L->nCcalls--;
   lua_assert(L->nCcalls == ((from) ? from->nCcalls : 0));
@@ -659,11 +681,23 @@ static void f_parser (lua_State *L, void *ud) {
 }
 
 
+/*
+** The parser keeps nearly everything it allocates until it is done, so
+** collection steps meanwhile would only traverse the same prototypes
+** again and again.  Its allocations are kept out of the debt that
+** triggers them and charged all at once when it returns; running out of
+** memory still calls an emergency collection.
+*/
+#define PARSERBIAS	(MAX_LMEM / 4)
+
+
 int luaD_protectedparser (lua_State *L, ZIO *z, const char *name,
                                         const char *mode) {
   struct SParser p;
   int status;
+  global_State *g = G(L);
   L->nny++;  /* cannot yield during parsing */
+  luaE_setdebt(g, g->GCdebt - PARSERBIAS);
   p.z = z; p.name = name; p.mode = mode;
   p.dyd.actvar.arr = NULL; p.dyd.actvar.size = 0;
   p.dyd.gt.arr = NULL; p.dyd.gt.size = 0;
@@ -674,6 +708,7 @@ int luaD_protectedparser (lua_State *L, ZIO *z, const char *name,
   luaM_freearray(L, p.dyd.actvar.arr, p.dyd.actvar.size);
   luaM_freearray(L, p.dyd.gt.arr, p.dyd.gt.size);
   luaM_freearray(L, p.dyd.label.arr, p.dyd.label.size);
+  luaE_setdebt(g, g->GCdebt + PARSERBIAS);
   L->nny--;
   return status;
 }
@@ -244,11 +244,14 @@ static void reallymarkobject (global_State *g, GCObject *o) {
   lu_mem size;
   white2gray(o);
   switch (gch(o)->tt) {
-    case LUA_TSHRSTR:
-    case LUA_TLNGSTR: {
+    case LUA_TSHRSTR: {
       size = sizestring(gco2ts(o));
       break;  /* nothing else to mark; make it black */
     }
+    case LUA_TLNGSTR: {
+      size = sizelngstr(gco2ts(o));
+      break;  /* nothing else to mark; make it black */
+    }
     case LUA_TUSERDATA: {
       Table *mt = gco2u(o)->metatable;
       markobject(g, mt);
@@ -469,7 +472,7 @@ static int traverseproto (global_State *g, Proto *f) {
     markobject(g, f->locvars[i].varname);
   return sizeof(Proto) + sizeof(Instruction) * f->sizecode +
                          sizeof(Proto *) * f->sizep +
-                         sizeof(TValue) * f->sizek +
+                         (sizeof(TValue) + sizeof(int)) * f->sizek +
                          sizeof(int) * f->sizelineinfo +
                          sizeof(LocVar) * f->sizelocvars +
                          sizeof(Upvaldesc) * f->sizeupvalues;
@@ -675,13 +678,17 @@ static void freeobj (lua_State *L, GCObject *o) {
     case LUA_TTABLE: luaH_free(L, gco2t(o)); break;
     case LUA_TTHREAD: luaE_freethread(L, gco2th(o)); break;
     case LUA_TUSERDATA: luaM_freemem(L, o, sizeudata(gco2u(o))); break;
-    case LUA_TSHRSTR:
+    case LUA_TSHRSTR: {
       G(L)->strt.nuse--;
-      /* go through */
-    case LUA_TLNGSTR: {
       luaM_freemem(L, o, sizestring(gco2ts(o)));
       break;
     }
+    case LUA_TLNGSTR: {
+      if (rawgco2ts(o) == G(L)->lastcat)  /* address may be reused */
+        G(L)->lastcat = NULL;
+      luaM_freemem(L, o, sizelngstr(gco2ts(o)));
+      break;
+    }
     default: lua_assert(0);
   }
 }
@@ -698,7 +705,7 @@ static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count);
 static void sweepthread (lua_State *L, lua_State *L1) {
   if (L1->stack == NULL) return;  /* stack not completely built yet */
   sweepwholelist(L, &L1->openupval);  /* sweep open upvalues */
-  luaE_freeCI(L1);  /* free extra CallInfo slots */
+  luaE_shrinkCI(L1);  /* free extra CallInfo slots */
   /* should not change the stack during an emergency gc cycle */
   if (G(L)->gckind != KGC_EMERGENCY)
     luaD_shrinkstack(L1);
@@ -1110,7 +1117,7 @@ static lu_mem singlestep (lua_State *L) {
 void luaC_runtilstate (lua_State *L, int statesmask) {
   global_State *g = G(L);
   while (!testbit(statesmask, g->gcstate))
-    singlestep(L);
+    g->GCwork += singlestep(L);
 }
 
 
@@ -1146,6 +1153,7 @@ static void incstep (lua_State *L) {
   debt = (debt < MAX_LMEM / stepmul) ? debt * stepmul : MAX_LMEM;
   do {  /* always perform at least one single step */
     lu_mem work = singlestep(L);  /* do some work */
+    g->GCwork += work;
     debt -= work;
   } while (debt > -GCSTEPSIZE && g->gcstate != GCSpause);
   if (g->gcstate == GCSpause)
@@ -1210,6 +1218,8 @@ void luaC_fullgc (lua_State *L, int isemergency) {
     luaC_runtilstate(L, bitmask(GCSpropagate));
   }
   g->gckind = origkind;
+  if (isemergency)  /* give back the memory of the cached threads too */
+    luaE_freethreadcache(L);
   setpause(g, gettotalbytes(g));
   if (!isemergency)   /* do not run finalizers during emergency GC */
     callallpendingfinalizers(L, 1);
@@ -1218,3 +1228,77 @@ void luaC_fullgc (lua_State *L, int isemergency) {
 /* }====================================================== */
 
 
+/*
+** {======================================================
+** Heap census
+** =======================================================
+*/
+
+
+static lu_mem objsize (GCObject *o) {
+  switch (gch(o)->tt) {
+    case LUA_TSHRSTR:
+      return sizestring(gco2ts(o));
+    case LUA_TLNGSTR:
+      return sizelngstr(gco2ts(o));
+    case LUA_TUSERDATA:
+      return sizeudata(gco2u(o));
+    case LUA_TTABLE: {
+      Table *h = gco2t(o);
+      lu_mem size = sizeof(Table) + sizeof(TValue) * h->sizearray;
+      if (!luaH_isdummy(h->node))
+        size += sizeof(Node) * cast(size_t, sizenode(h));
+      return size;
+    }
+    case LUA_TLCL:
+      return sizeLclosure(gco2lcl(o)->nupvalues);
+    case LUA_TCCL:
+      return sizeCclosure(gco2ccl(o)->nupvalues);
+    case LUA_TTHREAD: {
+      lua_State *th = gco2th(o);
+      return sizeof(lua_State) + sizeof(TValue) * th->stacksize;
+    }
+    case LUA_TPROTO: {
+      Proto *f = gco2p(o);
+      return sizeof(Proto) + sizeof(Instruction) * f->sizecode +
+                             sizeof(Proto *) * f->sizep +
+                             (sizeof(TValue) + sizeof(int)) * f->sizek +
+                             sizeof(int) * f->sizelineinfo +
+                             sizeof(LocVar) * f->sizelocvars +
+                             sizeof(Upvaldesc) * f->sizeupvalues;
+    }
+    case LUA_TUPVAL:
+      return sizeof(UpVal);
+    default: lua_assert(0); return 0;
+  }
+}
+
+
+static void censuslist (GCObject *o, size_t *count, size_t *bytes) {
+  for (; o != NULL; o = gch(o)->next) {
+    int t = novariant(gch(o)->tt);
+    count[t]++;
+    bytes[t] += objsize(o);
+  }
+}
+
+
+/*
+** count the objects of each type and the memory they own; dead objects
+** not yet swept are included, as is the main thread
+*/
+void luaC_census (lua_State *L, size_t *count, size_t *bytes) {
+  global_State *g = G(L);
+  int i;
+  memset(count, 0, LUA_NUMCENSUS * sizeof(size_t));
+  memset(bytes, 0, LUA_NUMCENSUS * sizeof(size_t));
+  censuslist(g->allgc, count, bytes);
+  censuslist(g->finobj, count, bytes);
+  censuslist(g->tobefnz, count, bytes);
+  for (i = 0; i < g->strt.size; i++)
+    censuslist(g->strt.hash[i], count, bytes);
+  count[LUA_TTHREAD]++;  /* the main thread lives outside the lists */
+  bytes[LUA_TTHREAD] += objsize(obj2gco(g->mainthread));
+}
+
+/* }====================================================== */
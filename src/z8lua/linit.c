@@ -45,6 +45,17 @@ static const luaL_Reg preloadedlibs[] = {
 };
 
 
+/*
+** these make up the sandbox carts run in: no files, no loading of code,
+** and none of the standard library tables
+*/
+static const lua_CFunction cartlibs[] = {
+  luaopen_cartbase,
+  luaopen_pico8,
+  NULL
+};
+
+
 LUALIB_API void luaL_openlibs (lua_State *L) {
   const luaL_Reg *lib;
   /* call open functions from 'loadedlibs' and set results to global table */
@@ -61,3 +72,18 @@ LUALIB_API void luaL_openlibs (lua_State *L) {
   lua_pop(L, 1);  /* remove _PRELOAD table */
 }
 
+
+/*
+** The global table is made with room for 'n' entries before anything
+** goes in, so that it is filled in one pass instead of being rehashed
+** every time it runs out of space.
+*/
+LUALIB_API void luaL_opencartlibs (lua_State *L, int n) {
+  const lua_CFunction *lib;
+  lua_createtable(L, 0, n);
+  lua_rawseti(L, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+  for (lib = cartlibs; *lib; lib++) {
+    (*lib)(L);
+    lua_pop(L, 1);  /* remove lib */
+  }
+}
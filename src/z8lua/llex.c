@@ -32,6 +32,19 @@
 #define currIsNewline(ls)	(ls->current == '\n' || ls->current == '\r')
 
 
+/*
+** While a token lies inside the chunk the reader handed over, it is
+** scanned straight from there: 'ls->current' is always the byte just
+** before 'ls->z->p', and 'ls->z->n' bytes follow it.
+*/
+#define ahead(ls,i)	cast_uchar((ls)->z->p[i])
+
+#define isBlank(c)	((c) == ' ' || (c) == '\t' || (c) == '\f' || (c) == '\v')
+
+/* initial size of the token buffer: any short string fits */
+#define LEXBUFFER	(LUAI_MAXSHORTLEN + 1)
+
+
 /* ORDER RESERVED */
 static const char *const luaX_tokens [] = {
     "and", "break", "do", "else", "elseif",
@@ -52,19 +65,62 @@ static const char *const luaX_tokens [] = {
 static l_noret lexerror (LexState *ls, const char *msg, int token);
 
 
-static void save (LexState *ls, int c) {
+static void growbuffer (LexState *ls, size_t n) {
   Mbuffer *b = ls->buff;
-  if (luaZ_bufflen(b) + 1 > luaZ_sizebuffer(b)) {
-    size_t newsize;
-    if (luaZ_sizebuffer(b) >= MAX_SIZET/2)
+  size_t newsize = luaZ_sizebuffer(b);
+  do {
+    if (newsize >= MAX_SIZET/2)
       lexerror(ls, "lexical element too long", 0);
-    newsize = luaZ_sizebuffer(b) * 2;
-    luaZ_resizebuffer(ls->L, b, newsize);
-  }
+    newsize *= 2;
+  } while (luaZ_bufflen(b) + n > newsize);
+  luaZ_resizebuffer(ls->L, b, newsize);
+}
+
+
+static void save (LexState *ls, int c) {
+  Mbuffer *b = ls->buff;
+  if (luaZ_bufflen(b) + 1 > luaZ_sizebuffer(b))
+    growbuffer(ls, 1);
   b->buffer[luaZ_bufflen(b)++] = cast(char, c);
 }
 
 
+/* consume 'current' and the 'n' bytes after it, saving them if 'keep' */
+static void skip (LexState *ls, size_t n, int keep) {
+  ZIO *z = ls->z;
+  if (keep) {
+    Mbuffer *b = ls->buff;
+    if (luaZ_bufflen(b) + n + 1 > luaZ_sizebuffer(b))
+      growbuffer(ls, n + 1);
+    memcpy(b->buffer + luaZ_bufflen(b), z->p - 1, n + 1);
+    luaZ_bufflen(b) += n + 1;
+  }
+  z->p += n;
+  z->n -= n;
+  next(ls);
+}
+
+
+/* save a name; 'current' is its first character */
+static void save_name (LexState *ls) {
+  do {
+    size_t n = 0;
+    while (n < ls->z->n && lislalnum(ahead(ls, n))) n++;
+    skip(ls, n, 1);
+  } while (lislalnum(ls->current));
+}
+
+
+/* skip the rest of a line; the newline is left in 'current' */
+static void skip_line (LexState *ls) {
+  while (!currIsNewline(ls) && ls->current != EOZ) {
+    size_t n = 0;
+    while (n < ls->z->n && ahead(ls, n) != '\n' && ahead(ls, n) != '\r') n++;
+    skip(ls, n, 0);
+  }
+}
+
+
 void luaX_init (lua_State *L) {
   int i;
   for (i=0; i<NUM_RESERVED; i++) {
@@ -133,6 +189,8 @@ TString *luaX_newstring (LexState *ls, const char *str, size_t l) {
   lua_State *L = ls->L;
   TValue *o;  /* entry for `str' */
   TString *ts = luaS_newlstr(L, str, l);  /* create new string */
+  if (isreserved(ts))  /* fixed strings need no anchor */
+    return ts;
   setsvalue2s(L, L->top++, ts);  /* temporarily anchor it in stack */
   o = luaH_set(L, ls->fs->h, L->top - 1);
   if (ttisnil(o)) {  /* not in use yet? (see 'addK') */
@@ -179,7 +237,7 @@ void luaX_setinput (lua_State *L, LexState *ls, ZIO *z, TString *source,
   ls->source = source;
   ls->envn = luaS_new(L, LUA_ENV);  /* create env name */
   luaS_fix(ls->envn);  /* never collect this name */
-  luaZ_resizebuffer(ls->L, ls->buff, LUA_MINBUFFER);  /* initialize buffer */
+  luaZ_resizebuffer(ls->L, ls->buff, LEXBUFFER);  /* initialize buffer */
 }
 
 
@@ -301,9 +359,11 @@ static void read_long_string (LexState *ls, SemInfo *seminfo, int sep) {
         if (!seminfo) luaZ_resetbuffer(ls->buff);  /* avoid wasting space */
         break;
       }
-      default: {
-        if (seminfo) save_and_next(ls);
-        else next(ls);
+      default: {  /* up to the next ']' or line break */
+        size_t n = 0;
+        while (n < ls->z->n && ahead(ls, n) != ']' &&
+               ahead(ls, n) != '\n' && ahead(ls, n) != '\r') n++;
+        skip(ls, n, seminfo != NULL);
       }
     }
   } endloop:
@@ -405,8 +465,12 @@ static void read_string (LexState *ls, int del, SemInfo *seminfo) {
        only_save: save(ls, c);  /* save 'c' */
        no_save: break;
       }
-      default:
-        save_and_next(ls);
+      default: {  /* up to the next delimiter, escape or line break */
+        size_t n = 0;
+        while (n < ls->z->n && ahead(ls, n) != del && ahead(ls, n) != '\\' &&
+               ahead(ls, n) != '\n' && ahead(ls, n) != '\r') n++;
+        skip(ls, n, 1);
+      }
     }
   }
   save_and_next(ls);  /* skip delimiter */
@@ -425,7 +489,9 @@ static int llex (LexState *ls, SemInfo *seminfo) {
         break;
       }
       case ' ': case '\f': case '\t': case '\v': {  /* spaces */
-        next(ls);
+        size_t n = 0;
+        while (n < ls->z->n && isBlank(ahead(ls, n))) n++;
+        skip(ls, n, 0);
         break;
       }
       case '?': {  /* '?' (shorthand print) */
@@ -449,8 +515,7 @@ static int llex (LexState *ls, SemInfo *seminfo) {
           }
         }
         /* else short comment */
-        while (!currIsNewline(ls) && ls->current != EOZ)
-          next(ls);  /* skip until end of line (or end of file) */
+        skip_line(ls);  /* skip until end of line (or end of file) */
         break;
       }
       case '/': {  /* '/' or '/=' or '//' (short comment) */
@@ -458,8 +523,7 @@ static int llex (LexState *ls, SemInfo *seminfo) {
         if (ls->current == '=') { next(ls); return TK_DIVE; }
         else if (ls->current != '/') return '/';
         next(ls);
-        while (!currIsNewline(ls) && ls->current != EOZ)
-          next(ls);  /* skip until end of line (or end of file) */
+        skip_line(ls);  /* skip until end of line (or end of file) */
         break;
       }
       case '+': case '*': case '%': case '&':
@@ -568,9 +632,7 @@ static int llex (LexState *ls, SemInfo *seminfo) {
       default: {
         if (lislalpha(ls->current)) {  /* identifier or reserved word? */
           TString *ts;
-          do {
-            save_and_next(ls);
-          } while (lislalnum(ls->current));
+          save_name(ls);
           ts = luaX_newstring(ls, luaZ_buffer(ls->buff),
                                   luaZ_bufflen(ls->buff));
           seminfo->ts = ts;
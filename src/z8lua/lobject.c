@@ -170,29 +170,31 @@ static lua_Number lua_strx2number (const char *s, char **endptr) {
 
 
 /*
-** convert an hexadecimal or binary numeric string to a number
-** Pure-integer implementation: no double arithmetic.
+** convert an hexadecimal or binary numeric string in [s, end) to a
+** number; pure-integer implementation: no double arithmetic.
 */
-static lua_Number lua_strany2number (const char *s, char **endptr, int base) {
+static lua_Number lua_strany2number (const char *s, const char *end,
+                                     const char **endptr, int base) {
   uint32_t int_part = 0;
   uint32_t frac_part = 0;  /* accumulated fractional bits (16-bit fixed) */
   uint32_t frac_scale = 65536;  /* current place value: 65536/base^n */
   int neg = 0;
   int has_digits = 0;
-  *endptr = cast(char *, s);  /* nothing is valid yet */
+  *endptr = s;  /* nothing is valid yet */
 
-  while (lisspace(cast_uchar(*s))) s++;
-  neg = isneg(&s);
+  while (s < end && lisspace(cast_uchar(*s))) s++;
+  if (s < end) neg = isneg(&s);
 
   /* Validate prefix */
-  if (*s != '0' || (base == 2  && *(s+1) != 'b' && *(s+1) != 'B')
-                || (base == 16 && *(s+1) != 'x' && *(s+1) != 'X'))
+  if (end - s < 2 || *s != '0'
+                  || (base == 2  && *(s+1) != 'b' && *(s+1) != 'B')
+                  || (base == 16 && *(s+1) != 'x' && *(s+1) != 'X'))
     return 0;
 
   s += 2;  /* skip '0x' or '0b' */
 
   /* Integer part */
-  for (;;) {
+  for (; s < end; s++) {
     int d;
     char c = *s;
     if      (c >= '0' && c <= '9') d = c - '0';
@@ -202,16 +204,14 @@ static lua_Number lua_strany2number (const char *s, char **endptr, int base) {
     if (d >= base) break;
     int_part = int_part * (uint32_t)base + (uint32_t)d;
     has_digits = 1;
-    s++;
   }
 
   if (!has_digits) return 0;
-  *endptr = cast(char *, s);
+  *endptr = s;
 
   /* Fractional part */
-  if (*s == '.') {
-    s++;
-    for (;;) {
+  if (s < end && *s == '.') {
+    for (s++; s < end; s++) {
       int d;
       char c = *s;
       if      (c >= '0' && c <= '9') d = c - '0';
@@ -223,9 +223,8 @@ static lua_Number lua_strany2number (const char *s, char **endptr, int base) {
       frac_scale /= (uint32_t)base;
       if (frac_scale > 0)
         frac_part += (uint32_t)d * frac_scale;
-      s++;
     }
-    *endptr = cast(char *, s);
+    *endptr = s;
   }
 
   {
@@ -235,19 +234,28 @@ static lua_Number lua_strany2number (const char *s, char **endptr, int base) {
 }
 
 
+/*
+** convert the 'len' bytes at 's' to a number; they need not be followed
+** by a '\0', so that 'split' may convert its fields where they are
+*/
 int luaO_str2d (const char *s, size_t len, lua_Number *result) {
-  char *endptr;
-  if (strpbrk(s, "nN"))  /* reject 'inf' and 'nan' */
-    return 0;
-  else if (strpbrk(s, "xX"))  /* hexa? */
-    *result = lua_strany2number(s, &endptr, 16);
-  else if (strpbrk(s, "bB"))  /* binary? */
-    *result = lua_strany2number(s, &endptr, 2);
-  else
-    *result = lua_str2number(s, &endptr);
+  const char *end = s + len;
+  const char *endptr;
+  const char *p;
+  int base = 10;
+  for (p = s; p < end; p++) {  /* one look at the letters that matter */
+    int c = *p | ('A' ^ 'a');
+    if (c == 'n') return 0;  /* reject 'inf' and 'nan' */
+    else if (c == 'x') base = 16;
+    else if (c == 'b' && base == 10) base = 2;
+  }
+  if (base == 10)
+    *result = fix32_from_chars(s, end, &endptr);
+  else  /* hexa or binary */
+    *result = lua_strany2number(s, end, &endptr, base);
   if (endptr == s) return 0;  /* nothing recognized */
-  while (lisspace(cast_uchar(*endptr))) endptr++;
-  return (endptr == s + len);  /* OK if no trailing characters */
+  while (endptr < end && lisspace(cast_uchar(*endptr))) endptr++;
+  return (endptr == end);  /* OK if no trailing characters */
 }
 
 
@@ -307,7 +315,7 @@ const char *luaO_pushvfstring (lua_State *L, const char *fmt, va_list argp) {
   }
   luaD_checkstack(L, 1);
   pushstr(L, fmt, strlen(fmt));
-  if (n > 0) luaV_concat(L, n + 1);
+  if (n > 0) luaV_concat(L, n + 1, -1);
   return svalue(L->top - 1);
 }
 
@@ -44,12 +44,14 @@
 ** 0 - Lua function
 ** 1 - light C function
 ** 2 - regular C function (closure)
+** 3 - fast C function (a lua_FastReg, see lua_pushfastcfunction)
 */
 
 /* Variant tags for functions */
 #define LUA_TLCL	(LUA_TFUNCTION | (0 << 4))  /* Lua closure */
 #define LUA_TLCF	(LUA_TFUNCTION | (1 << 4))  /* light C function */
 #define LUA_TCCL	(LUA_TFUNCTION | (2 << 4))  /* C closure */
+#define LUA_TFCF	(LUA_TFUNCTION | (3 << 4))  /* fast C function */
 
 
 /* Variant tags for strings */
@@ -143,6 +145,7 @@ typedef struct lua_TValue TValue;
 #define ttisCclosure(o)		checktag((o), ctb(LUA_TCCL))
 #define ttisLclosure(o)		checktag((o), ctb(LUA_TLCL))
 #define ttislcf(o)		checktag((o), LUA_TLCF)
+#define ttisfcf(o)		checktag((o), LUA_TFCF)
 #define ttisuserdata(o)		checktag((o), ctb(LUA_TUSERDATA))
 #define ttisthread(o)		checktag((o), ctb(LUA_TTHREAD))
 #define ttisdeadkey(o)		checktag((o), LUA_TDEADKEY)
@@ -161,6 +164,7 @@ typedef struct lua_TValue TValue;
 #define clLvalue(o)	check_exp(ttisLclosure(o), &val_(o).gc->cl.l)
 #define clCvalue(o)	check_exp(ttisCclosure(o), &val_(o).gc->cl.c)
 #define fvalue(o)	check_exp(ttislcf(o), val_(o).f)
+#define fcfvalue(o)	check_exp(ttisfcf(o), cast(const lua_FastReg *, val_(o).p))
 #define hvalue(o)	check_exp(ttistable(o), &val_(o).gc->h)
 #define bvalue(o)	check_exp(ttisboolean(o), val_(o).b)
 #define thvalue(o)	check_exp(ttisthread(o), &val_(o).gc->th)
@@ -192,6 +196,9 @@ typedef struct lua_TValue TValue;
 #define setfvalue(obj,x) \
   { TValue *io=(obj); val_(io).f=(x); settt_(io, LUA_TLCF); }
 
+#define setfcfvalue(obj,x) \
+  { TValue *io=(obj); val_(io).p=cast(void *, (x)); settt_(io, LUA_TFCF); }
+
 #define setpvalue(obj,x) \
   { TValue *io=(obj); val_(io).p=(x); settt_(io, LUA_TLIGHTUSERDATA); }
 
@@ -467,6 +474,7 @@ typedef struct LocVar {
 typedef struct Proto {
   CommonHeader;
   TValue *k;  /* constants used by the function */
+  int *kslot;  /* node where each constant was last found as a key */
   Instruction *code;
   struct Proto **p;  /* functions defined inside the function */
   int *lineinfo;  /* map from opcodes to source lines (debug information) */
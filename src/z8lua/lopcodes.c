@@ -51,13 +51,20 @@ LUAI_DDEF const char *const luaP_opnames[NUM_OPCODES+1] = {
   "PEEK4",
   "LEN",
   "CONCAT",
+  "ADDK",
+  "SUBK",
+  "MULK",
   "JMP",
   "EQ",
   "LT",
   "LE",
+  "EQK",
+  "LTK",
+  "LEK",
   "TEST",
   "TESTSET",
   "CALL",
+  "POKE",
   "TAILCALL",
   "RETURN",
   "FORLOOP",
@@ -107,18 +114,25 @@ LUAI_DDEF const lu_byte luaP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 1, OpArgR, OpArgN, iABC)		/* OP_UNM */
  ,opmode(0, 1, OpArgR, OpArgN, iABC)		/* OP_BNOT */
  ,opmode(0, 1, OpArgR, OpArgN, iABC)		/* OP_NOT */
- ,opmode(0, 1, OpArgR, OpArgN, iABC)		/* OP_PEEK */
- ,opmode(0, 1, OpArgR, OpArgN, iABC)		/* OP_PEEK2 */
- ,opmode(0, 1, OpArgR, OpArgN, iABC)		/* OP_PEEK4 */
+ ,opmode(0, 1, OpArgK, OpArgN, iABC)		/* OP_PEEK */
+ ,opmode(0, 1, OpArgK, OpArgN, iABC)		/* OP_PEEK2 */
+ ,opmode(0, 1, OpArgK, OpArgN, iABC)		/* OP_PEEK4 */
  ,opmode(0, 1, OpArgR, OpArgN, iABC)		/* OP_LEN */
  ,opmode(0, 1, OpArgR, OpArgR, iABC)		/* OP_CONCAT */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_ADDK */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_SUBK */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_MULK */
  ,opmode(0, 0, OpArgR, OpArgN, iAsBx)		/* OP_JMP */
  ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_EQ */
  ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_LT */
  ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_LE */
+ ,opmode(1, 0, OpArgR, OpArgK, iABC)		/* OP_EQK */
+ ,opmode(1, 0, OpArgR, OpArgK, iABC)		/* OP_LTK */
+ ,opmode(1, 0, OpArgR, OpArgK, iABC)		/* OP_LEK */
  ,opmode(1, 0, OpArgN, OpArgU, iABC)		/* OP_TEST */
  ,opmode(1, 1, OpArgR, OpArgU, iABC)		/* OP_TESTSET */
  ,opmode(0, 1, OpArgU, OpArgU, iABC)		/* OP_CALL */
+ ,opmode(0, 1, OpArgU, OpArgU, iABC)		/* OP_POKE */
  ,opmode(0, 1, OpArgU, OpArgU, iABC)		/* OP_TAILCALL */
  ,opmode(0, 0, OpArgU, OpArgN, iABC)		/* OP_RETURN */
  ,opmode(0, 1, OpArgR, OpArgN, iAsBx)		/* OP_FORLOOP */
@@ -203,22 +203,30 @@ OP_ROTR,/*	A B C	R(A) := RK(B) >>< RK(C)				*/
 OP_UNM,/*	A B	R(A) := -R(B)					*/
 OP_BNOT,/*	A B	R(A) := ~R(B)					*/
 OP_NOT,/*	A B	R(A) := not R(B)				*/
-OP_PEEK,/*	A B	R(A) := @ R(B)					*/
-OP_PEEK2,/*	A B	R(A) := % R(B)					*/
-OP_PEEK4,/*	A B	R(A) := $ R(B)					*/
+OP_PEEK,/*	A B	R(A) := @ RK(B)					*/
+OP_PEEK2,/*	A B	R(A) := % RK(B)					*/
+OP_PEEK4,/*	A B	R(A) := $ RK(B)					*/
 OP_LEN,/*	A B	R(A) := length of R(B)				*/
 
 OP_CONCAT,/*	A B C	R(A) := R(B).. ... ..R(C)			*/
 
+OP_ADDK,/*	A B C	R(A) := R(B) + K(C)				*/
+OP_SUBK,/*	A B C	R(A) := R(B) - K(C)				*/
+OP_MULK,/*	A B C	R(A) := R(B) * K(C)				*/
+
 OP_JMP,/*	A sBx	pc+=sBx; if (A) close all upvalues >= R(A - 1)	*/
 OP_EQ,/*	A B C	if ((RK(B) == RK(C)) ~= A) then pc++		*/
 OP_LT,/*	A B C	if ((RK(B) <  RK(C)) ~= A) then pc++		*/
 OP_LE,/*	A B C	if ((RK(B) <= RK(C)) ~= A) then pc++		*/
+OP_EQK,/*	A B C	if ((R(B) == K(C)) ~= A) then pc++		*/
+OP_LTK,/*	A B C	if ((R(B) <  K(C)) ~= A) then pc++  (see note)	*/
+OP_LEK,/*	A B C	if ((R(B) <= K(C)) ~= A) then pc++  (see note)	*/
 
 OP_TEST,/*	A C	if not (R(A) <=> C) then pc++			*/
 OP_TESTSET,/*	A B C	if (R(B) <=> C) then R(A) := R(B) else pc++	*/
 
 OP_CALL,/*	A B C	R(A), ... ,R(A+C-2) := R(A)(R(A+1), ... ,R(A+B-1)) */
+OP_POKE,/*	A B C	R(A), ... ,R(A+C-2) := R(A)(R(A+1), R(A+2))  (see note) */
 OP_TAILCALL,/*	A B C	return R(A)(R(A+1), ... ,R(A+B-1))		*/
 OP_RETURN,/*	A B	return R(A), ... ,R(A+B-2)	(see note)	*/
 
@@ -249,6 +257,11 @@ OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
   set to last_result+1, so next open instruction (OP_CALL, OP_RETURN,
   OP_SETLIST) may use `top'.
 
+  (*) OP_POKE is a call 'pokeN(addr, value)' of the global poke, poke2
+  or poke4, with the width N in B.  While R(A) is still the builtin
+  registered for N it stores to PICO-8 RAM directly; otherwise it is
+  exactly OP_CALL A 3 C.
+
   (*) In OP_VARARG, if (B == 0) then use actual number of varargs and
   set top (like in OP_CALL with C == 0).
 
@@ -259,6 +272,10 @@ OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
 
   (*) In OP_LOADKX, the next 'instruction' is always EXTRAARG.
 
+  (*) In OP_LTK and OP_LEK, bit 1 of A means the operands are swapped,
+  that is the comparison is K(C) < R(B) (resp. <=); the condition is
+  bit 0.  K(C) is always a number in those, and in OP_ADDK to OP_MULK.
+
   (*) For comparisons, A specifies what condition the test should accept
   (true or false).
 
@@ -0,0 +1,711 @@
+/*
+** Peephole optimizer for finished functions
+** See Copyright Notice in lua.h
+*/
+
+
+#include <string.h>
+
+#define lopt_c
+#define LUA_CORE
+
+#include "lua.h"
+
+#include "lcode.h"
+#include "ldo.h"
+#include "lobject.h"
+#include "lopcodes.h"
+#include "lopt.h"
+#include "lparser.h"
+#include "lstring.h"
+
+
+/*
+** The pass runs from 'close_func', once all the code of a function is
+** generated and before its vectors are trimmed.  It never moves code
+** around: it rewrites instructions in place, marks the ones that became
+** useless and squeezes them out at the end, fixing jump offsets, line
+** info and the scopes of local variables.  A removed instruction behaves
+** as a no-op that falls through to the next one, so a jump to it lands on
+** the next instruction that is kept.
+*/
+
+/* instruction flags */
+#define TARGET		1	/* a jump or a skip lands here */
+#define PINNED		2	/* must stay right after the previous one */
+#define DEAD		4	/* removed when the code is compacted */
+#define REACHED		8	/* reachable from the entry point */
+#define LOOP		16	/* a backward jump lands here */
+
+#define MAXHOPS		16	/* longest jump chain followed */
+
+
+typedef lu_int32 RegSet;  /* one bit per register */
+
+typedef struct OptState {
+  FuncState *fs;
+  Proto *f;
+  int n;  /* number of instructions */
+  int nw;  /* words in a register set */
+  int loops;  /* number of backward jumps */
+  int *newpc;  /* new position of each instruction */
+  RegSet *live;  /* registers live on entry to each instruction */
+  RegSet *use, *def;  /* registers read and written by each instruction */
+  RegSet *pinned;  /* registers captured by closures: always live */
+  RegSet *out;  /* scratch set */
+  lu_byte *flags;
+} OptState;
+
+
+#define testreg(s,r)	((s)[(r) >> 5] & (cast(RegSet, 1) << ((r) & 31)))
+
+#define liveat(os,pc)	((os)->live + (pc) * (os)->nw)
+#define useat(os,pc)	((os)->use + (pc) * (os)->nw)
+#define defat(os,pc)	((os)->def + (pc) * (os)->nw)
+
+#define jumpdest(i,pc)	((pc) + 1 + GETARG_sBx(i))
+
+#define isnumk(f,x)	(ISK(x) && ttisnumber(&(f)->k[INDEXK(x)]))
+
+
+static void setregs (OptState *os, RegSet *s, int from, int to) {
+  if (to >= os->f->maxstacksize) to = os->f->maxstacksize - 1;
+  while (from <= to) {  /* a word at a time */
+    int last = ((from | 31) < to) ? (from | 31) : to;
+    s[from >> 5] |= (~cast(RegSet, 0) >> (31 - (last & 31))) &
+                    (~cast(RegSet, 0) << (from & 31));
+    from = last + 1;
+  }
+}
+
+
+static int isjump (OpCode op) {
+  return (op == OP_JMP || op == OP_FORLOOP || op == OP_FORPREP ||
+          op == OP_TFORLOOP);
+}
+
+
+static int successors (OptState *os, int pc, int *s) {
+  Instruction i = os->f->code[pc];
+  OpCode op = GET_OPCODE(i);
+  if (os->flags[pc] & DEAD) {  /* falls through */
+    s[0] = pc + 1;
+    return 1;
+  }
+  switch (op) {
+    case OP_JMP: case OP_FORPREP:
+      s[0] = jumpdest(i, pc);
+      return 1;
+    case OP_FORLOOP: case OP_TFORLOOP:
+      s[0] = pc + 1;
+      s[1] = jumpdest(i, pc);
+      return 2;
+    case OP_RETURN:
+      return 0;
+    case OP_LOADBOOL:
+      s[0] = pc + (GETARG_C(i) ? 2 : 1);
+      return 1;
+    case OP_LOADKX:  /* skip the extra argument */
+      s[0] = pc + 2;
+      return 1;
+    case OP_SETLIST:
+      s[0] = pc + (GETARG_C(i) ? 1 : 2);
+      return 1;
+    default:
+      s[0] = pc + 1;
+      if (testTMode(op)) {
+        s[1] = pc + 2;
+        return 2;
+      }
+      return 1;
+  }
+}
+
+
+static void usereg (OptState *os, RegSet *use, int rk) {
+  if (!ISK(rk)) setregs(os, use, rk, rk);
+}
+
+
+/*
+** Registers read ('use') and always written ('def') by an instruction.
+** Reads may be overestimated, but writes must not: an instruction that
+** only writes a register on some paths does not define it.  Registers
+** captured by closures are in 'pinned' and need not be listed here.
+*/
+static void usedef (OptState *os, int pc) {
+  Instruction i = os->f->code[pc];
+  RegSet *use = useat(os, pc);
+  RegSet *def = defat(os, pc);
+  OpCode op = GET_OPCODE(i);
+  int a = GETARG_A(i);
+  int b = GETARG_B(i);
+  int c = GETARG_C(i);
+  int top = os->f->maxstacksize;
+  int w;
+  for (w = 0; w < os->nw; w++) use[w] = def[w] = 0;
+  switch (op) {
+    case OP_LOADK: case OP_LOADKX: case OP_LOADBOOL:
+    case OP_GETUPVAL: case OP_NEWTABLE: case OP_CLOSURE:
+      setregs(os, def, a, a);
+      break;
+    case OP_LOADNIL:
+      setregs(os, def, a, a + b);
+      break;
+    case OP_GETTABUP:
+      usereg(os, use, c);
+      setregs(os, def, a, a);
+      break;
+    case OP_SETTABUP:
+      usereg(os, use, b);
+      usereg(os, use, c);
+      break;
+    case OP_SETUPVAL: case OP_TEST:
+      setregs(os, use, a, a);
+      break;
+    case OP_SETTABLE:
+      setregs(os, use, a, a);
+      usereg(os, use, b);
+      usereg(os, use, c);
+      break;
+    case OP_SELF:
+      setregs(os, use, b, b);
+      usereg(os, use, c);
+      setregs(os, def, a, a + 1);
+      break;
+    case OP_CONCAT:
+      setregs(os, use, b, c);
+      setregs(os, def, a, a);
+      break;
+    case OP_JMP:
+      if (a) setregs(os, use, a - 1, top);  /* values go to the upvalues */
+      break;
+    case OP_TESTSET:
+      setregs(os, use, b, b);
+      break;
+    case OP_CALL:
+      setregs(os, use, a, b ? a + b - 1 : top);
+      if (c) setregs(os, def, a, a + c - 2);
+      break;
+    case OP_POKE:
+      setregs(os, use, a, a + 2);
+      if (c) setregs(os, def, a, a + c - 2);
+      break;
+    case OP_TAILCALL:
+      setregs(os, use, a, b ? a + b - 1 : top);
+      break;
+    case OP_RETURN:
+      setregs(os, use, a, b ? a + b - 2 : top);
+      break;
+    case OP_FORLOOP: case OP_FORPREP:
+      setregs(os, use, a, a + 2);
+      break;
+    case OP_TFORCALL:
+      setregs(os, use, a, a + 2);
+      setregs(os, def, a + 3, a + 2 + c);
+      break;
+    case OP_TFORLOOP:
+      setregs(os, use, a + 1, a + 1);
+      break;
+    case OP_SETLIST:
+      setregs(os, use, a, b ? a + b : top);
+      break;
+    case OP_VARARG:
+      if (b) setregs(os, def, a, a + b - 2);
+      break;
+    case OP_EXTRAARG:
+      break;
+    default:  /* MOVE, arithmetic and comparisons */
+      if (getBMode(op) == OpArgR) setregs(os, use, b, b);
+      else if (getBMode(op) == OpArgK) usereg(os, use, b);
+      if (getCMode(op) == OpArgK) usereg(os, use, c);
+      if (testAMode(op)) setregs(os, def, a, a);
+      break;
+  }
+}
+
+
+/* whether an instruction may change register 'r' */
+static int writes (Instruction i, int r) {
+  OpCode op = GET_OPCODE(i);
+  int a = GETARG_A(i);
+  switch (op) {
+    case OP_LOADNIL: return (a <= r && r <= a + GETARG_B(i));
+    case OP_SELF: return (r == a || r == a + 1);
+    case OP_CONCAT: return (r == a || (GETARG_B(i) <= r && r <= GETARG_C(i)));
+    case OP_FORLOOP: return (a <= r && r <= a + 3);
+    case OP_CALL: case OP_POKE: case OP_TAILCALL: case OP_TFORCALL:
+    case OP_VARARG:
+      return (r >= a);
+    default: return (testAMode(op) && r == a);
+  }
+}
+
+
+static int captures (const Proto *p, int r) {
+  int j;
+  for (j = 0; j < p->sizeupvalues; j++)
+    if (p->upvalues[j].instack && p->upvalues[j].idx == r)
+      return 1;
+  return 0;
+}
+
+
+static void markcode (OptState *os) {
+  Proto *f = os->f;
+  int pc;
+  for (pc = 0; pc < os->n; pc++) {
+    Instruction i = f->code[pc];
+    OpCode op = GET_OPCODE(i);
+    if (isjump(op)) {
+      int dest = jumpdest(i, pc);
+      os->flags[dest] |= TARGET;
+      if (dest <= pc) {
+        os->flags[dest] |= LOOP;
+        os->loops++;
+      }
+    }
+    if (testTMode(op) || (op == OP_LOADBOOL && GETARG_C(i))) {
+      os->flags[pc + 1] |= PINNED;
+      os->flags[pc + 2] |= TARGET;
+    }
+    else if (op == OP_LOADKX || op == OP_TFORCALL ||
+             (op == OP_SETLIST && GETARG_C(i) == 0))
+      os->flags[pc + 1] |= PINNED;
+    else if (op == OP_CLOSURE) {
+      Proto *p = f->p[GETARG_Bx(i)];
+      int j;
+      for (j = 0; j < p->sizeupvalues; j++)
+        if (p->upvalues[j].instack)
+          setregs(os, os->pinned, p->upvalues[j].idx, p->upvalues[j].idx);
+    }
+  }
+}
+
+
+/*
+** {======================================================
+** Constant propagation
+** =======================================================
+*/
+
+static void loadnumber (OptState *os, int pc, lua_Number r) {
+  int k = luaK_numberK(os->fs, r);
+  if (k <= MAXARG_Bx)
+    os->f->code[pc] = CREATE_ABx(OP_LOADK, GETARG_A(os->f->code[pc]), k);
+}
+
+
+/*
+** Fold arithmetic on two constants and give comparisons and '+', '-',
+** '*' against a number their constant-operand opcode, the same way
+** lcode.c does when the constant is written in place.
+*/
+static void simplify (OptState *os, int pc) {
+  Proto *f = os->f;
+  Instruction *i = &f->code[pc];
+  OpCode op = GET_OPCODE(*i);
+  int a = GETARG_A(*i);
+  int b = GETARG_B(*i);
+  int c = GETARG_C(*i);
+  if (op >= OP_ADD && op <= OP_ROTR) {
+    if (isnumk(f, b) && isnumk(f, c)) {
+      lua_Number nb = nvalue(&f->k[INDEXK(b)]);
+      lua_Number nc = nvalue(&f->k[INDEXK(c)]);
+      if ((op == OP_DIV || op == OP_MOD) && nc == 0)
+        return;  /* do not attempt to divide by 0 */
+      loadnumber(os, pc, luaO_arith(NULL, op - OP_ADD + LUA_OPADD, nb, nc));
+    }
+    else if (op <= OP_MUL && !ISK(b) && isnumk(f, c))
+      SET_OPCODE(*i, op - OP_ADD + OP_ADDK);
+  }
+  else if (op == OP_EQ || op == OP_LT || op == OP_LE) {
+    if (ISK(b) == ISK(c))
+      return;
+    if (ISK(b)) {  /* constant goes to C; note the swap in A (bit 1) */
+      if (op != OP_EQ) {
+        if (!isnumk(f, b)) return;
+        a |= 2;
+      }
+      c = b; b = GETARG_C(*i);
+    }
+    else if (op != OP_EQ && !isnumk(f, c))
+      return;
+    *i = CREATE_ABC(op - OP_EQ + OP_EQK, a, b, c);
+  }
+}
+
+
+/* replace the reads of register 'r' in instruction 'pc' by constant 'k' */
+static void propagate (OptState *os, int pc, int r, int k) {
+  Proto *f = os->f;
+  Instruction *i = &f->code[pc];
+  OpCode op = GET_OPCODE(*i);
+  if (op == OP_MOVE) {
+    if (GETARG_B(*i) == r)
+      *i = CREATE_ABx(OP_LOADK, GETARG_A(*i), k);
+  }
+  else if (op >= OP_ADDK && op <= OP_MULK) {
+    if (GETARG_B(*i) == r && ttisnumber(&f->k[k]))
+      loadnumber(os, pc, luaO_arith(NULL, op - OP_ADDK + LUA_OPADD,
+                                    nvalue(&f->k[k]),
+                                    nvalue(&f->k[INDEXK(GETARG_C(*i))])));
+  }
+  else if (getOpMode(op) == iABC && k <= MAXINDEXRK) {
+    int found = 0;
+    if (getBMode(op) == OpArgK && GETARG_B(*i) == r) {
+      SETARG_B(*i, RKASK(k));
+      found = 1;
+    }
+    if (getCMode(op) == OpArgK && GETARG_C(*i) == r) {
+      SETARG_C(*i, RKASK(k));
+      found = 1;
+    }
+    if (found) simplify(os, pc);
+  }
+}
+
+
+/* register of local variable 'v': one per variable still active */
+static int localreg (OptState *os, int v) {
+  LocVar *lv = os->f->locvars;
+  int j, reg = 0;
+  for (j = 0; j < v; j++)
+    if (lv[j].startpc <= lv[v].startpc && lv[v].startpc < lv[j].endpc)
+      reg++;
+  return reg;
+}
+
+
+static int isconstant (OptState *os, int r, int from, int to) {
+  Proto *f = os->f;
+  int pc;
+  for (pc = from; pc < to; pc++) {
+    Instruction i = f->code[pc];
+    if (writes(i, r))
+      return 0;
+    if (GET_OPCODE(i) == OP_CLOSURE && captures(f->p[GETARG_Bx(i)], r))
+      return 0;  /* the closure may assign to it */
+  }
+  return 1;
+}
+
+
+/*
+** A local initialized with a constant and never assigned again in its
+** scope holds that constant wherever it is read.  Scoping rules keep
+** jumps from entering the scope past the initialization.
+*/
+static void propagateconstants (OptState *os) {
+  Proto *f = os->f;
+  int v;
+  for (v = 0; v < os->fs->nlocvars; v++) {
+    LocVar *lv = &f->locvars[v];
+    Instruction init;
+    int r, pc;
+    if (lv->startpc == 0 || lv->startpc >= lv->endpc ||
+        (os->flags[lv->startpc] & TARGET))
+      continue;
+    init = f->code[lv->startpc - 1];
+    if (GET_OPCODE(init) != OP_LOADK)
+      continue;
+    r = localreg(os, v);
+    if (GETARG_A(init) != r || !isconstant(os, r, lv->startpc, lv->endpc))
+      continue;
+    for (pc = lv->startpc; pc < lv->endpc; pc++)
+      propagate(os, pc, r, GETARG_Bx(init));
+  }
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Dead stores and redundant moves
+** =======================================================
+*/
+
+static void liveout (OptState *os, int pc, RegSet *out) {
+  int s[2];
+  int ns = successors(os, pc, s);
+  int j, w;
+  for (w = 0; w < os->nw; w++) out[w] = os->pinned[w];
+  for (j = 0; j < ns; j++) {
+    if (s[j] < os->n) {
+      RegSet *in = liveat(os, s[j]);
+      for (w = 0; w < os->nw; w++) out[w] |= in[w];
+    }
+  }
+}
+
+
+/* turn the registers live after 'pc' into the ones live before it */
+static void transfer (OptState *os, int pc, RegSet *out) {
+  RegSet *use = useat(os, pc);
+  RegSet *def = defat(os, pc);
+  int w;
+  for (w = 0; w < os->nw; w++)
+    out[w] = use[w] | (out[w] & ~def[w]);
+}
+
+
+/* update the registers live on entry to 'pc'; tell whether they changed */
+static int updatelive (OptState *os, int pc) {
+  RegSet *live = liveat(os, pc);
+  RegSet *out = os->out;
+  int w, changed = 0;
+  liveout(os, pc, out);
+  transfer(os, pc, out);
+  for (w = 0; w < os->nw; w++) {
+    if (live[w] != out[w]) {
+      live[w] = out[w];
+      changed = 1;
+    }
+  }
+  return changed;
+}
+
+
+/*
+** Going backwards, every instruction sees the final sets of the ones
+** that follow it; only a change at the target of a backward jump can
+** invalidate what was already computed.  Without loops the single pass
+** of 'removestores' is all it takes.
+*/
+static void computeliveness (OptState *os) {
+  int pc, changed;
+  for (pc = 0; pc < os->n; pc++)
+    usedef(os, pc);
+  if (os->loops == 0)
+    return;
+  do {
+    changed = 0;
+    for (pc = os->n - 1; pc >= 0; pc--) {
+      if (updatelive(os, pc) && (os->flags[pc] & LOOP))
+        changed = 1;
+    }
+  } while (changed);
+}
+
+
+/* instructions whose only effect is to set their A register */
+static int ispure (Instruction i) {
+  switch (GET_OPCODE(i)) {
+    case OP_MOVE: case OP_LOADK: case OP_LOADNIL: case OP_GETUPVAL:
+    case OP_NEWTABLE: case OP_NOT:
+      return 1;
+    case OP_LOADBOOL: return (GETARG_C(i) == 0);
+    default: return 0;
+  }
+}
+
+
+/*
+** Instructions that compute a single value into register A, reading
+** all their operands first, so they can write their result to any
+** other register.
+*/
+static int isretargetable (Instruction i, int r) {
+  OpCode op = GET_OPCODE(i);
+  switch (op) {
+    case OP_LOADNIL: return (GETARG_B(i) == 0);
+    case OP_GETTABUP: case OP_GETTABLE: return 1;
+    case OP_CONCAT: return (r < GETARG_B(i) || r > GETARG_C(i));
+    default:
+      return (ispure(i) || (op >= OP_ADD && op <= OP_LEN) ||
+              (op >= OP_ADDK && op <= OP_MULK));
+  }
+}
+
+
+/*
+** 'X t ...; MOVE l t' becomes 'X l ...' when 't' is not read afterwards,
+** which covers the temporaries of compound assignments.
+*/
+static int fusemove (OptState *os, int pc, RegSet *out) {
+  Instruction *code = os->f->code;
+  int l = GETARG_A(code[pc]);
+  int t = GETARG_B(code[pc]);
+  if (pc == 0 || (os->flags[pc] & TARGET) || (os->flags[pc - 1] & DEAD) ||
+      GETARG_A(code[pc - 1]) != t || !isretargetable(code[pc - 1], l) ||
+      testreg(out, t))
+    return 0;
+  SETARG_A(code[pc - 1], l);
+  usedef(os, pc - 1);
+  return 1;
+}
+
+
+static int isdeadstore (Instruction i, RegSet *out) {
+  int a = GETARG_A(i);
+  int last = (GET_OPCODE(i) == OP_LOADNIL) ? a + GETARG_B(i) : a;
+  if (!ispure(i))
+    return 0;
+  for (; a <= last; a++)
+    if (testreg(out, a)) return 0;
+  return 1;
+}
+
+
+static void removestores (OptState *os) {
+  Instruction *code = os->f->code;
+  int pc, w;
+  for (pc = os->n - 1; pc >= 0; pc--) {
+    Instruction i = code[pc];
+    liveout(os, pc, os->out);
+    if (!(os->flags[pc] & (PINNED | DEAD))) {
+      if ((GET_OPCODE(i) == OP_MOVE &&
+           (GETARG_A(i) == GETARG_B(i) || fusemove(os, pc, os->out))) ||
+          isdeadstore(i, os->out))
+        os->flags[pc] |= DEAD;
+    }
+    if (!(os->flags[pc] & DEAD))
+      transfer(os, pc, os->out);
+    for (w = 0; w < os->nw; w++) liveat(os, pc)[w] = os->out[w];
+  }
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Jumps
+** =======================================================
+*/
+
+static int finaltarget (OptState *os, int dest) {
+  int hops;
+  for (hops = 0; hops < MAXHOPS; hops++) {
+    Instruction i;
+    while (os->flags[dest] & DEAD) dest++;  /* last one is never dead */
+    i = os->f->code[dest];
+    if (GET_OPCODE(i) != OP_JMP || GETARG_A(i) != 0 ||
+        jumpdest(i, dest) == dest)
+      break;
+    dest = jumpdest(i, dest);
+  }
+  return dest;
+}
+
+
+/* a jump to an unconditional jump goes straight to its destination */
+static void threadjumps (OptState *os) {
+  Instruction *code = os->f->code;
+  int pc;
+  for (pc = 0; pc < os->n; pc++) {
+    if (GET_OPCODE(code[pc]) == OP_JMP && !(os->flags[pc] & DEAD)) {
+      int dest = finaltarget(os, jumpdest(code[pc], pc));
+      SETARG_sBx(code[pc], dest - (pc + 1));
+    }
+  }
+}
+
+
+static void removeunreachable (OptState *os) {
+  int *stack = os->newpc;  /* not in use yet */
+  int top = 0;
+  int pc;
+  os->flags[0] |= REACHED;
+  stack[top++] = 0;
+  while (top > 0) {
+    int s[2];
+    int ns, j;
+    pc = stack[--top];
+    ns = successors(os, pc, s);
+    for (j = 0; j < ns; j++) {
+      if (s[j] < os->n && !(os->flags[s[j]] & REACHED)) {
+        os->flags[s[j]] |= REACHED;
+        stack[top++] = s[j];
+      }
+    }
+  }
+  for (pc = 1; pc < os->n - 1; pc++) {  /* keep the final 'return' */
+    lu_byte fl = os->flags[pc];
+    if (!(fl & REACHED) && (!(fl & PINNED) || (os->flags[pc - 1] & DEAD)))
+      os->flags[pc] |= DEAD;
+  }
+}
+
+
+/* remove the jumps that land where execution would go anyway */
+static void removejumps (OptState *os) {
+  Instruction *code = os->f->code;
+  int pc;
+  for (pc = os->n - 1; pc >= 0; pc--) {
+    Instruction i = code[pc];
+    if (GET_OPCODE(i) == OP_JMP && GETARG_A(i) == 0 &&
+        !(os->flags[pc] & (PINNED | DEAD))) {
+      int dest = jumpdest(i, pc);
+      int j = pc + 1;
+      while (j < dest && (os->flags[j] & DEAD)) j++;
+      if (j == dest)
+        os->flags[pc] |= DEAD;
+    }
+  }
+}
+
+/* }====================================================== */
+
+
+static void compact (OptState *os) {
+  Proto *f = os->f;
+  int pc, v, cnt = 0;
+  for (pc = 0; pc < os->n; pc++) {
+    os->newpc[pc] = cnt;
+    if (!(os->flags[pc] & DEAD)) cnt++;
+  }
+  os->newpc[os->n] = cnt;
+  for (pc = 0; pc < os->n; pc++) {
+    Instruction i = f->code[pc];
+    int npc = os->newpc[pc];
+    if (os->flags[pc] & DEAD) continue;
+    if (isjump(GET_OPCODE(i)))
+      SETARG_sBx(i, os->newpc[jumpdest(i, pc)] - (npc + 1));
+    f->code[npc] = i;
+    f->lineinfo[npc] = f->lineinfo[pc];
+  }
+  for (v = 0; v < os->fs->nlocvars; v++) {
+    f->locvars[v].startpc = os->newpc[f->locvars[v].startpc];
+    f->locvars[v].endpc = os->newpc[f->locvars[v].endpc];
+  }
+  os->fs->pc = cnt;
+}
+
+
+void luaK_optimize (FuncState *fs) {
+  lua_State *L = fs->ls->L;
+  Proto *f = fs->f;
+  OptState os;
+  Udata *u;
+  size_t size;
+  os.fs = fs;
+  os.f = f;
+  os.n = fs->pc;
+  os.nw = (f->maxstacksize + 31) / 32;
+  os.loops = 0;
+  size = (os.n + 1) * sizeof(int) +
+         (3 * os.n + 2) * os.nw * sizeof(RegSet) + (os.n + 2);
+  /* the work area is a userdata on the stack, so errors do not leak it */
+  u = luaS_newudata(L, size, NULL);
+  setuvalue(L, L->top, u);
+  incr_top(L);
+  memset(u + 1, 0, size);
+  os.newpc = cast(int *, u + 1);
+  os.live = cast(RegSet *, os.newpc + os.n + 1);
+  os.use = os.live + os.n * os.nw;
+  os.def = os.use + os.n * os.nw;
+  os.pinned = os.def + os.n * os.nw;
+  os.out = os.pinned + os.nw;
+  os.flags = cast(lu_byte *, os.out + os.nw);
+  markcode(&os);
+  propagateconstants(&os);
+  computeliveness(&os);
+  removestores(&os);
+  threadjumps(&os);
+  removeunreachable(&os);
+  removejumps(&os);
+  compact(&os);
+  L->top--;
+}
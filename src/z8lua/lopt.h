@@ -0,0 +1,23 @@
+/*
+** Peephole optimizer for finished functions
+** See Copyright Notice in lua.h
+*/
+
+#ifndef lopt_h
+#define lopt_h
+
+#include "lparser.h"
+
+
+/*
+** Set to 0 to run functions exactly as lcode.c emits them (e.g. to compare
+** the output of both when touching the optimizer).
+*/
+#if !defined(LUA_USE_OPTIMIZER)
+#define LUA_USE_OPTIMIZER	1
+#endif
+
+
+LUAI_FUNC void luaK_optimize (FuncState *fs);
+
+#endif
@@ -20,6 +20,7 @@
 #include "lmem.h"
 #include "lobject.h"
 #include "lopcodes.h"
+#include "lopt.h"
 #include "lparser.h"
 #include "lstate.h"
 #include "lstring.h"
@@ -32,9 +33,18 @@
 #define MAXVARS		200
 
 
+/* initial size of the table of names and constants of a function */
+#define FUNCKEYS	8
+
+
 #define hasmultret(k)		((k) == VCALL || (k) == VVARARG)
 
 
+/* names are short strings but for very long ones, so mostly one object */
+#define eqname(a,b)	((a) == (b) || \
+                         ((a)->tsv.tt == LUA_TLNGSTR && luaS_eqstr(a, b)))
+
+
 
 /*
 ** nodes for block list (list of active blocks)
@@ -223,7 +233,7 @@ static int searchupvalue (FuncState *fs, TString *name) {
   int i;
   Upvaldesc *up = fs->f->upvalues;
   for (i = 0; i < fs->nups; i++) {
-    if (luaS_eqstr(up[i].name, name)) return i;
+    if (eqname(up[i].name, name)) return i;
   }
   return -1;  /* not found */
 }
@@ -247,7 +257,7 @@ static int newupvalue (FuncState *fs, TString *name, expdesc *v) {
 static int searchvar (FuncState *fs, TString *n) {
   int i;
   for (i = cast_int(fs->nactvar) - 1; i >= 0; i--) {
-    if (luaS_eqstr(n, getlocvar(fs, i)->varname))
+    if (eqname(n, getlocvar(fs, i)->varname))
       return i;
   }
   return -1;  /* not found */
@@ -549,6 +559,7 @@ static void open_func (LexState *ls, FuncState *fs, BlockCnt *bl) {
   /* anchor table of constants (to avoid being collected) */
   sethvalue2s(L, L->top, fs->h);
   incr_top(L);
+  luaH_resize(L, fs->h, 0, FUNCKEYS);  /* skip the first few rehashes */
   enterblock(fs, bl, 0);
 }
 
@@ -559,12 +570,18 @@ static void close_func (LexState *ls) {
   Proto *f = fs->f;
   luaK_ret(fs, 0, 0);  /* final return */
   leaveblock(fs);
+#if LUA_USE_OPTIMIZER
+  luaK_optimize(fs);
+#endif
   luaM_reallocvector(L, f->code, f->sizecode, fs->pc, Instruction);
   f->sizecode = fs->pc;
   luaM_reallocvector(L, f->lineinfo, f->sizelineinfo, fs->pc, int);
   f->sizelineinfo = fs->pc;
   luaM_reallocvector(L, f->k, f->sizek, fs->nk, TValue);
   f->sizek = fs->nk;
+  f->kslot = luaM_newvector(L, f->sizek, int);
+  if (f->sizek > 0)  /* no memset on a NULL vector */
+    memset(f->kslot, 0, f->sizek * sizeof(int));  /* any start is valid */
   luaM_reallocvector(L, f->p, f->sizep, fs->np, Proto *);
   f->sizep = fs->np;
   luaM_reallocvector(L, f->locvars, f->sizelocvars, fs->nlocvars, LocVar);
@@ -898,6 +915,26 @@ static void primaryexp (LexState *ls, expdesc *v) {
 }
 
 
+/*
+** Width of the global 'poke', 'poke2' or 'poke4' read by 'v', or 0 if
+** 'v' is anything else; calls of those with two arguments use OP_POKE.
+*/
+static int pokewidth (LexState *ls, expdesc *v) {
+  FuncState *fs = ls->fs;
+  const TValue *k;
+  const char *s;
+  if (v->k != VINDEXED || v->u.ind.vt != VUPVAL || !ISK(v->u.ind.idx) ||
+      fs->f->upvalues[v->u.ind.t].name != ls->envn)
+    return 0;
+  k = &fs->f->k[INDEXK(v->u.ind.idx)];
+  if (!ttisstring(k) || strncmp(svalue(k), "poke", 4) != 0)
+    return 0;
+  s = svalue(k) + 4;
+  if (s[0] == '\0') return 1;
+  return ((s[0] == '2' || s[0] == '4') && s[1] == '\0') ? s[0] - '0' : 0;
+}
+
+
 static void suffixedexp (LexState *ls, expdesc *v) {
   /* suffixedexp ->
        primaryexp { '.' NAME | '[' exp ']' | ':' NAME funcargs | funcargs } */
@@ -926,8 +963,13 @@ static void suffixedexp (LexState *ls, expdesc *v) {
         break;
       }
       case '(': case TK_STRING: case '{': {  /* funcargs */
+        int width = pokewidth(ls, v);
         luaK_exp2nextreg(fs, v);
         funcargs(ls, v, line);
+        if (width && GETARG_B(getcode(fs, v)) == 3) {  /* two arguments? */
+          SET_OPCODE(getcode(fs, v), OP_POKE);
+          SETARG_B(getcode(fs, v), width);
+        }
         break;
       }
       default: return;
@@ -1594,7 +1636,8 @@ static void retstat (LexState *ls) {
     nret = explist(ls, &e);  /* optional return values */
     if (hasmultret(e.k)) {
       luaK_setmultret(fs, &e);
-      if (e.k == VCALL && nret == 1) {  /* tail call? */
+      if (e.k == VCALL && nret == 1 &&  /* tail call? */
+          GET_OPCODE(getcode(fs,&e)) == OP_CALL) {
         SET_OPCODE(getcode(fs,&e), OP_TAILCALL);
         lua_assert(GETARG_A(getcode(fs,&e)) == fs->nactvar);
       }
@@ -239,6 +239,15 @@ static int pico8_rotr(lua_State* l) {
 	return 1;
 }
 
+/* write the low 16 bits of 'v' as four hex digits */
+static char* hex16(char* p, uint32_t v) {
+	int shift;
+	for (shift = 12; shift >= 0; shift -= 4) {
+		*p++ = "0123456789abcdef"[(v >> shift) & 0xf];
+	}
+	return p;
+}
+
 static int pico8_tostr(lua_State* l) {
 	char buffer[20];
 	char const* s = buffer;
@@ -261,56 +270,25 @@ static int pico8_tostr(lua_State* l) {
 		if (flags) {
 			uint32_t b = (uint32_t)x;
 			if ((flags & 0x3) == 0x3) {
-				sprintf(buffer, "0x%04x%04x", (b >> 16) & 0xffff, b & 0xffff);
+				char* p = buffer;
+				*p++ = '0'; *p++ = 'x';
+				p = hex16(hex16(p, b >> 16), b);
+				*p = '\0';
 			}
 			else if ((flags & 0x2) == 0x2) {
 				sprintf(buffer, "%d", b);
 			}
 			else {
-				sprintf(buffer, "0x%04x.%04x", (b >> 16) & 0xffff, b & 0xffff);
+				char* p = buffer;
+				*p++ = '0'; *p++ = 'x';
+				p = hex16(p, b >> 16);
+				*p++ = '.';
+				p = hex16(p, b);
+				*p = '\0';
 			}
 		}
 		else {
-			/* Pure-integer decimal formatter - avoids fix32_to_double.
-			 * PICO-8 tostr() format: [-]intpart[.fracpart], up to 4
-			 * decimal digits, no trailing zeros. */
-			char* p = buffer;
-			uint32_t bits = (uint32_t)x;
-			uint32_t int_part;
-			uint32_t frac16;
-			if (x < 0) {
-				*p++ = '-';
-				bits = (uint32_t)(-(int32_t)bits);
-			}
-			int_part = bits >> 16;
-			frac16 = bits & 0xffff;
-			/* Print integer part */
-			{
-				char tmp[8];
-				int len = 0;
-				uint32_t v = int_part;
-				if (v == 0) { tmp[len++] = '0'; }
-				else { while (v > 0) { tmp[len++] = (char)('0' + v % 10); v /= 10; } }
-				/* reverse digits */
-				{ int i, j; for (i = 0, j = len - 1; i < j; i++, j--) { char t = tmp[i]; tmp[i] = tmp[j]; tmp[j] = t; } }
-				{ int i; for (i = 0; i < len; i++) *p++ = tmp[i]; }
-			}
-			/* Print fractional part if non-zero */
-			if (frac16 != 0) {
-				uint32_t frac_dec = ((uint32_t)frac16 * 10000u + 32768u) >> 16;
-				if (frac_dec > 0) {
-					char fd[4];
-					int flen = 4;
-					fd[0] = (char)('0' + (frac_dec / 1000) % 10);
-					fd[1] = (char)('0' + (frac_dec / 100) % 10);
-					fd[2] = (char)('0' + (frac_dec / 10) % 10);
-					fd[3] = (char)('0' + (frac_dec) % 10);
-					while (flen > 1 && fd[flen - 1] == '0') flen--;
-					*p++ = '.';
-					{ int i; for (i = 0; i < flen; i++) *p++ = fd[i]; }
-				}
-			}
-			*p = '\0';
+			lua_number2str(buffer, x);
 		}
 		break;
 	}
@@ -392,11 +370,11 @@ static int pico8_ord(lua_State* l) {
 	char const* s = luaL_checklstring(l, 1, &len);
 	if (!lua_isnone(l, 3)) {
 		if (!lua_isnumber(l, 3)) return 0;
-		count = (int)lua_tonumber(l, 3);
+		count = fix32_to_int(lua_tonumber(l, 3));
 	}
 	if (!lua_isnone(l, 2)) {
 		if (!lua_isnumber(l, 2)) return 0;
-		n = (int)lua_tonumber(l, 2) - 1;
+		n = fix32_to_int(lua_tonumber(l, 2)) - 1;
 	}
 	if (n < 0 || (size_t)n >= len || count < 1) {
 		return 0;
@@ -406,7 +384,7 @@ static int pico8_ord(lua_State* l) {
 	}
 	lua_checkstack(l, count);
 	for (i = 0; i < count; ++i) {
-		lua_pushnumber(l, (uint8_t)s[n + i]);
+		lua_pushnumber(l, fix32_from_uint8((uint8_t)s[n + i]));
 	}
 	return count;
 }
@@ -494,5 +472,6 @@ static const luaL_Reg pico8lib[] = {
 LUAMOD_API int luaopen_pico8(lua_State* L) {
 	lua_pushglobaltable(L);
 	luaL_setfuncs(L, pico8lib, 0);
+	lua_setpico8ord(L, pico8_ord);
 	return 1;
 }
@@ -42,6 +42,24 @@
 #define MEMERRMSG	"not enough memory"
 
 
+/*
+** dead threads kept for reuse by 'lua_newthread', and the largest stack
+** worth keeping with them
+*/
+#if !defined(MAXTHREADCACHE)
+#define MAXTHREADCACHE	32
+#endif
+
+#define MAXCACHEDSTACK	(4*BASIC_STACK_SIZE)
+
+
+/*
+** CallInfo structures a thread keeps past its current one when the
+** collector shrinks it, so that the next calls need not allocate them
+*/
+#define SPARECI		8
+
+
 /*
 ** a macro to help the creation of a unique random seed when a state is
 ** created; the seed is used to randomize hashes.
@@ -80,8 +98,12 @@ typedef struct LG {
 /*
 ** Compute an initial seed as random as possible. In ANSI, rely on
 ** Address Space Layout Randomization (if present) to increase
-** randomness..
+** randomness.. Define LUAI_FIXEDSEED to use the same seed in every run
+** instead (e.g. to compare what two builds do with the same code).
 */
+#if defined(LUAI_FIXEDSEED)
+#define makeseed(L)	cast(unsigned int, LUAI_FIXEDSEED)
+#else
 #define addbuff(b,p,e) \
   { size_t t = cast(size_t, e); \
     memcpy(buff + p, &t, sizeof(t)); p += sizeof(t); }
@@ -97,6 +119,7 @@ static unsigned int makeseed (lua_State *L) {
   lua_assert(p == sizeof(buff));
   return luaS_hash(buff, p, h);
 }
+#endif
 
 
 /*
@@ -130,13 +153,25 @@ void luaE_freeCI (lua_State *L) {
 }
 
 
-static void stack_init (lua_State *L1, lua_State *L) {
+void luaE_shrinkCI (lua_State *L) {
+  CallInfo *ci = L->ci;
+  CallInfo *next;
+  int n;
+  for (n = 0; n < SPARECI && ci->next != NULL; n++)
+    ci = ci->next;
+  next = ci->next;
+  ci->next = NULL;
+  while ((ci = next) != NULL) {
+    next = ci->next;
+    luaM_free(L, ci);
+  }
+}
+
+
+static void stack_reset (lua_State *L1) {
   int i; CallInfo *ci;
-  /* initialize stack array */
-  L1->stack = luaM_newvector(L, BASIC_STACK_SIZE, TValue);
-  L1->stacksize = BASIC_STACK_SIZE;
-  for (i = 0; i < BASIC_STACK_SIZE; i++)
-    setnilvalue(L1->stack + i);  /* erase new stack */
+  for (i = 0; i < L1->stacksize; i++)
+    setnilvalue(L1->stack + i);  /* erase stack */
   L1->top = L1->stack;
   L1->stack_last = L1->stack + L1->stacksize - EXTRA_STACK;
   /* initialize first ci */
@@ -150,6 +185,14 @@ static void stack_init (lua_State *L1, lua_State *L) {
 }
 
 
+static void stack_init (lua_State *L1, lua_State *L) {
+  /* initialize stack array */
+  L1->stack = luaM_newvector(L, BASIC_STACK_SIZE, TValue);
+  L1->stacksize = BASIC_STACK_SIZE;
+  stack_reset(L1);
+}
+
+
 static void freestack (lua_State *L) {
   if (L->stack == NULL)
     return;  /* stack not completely built yet */
@@ -229,40 +272,106 @@ static void close_state (lua_State *L) {
   luaM_freearray(L, G(L)->strt.hash, G(L)->strt.size);
   luaZ_freebuffer(L, &g->buff);
   freestack(L);
+  luaE_freethreadcache(L);
   lua_assert(gettotalbytes(g) == sizeof(LG));
   (*g->frealloc)(g->ud, fromstate(L), sizeof(LG), 0);  /* free main block */
 }
 
 
+/*
+** memory held by a cached thread; the collector counts it as freed while
+** the thread sits in the cache
+*/
+static l_mem cachedsize (lua_State *L1) {
+  l_mem size = sizeof(LX) + sizeof(TValue) * L1->stacksize;
+  CallInfo *ci;
+  for (ci = L1->base_ci.next; ci != NULL; ci = ci->next)
+    size += sizeof(CallInfo);
+  return size;
+}
+
+
 LUA_API lua_State *lua_newthread (lua_State *L) {
+  global_State *g = G(L);
   lua_State *L1;
   lua_lock(L);
   luaC_checkGC(L);
-  L1 = &luaC_newobj(L, LUA_TTHREAD, sizeof(LX), NULL, offsetof(LX, l))->th;
+  if (g->threadcache != NULL) {  /* reuse a dead thread and its stack */
+    GCObject *o = g->threadcache;
+    StkId stack;
+    int stacksize;
+    CallInfo *ci;
+    g->threadcache = gch(o)->next;
+    g->nthreadcache--;
+    gch(o)->marked = luaC_white(g);  /* link it like 'luaC_newobj' does */
+    gch(o)->next = g->allgc;
+    g->allgc = o;
+    L1 = gco2th(o);
+    stack = L1->stack;
+    stacksize = L1->stacksize;
+    ci = L1->base_ci.next;
+    g->GCdebt += cachedsize(L1);
+    preinit_state(L1, g);
+    L1->stack = stack;
+    L1->stacksize = stacksize;
+    stack_reset(L1);
+    L1->base_ci.next = ci;
+  }
+  else {
+    L1 = &luaC_newobj(L, LUA_TTHREAD, sizeof(LX), NULL, offsetof(LX, l))->th;
+    preinit_state(L1, g);
+  }
   setthvalue(L, L->top, L1);
   api_incr_top(L);
-  preinit_state(L1, G(L));
   L1->hookmask = L->hookmask;
   L1->basehookcount = L->basehookcount;
   L1->hook = L->hook;
   resethookcount(L1);
   luai_userstatethread(L, L1);
-  stack_init(L1, L);  /* init stack */
+  if (L1->stack == NULL)
+    stack_init(L1, L);  /* init stack */
   lua_unlock(L);
   return L1;
 }
 
 
 void luaE_freethread (lua_State *L, lua_State *L1) {
+  global_State *g = G(L);
   LX *l = fromstate(L1);
   luaF_close(L1, L1->stack);  /* close all upvalues for this thread */
   lua_assert(L1->openupval == NULL);
   luai_userstatefree(L, L1);
+  if (L1->stack != NULL && L1->stacksize <= MAXCACHEDSTACK &&
+      g->nthreadcache < MAXTHREADCACHE) {
+    /* keep it, its stack and its 'ci' list for the next 'lua_newthread' */
+    g->GCdebt -= cachedsize(L1);
+    gch(obj2gco(L1))->next = g->threadcache;
+    g->threadcache = obj2gco(L1);
+    g->nthreadcache++;
+    return;
+  }
   freestack(L1);
   luaM_free(L, l);
 }
 
 
+/*
+** free the threads kept for reuse (when closing the state or running
+** short of memory)
+*/
+void luaE_freethreadcache (lua_State *L) {
+  global_State *g = G(L);
+  while (g->threadcache != NULL) {
+    lua_State *L1 = gco2th(g->threadcache);
+    g->threadcache = gch(g->threadcache)->next;
+    g->GCdebt += cachedsize(L1);
+    freestack(L1);
+    luaM_free(L, fromstate(L1));
+  }
+  g->nthreadcache = 0;
+}
+
+
 LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   int i;
   lua_State *L;
@@ -292,17 +401,24 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->uvhead.u.l.next = &g->uvhead;
   g->gcrunning = 0;  /* no GC while building state */
   g->GCestimate = 0;
+  g->GCwork = 0;
   g->strt.size = 0;
   g->strt.nuse = 0;
   g->strt.hash = NULL;
   setnilvalue(&g->l_registry);
   luaZ_initbuffer(L, &g->buff);
+  g->lastcat = NULL;
   g->panic = NULL;
+  g->pico8memory = NULL;
+  for (i=0; i < 3; i++) g->pico8poke[i] = NULL;
+  g->pico8sub = g->pico8ord = NULL;
   g->version = NULL;
   g->gcstate = GCSpause;
   g->allgc = NULL;
   g->finobj = NULL;
   g->tobefnz = NULL;
+  g->threadcache = NULL;
+  g->nthreadcache = 0;
   g->sweepgc = g->sweepfin = NULL;
   g->gray = g->grayagain = NULL;
   g->weak = g->ephemeron = g->allweak = NULL;
@@ -312,6 +428,7 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->gcmajorinc = LUAI_GCMAJOR;
   g->gcstepmul = LUAI_GCMUL;
   for (i=0; i < LUA_NUMTAGS; i++) g->mt[i] = NULL;
+  for (i=0; i <= UCHAR_MAX; i++) g->onechar[i] = NULL;
   if (luaD_rawrunprotected(L, f_luaopen, NULL) != LUA_OK) {
     /* memory allocation error: free partial state */
     close_state(L);
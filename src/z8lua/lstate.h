@@ -116,6 +116,7 @@ typedef struct global_State {
   l_mem GCdebt;  /* bytes allocated not yet compensated by the collector */
   lu_mem GCmemtrav;  /* memory traversed by the GC */
   lu_mem GCestimate;  /* an estimate of the non-garbage memory in use */
+  lu_mem GCwork;  /* total work done by the collector */
   stringtable strt;  /* hash table for strings */
   TValue l_registry;
   unsigned int seed;  /* randomized seed for hashes */
@@ -134,17 +135,24 @@ typedef struct global_State {
   GCObject *ephemeron;  /* list of ephemeron tables (weak keys) */
   GCObject *allweak;  /* list of all-weak tables */
   GCObject *tobefnz;  /* list of userdata to be GC */
+  GCObject *threadcache;  /* dead threads kept for reuse, with their stacks */
+  int nthreadcache;  /* number of threads in 'threadcache' */
   UpVal uvhead;  /* head of double-linked list of all open upvalues */
   Mbuffer buff;  /* temporary buffer for string concatenation */
+  TString *lastcat;  /* last OP_CONCAT result, while only the stack has it */
   int gcpause;  /* size of pause between successive GCs */
   int gcmajorinc;  /* pause between major collections (only in gen. mode) */
   int gcstepmul;  /* GC `granularity' */
   lua_CFunction panic;  /* to be called in unprotected errors */
-  lu_byte const *pico8memory;  /* pointer to PICO-8 RAM */
+  lu_byte *pico8memory;  /* pointer to PICO-8 RAM */
+  lua_CFunction pico8poke[3];  /* builtin poke, poke2 and poke4 */
+  lua_CFunction pico8sub;  /* builtin sub */
+  lua_CFunction pico8ord;  /* builtin ord */
   struct lua_State *mainthread;
   const lua_Number *version;  /* pointer to version number */
   TString *memerrmsg;  /* memory-error message */
   TString *tmname[TM_N];  /* array with tag-method names */
+  TString *onechar[UCHAR_MAX + 1];  /* one-byte strings, made on first use */
   struct Table *mt[LUA_NUMTAGS];  /* metatables for basic types */
 } global_State;
 
@@ -221,8 +229,10 @@ union GCObject {
 
 LUAI_FUNC void luaE_setdebt (global_State *g, l_mem debt);
 LUAI_FUNC void luaE_freethread (lua_State *L, lua_State *L1);
+LUAI_FUNC void luaE_freethreadcache (lua_State *L);
 LUAI_FUNC CallInfo *luaE_extendCI (lua_State *L);
 LUAI_FUNC void luaE_freeCI (lua_State *L);
+LUAI_FUNC void luaE_shrinkCI (lua_State *L);
 
 
 #endif
@@ -150,16 +150,85 @@ static TString *internshrstr (lua_State *L, const char *str, size_t l) {
 }
 
 
+/*
+** new long string of length 'l'; the caller copies the contents in
+** before anything can see the string
+*/
+TString *luaS_newlngstr (lua_State *L, size_t l) {
+  TString *ts;
+  lua_assert(l > LUAI_MAXSHORTLEN);
+  if (l + 1 > (MAX_SIZET - sizeof(TString))/sizeof(char))
+    luaM_toobig(L);
+  ts = &luaC_newobj(L, LUA_TLNGSTR, sizeof(TString) + ((l + 1) * sizeof(char)),
+                    NULL, 0)->ts;
+  ts->tsv.len = l;
+  ts->tsv.hash = G(L)->seed;
+  ts->tsv.extra = 0;
+  ((char *)(ts+1))[l] = '\0';  /* ending 0 */
+  return ts;
+}
+
+
+/*
+** new long string of length 'l' with room to grow in place to about
+** twice that length; the caller copies the contents in
+*/
+TString *luaS_newlngbuf (lua_State *L, size_t l) {
+  TString *ts;
+  size_t room;
+  if (l >= (MAX_SIZET - sizeof(TString) - sizeof(size_t)) / 2)
+    return luaS_newlngstr(L, l);  /* too long to double */
+  room = 2 * (l + 1) + sizeof(size_t);
+  ts = &luaC_newobj(L, LUA_TLNGSTR, sizeof(TString) + room, NULL, 0)->ts;
+  luaS_setroom(L, ts, l, room);
+  return ts;
+}
+
+
+/*
+** size of the block of a string with room past its header
+*/
+size_t luaS_room (TString *ts) {
+  size_t room;
+  lua_assert(ts->tsv.extra & LNGSTR_ROOM);
+  memcpy(&room, getstr(ts) + ts->tsv.len + 1, sizeof(room));
+  return room;
+}
+
+
+/*
+** sets the length of a string with room after its contents changed in
+** place; a hash it had is no longer valid
+*/
+void luaS_setroom (lua_State *L, TString *ts, size_t l, size_t room) {
+  char *s = cast(char *, getstr(ts));
+  lua_assert(l + 1 + sizeof(room) <= room);
+  ts->tsv.len = l;
+  ts->tsv.hash = G(L)->seed;
+  ts->tsv.extra = LNGSTR_ROOM;
+  s[l] = '\0';  /* ending 0 */
+  memcpy(s + l + 1, &room, sizeof(room));  /* unaligned */
+}
+
+
 /*
 ** new string (with explicit length)
 */
 TString *luaS_newlstr (lua_State *L, const char *str, size_t l) {
-  if (l <= LUAI_MAXSHORTLEN)  /* short string? */
+  if (l == 1) {  /* one-byte strings are kept at hand once made */
+    TString **ts = &G(L)->onechar[cast_byte(*str)];
+    if (*ts == NULL) {
+      *ts = internshrstr(L, str, 1);
+      luaS_fix(*ts);  /* never collect them */
+    }
+    return *ts;
+  }
+  else if (l <= LUAI_MAXSHORTLEN)  /* short string? */
     return internshrstr(L, str, l);
   else {
-    if (l + 1 > (MAX_SIZET - sizeof(TString))/sizeof(char))
-      luaM_toobig(L);
-    return createstrobj(L, str, l, LUA_TLNGSTR, G(L)->seed, NULL);
+    TString *ts = luaS_newlngstr(L, l);
+    memcpy(ts+1, str, l*sizeof(char));
+    return ts;
   }
 }
 
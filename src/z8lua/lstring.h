@@ -14,6 +14,26 @@
 
 #define sizestring(s)	(sizeof(union TString)+((s)->len+1)*sizeof(char))
 
+/*
+** bits of 'extra' in long strings; one with room to be appended to in
+** place (see luaV_concat) keeps the size of its block past the header
+** right after its ending 0
+*/
+#define LNGSTR_HASHED	1
+#define LNGSTR_ROOM	2
+
+#define sizelngstr(s)	((s)->extra & LNGSTR_ROOM ? \
+                           sizeof(union TString) + luaS_room(cast(TString *, (s))) : \
+                           sizestring(s))
+
+/*
+** the last concatenation result can't be appended to in place anymore
+** once 'o' holds it outside the stack
+*/
+#define luaS_escape(L,o) \
+  { if (ttislngstring(o) && rawtsvalue(o) == G(L)->lastcat) \
+      G(L)->lastcat = NULL; }
+
 #define sizeudata(u)	(sizeof(union Udata)+(u)->len)
 
 #define luaS_newliteral(L, s)	(luaS_newlstr(L, "" s, \
@@ -38,8 +58,12 @@ LUAI_FUNC unsigned int luaS_hash (const char *str, size_t l, unsigned int seed);
 LUAI_FUNC int luaS_eqlngstr (TString *a, TString *b);
 LUAI_FUNC int luaS_eqstr (TString *a, TString *b);
 LUAI_FUNC void luaS_resize (lua_State *L, int newsize);
+LUAI_FUNC size_t luaS_room (TString *ts);
+LUAI_FUNC void luaS_setroom (lua_State *L, TString *ts, size_t l, size_t room);
 LUAI_FUNC Udata *luaS_newudata (lua_State *L, size_t s, Table *e);
 LUAI_FUNC TString *luaS_newlstr (lua_State *L, const char *str, size_t l);
+LUAI_FUNC TString *luaS_newlngstr (lua_State *L, size_t l);
+LUAI_FUNC TString *luaS_newlngbuf (lua_State *L, size_t l);
 LUAI_FUNC TString *luaS_new (lua_State *L, const char *str);
 
 
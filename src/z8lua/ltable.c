@@ -100,9 +100,9 @@ static Node *mainposition (const Table *t, const TValue *key) {
       return hashnum(t, nvalue(key));
     case LUA_TLNGSTR: {
       TString *s = rawtsvalue(key);
-      if (s->tsv.extra == 0) {  /* no hash? */
+      if (!(s->tsv.extra & LNGSTR_HASHED)) {  /* no hash? */
         s->tsv.hash = luaS_hash(getstr(s), s->tsv.len, s->tsv.hash);
-        s->tsv.extra = 1;  /* now it has its hash */
+        s->tsv.extra |= LNGSTR_HASHED;  /* now it has its hash */
       }
       return hashstr(t, rawtsvalue(key));
     }
@@ -114,6 +114,8 @@ static Node *mainposition (const Table *t, const TValue *key) {
       return hashpointer(t, pvalue(key));
     case LUA_TLCF:
       return hashpointer(t, fvalue(key));
+    case LUA_TFCF:
+      return hashpointer(t, fcfvalue(key));
     default:
       return hashpointer(t, gcvalue(key));
   }
@@ -169,7 +171,7 @@ int luaH_next (lua_State *L, Table *t, StkId key) {
   int i = findindex(L, t, key);  /* find original element */
   for (i++; i < t->sizearray; i++) {  /* try first array part */
     if (!ttisnil(&t->array[i])) {  /* a non-nil value? */
-      setnvalue(key, cast_num(i+1));
+      setnvalue(key, fix32_from_int(i+1));
       setobj2s(L, key+1, &t->array[i]);
       return 1;
     }
@@ -447,7 +449,7 @@ const TValue *luaH_getint (Table *t, int key) {
   if (cast(unsigned int, key-1) < cast(unsigned int, t->sizearray))
     return &t->array[key-1];
   else {
-    lua_Number nk = cast_num(key);
+    lua_Number nk = fix32_from_int(key);
     Node *n = hashnum(t, nk);
     do {  /* check whether `key' is somewhere in the chain */
       if (ttisnumber(gkey(n)) && luai_numeq((lua_Number)nvalue(gkey(n)), nk))
@@ -520,7 +522,7 @@ void luaH_setint (lua_State *L, Table *t, int key, TValue *value) {
     cell = cast(TValue *, p);
   else {
     TValue k;
-    setnvalue(&k, cast_num(key));
+    setnvalue(&k, fix32_from_int(key));
     cell = luaH_newkey(L, t, &k);
   }
   setobj2t(L, cell, value);
@@ -574,6 +576,93 @@ int luaH_getn (Table *t) {
 }
 
 
+/*
+** {=============================================================
+** Sequence operations for PICO-8's add(), del() and count(). Each one
+** takes the border once; while the whole sequence 1..n lives in the
+** array part it works on the TValues directly, otherwise (holes that
+** end the array part early, keys in the hash part) it goes through
+** luaH_getint/luaH_setint like the generic code would.
+** ==============================================================
+*/
+
+/*
+** t[n+1] = v for the border n; returns n+1. The caller must run the
+** GC barrier.
+*/
+int luaH_append (lua_State *L, Table *t, const TValue *v) {
+  int n = luaH_getn(t) + 1;
+  if (n <= t->sizearray) {
+    setobj2t(L, &t->array[n - 1], v);
+  }
+  else {
+    TValue k;
+    setobj2t(L, &k, v);  /* 'v' may live in 't' */
+    luaH_setint(L, t, n, &k);
+  }
+  return n;
+}
+
+
+/*
+** Removes the first element of the sequence that is raw equal to 'v',
+** moving the elements after it down by one. Returns the index it had,
+** or 0 if there was none.
+*/
+int luaH_remove (lua_State *L, Table *t, const TValue *v) {
+  int n = luaH_getn(t);
+  int i;
+  if (n <= t->sizearray) {
+    TValue *a = t->array;
+    for (i = 0; i < n; i++) {
+      if (luaV_rawequalobj(&a[i], v)) {
+        memmove(&a[i], &a[i + 1], (n - 1 - i) * sizeof(TValue));
+        setnilvalue(&a[n - 1]);
+        return i + 1;
+      }
+    }
+    return 0;
+  }
+  for (i = 1; i <= n; i++) {
+    if (luaV_rawequalobj(luaH_getint(t, i), v)) {
+      int j;
+      TValue next;
+      for (j = i; j < n; j++) {
+        setobj2t(L, &next, luaH_getint(t, j + 1));
+        luaH_setint(L, t, j, &next);
+      }
+      setnilvalue(&next);
+      luaH_setint(L, t, n, &next);
+      return i;
+    }
+  }
+  return 0;
+}
+
+
+/*
+** Number of elements of the sequence that are raw equal to 'v'.
+*/
+int luaH_count (Table *t, const TValue *v) {
+  int n = luaH_getn(t);
+  int i, c = 0;
+  if (n <= t->sizearray) {
+    for (i = 0; i < n; i++)
+      c += luaV_rawequalobj(&t->array[i], v);
+  }
+  else {
+    for (i = 1; i <= n; i++)
+      c += luaV_rawequalobj(luaH_getint(t, i), v);
+  }
+  return c;
+}
+
+/* }============================================================= */
+
+
+
+int luaH_isdummy (Node *n) { return isdummy(n); }
+
 
 #if defined(LUA_DEBUG)
 
@@ -581,6 +670,4 @@ Node *luaH_mainposition (const Table *t, const TValue *key) {
   return mainposition(t, key);
 }
 
-int luaH_isdummy (Node *n) { return isdummy(n); }
-
 #endif
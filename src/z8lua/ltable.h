@@ -34,11 +34,14 @@ LUAI_FUNC void luaH_resizearray (lua_State *L, Table *t, int nasize);
 LUAI_FUNC void luaH_free (lua_State *L, Table *t);
 LUAI_FUNC int luaH_next (lua_State *L, Table *t, StkId key);
 LUAI_FUNC int luaH_getn (Table *t);
+LUAI_FUNC int luaH_append (lua_State *L, Table *t, const TValue *v);
+LUAI_FUNC int luaH_remove (lua_State *L, Table *t, const TValue *v);
+LUAI_FUNC int luaH_count (Table *t, const TValue *v);
+LUAI_FUNC int luaH_isdummy (Node *n);
 
 
 #if defined(LUA_DEBUG)
 LUAI_FUNC Node *luaH_mainposition (const Table *t, const TValue *key);
-LUAI_FUNC int luaH_isdummy (Node *n);
 #endif
 
 
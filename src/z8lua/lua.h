@@ -110,6 +110,27 @@ typedef LUA_INTEGER lua_Integer;
 typedef LUA_UNSIGNED lua_Unsigned;
 
 
+/*
+** Type for builtins that the VM may call directly, without a CallInfo,
+** when all the arguments are numbers (see lua_pushfastcfunction).  It
+** returns one of the LUA_FAST* codes below and leaves the result in 'res'.
+*/
+typedef int (*lua_FastCFunction) (const lua_Number *args, int nargs,
+                                  lua_Number *res);
+
+typedef struct lua_FastReg {
+  lua_CFunction f;  /* used for any other call */
+  lua_FastCFunction ff;
+  int minargs;  /* calls with fewer arguments go through 'f' */
+} lua_FastReg;
+
+#define LUA_FASTNONE	0	/* no result */
+#define LUA_FASTNUMBER	1	/* '*res' is the result */
+#define LUA_FASTBOOLEAN	2	/* the result is '*res != 0' */
+
+#define LUA_FASTMAXARGS	8
+
+
 
 /*
 ** generic extra include file
@@ -225,6 +246,7 @@ LUA_API const char *(lua_pushvfstring) (lua_State *L, const char *fmt,
                                                       va_list argp);
 LUA_API const char *(lua_pushfstring) (lua_State *L, const char *fmt, ...);
 LUA_API void  (lua_pushcclosure) (lua_State *L, lua_CFunction fn, int n);
+LUA_API void  (lua_pushfastcfunction) (lua_State *L, const lua_FastReg *r);
 LUA_API void  (lua_pushboolean) (lua_State *L, int b);
 LUA_API void  (lua_pushlightuserdata) (lua_State *L, void *p);
 LUA_API int   (lua_pushthread) (lua_State *L);
@@ -254,10 +276,25 @@ LUA_API void  (lua_setfield) (lua_State *L, int idx, const char *k);
 LUA_API void  (lua_rawset) (lua_State *L, int idx);
 LUA_API void  (lua_rawseti) (lua_State *L, int idx, int n);
 LUA_API void  (lua_rawsetp) (lua_State *L, int idx, const void *p);
+LUA_API int   (lua_rawappend) (lua_State *L, int idx);
+LUA_API int   (lua_rawremove) (lua_State *L, int idx);
+LUA_API int   (lua_rawcount) (lua_State *L, int idx);
 LUA_API int   (lua_setmetatable) (lua_State *L, int objindex);
 LUA_API void  (lua_setuservalue) (lua_State *L, int idx);
 
-LUA_API void  (lua_setpico8memory) (lua_State *L, unsigned char const *p);
+LUA_API void  (lua_setpico8memory) (lua_State *L, unsigned char *p);
+LUA_API void  (lua_setpico8poke) (lua_State *L, int size, lua_CFunction f);
+LUA_API void  (lua_setpico8sub) (lua_State *L, lua_CFunction f);
+LUA_API void  (lua_setpico8ord) (lua_State *L, lua_CFunction f);
+
+/*
+** heap census: number of live objects and their bytes, indexed by type
+** (LUA_TSTRING, LUA_TTABLE, ...); the two extra slots hold function
+** prototypes and closed upvalues
+*/
+#define LUA_NUMCENSUS	(LUA_NUMTAGS+2)
+
+LUA_API void  (lua_census) (lua_State *L, size_t *count, size_t *bytes);
 
 /*
 ** 'load' and 'call' functions (load and run Lua code)
@@ -304,6 +341,7 @@ LUA_API int  (lua_status) (lua_State *L);
 #define LUA_GCISRUNNING		9
 #define LUA_GCGEN		10
 #define LUA_GCINC		11
+#define LUA_GCWORK		12
 
 LUA_API int (lua_gc) (lua_State *L, int what, int data);
 
@@ -562,6 +562,7 @@
 #undef lua_str2number
 
 LUAI_FUNC int lua_number2str(char* s, fix32_t n);
+LUAI_FUNC int lua_string2number(const char* s, size_t len, fix32_t* n);
 
 #define lua_str2number fix32_from_string
 
@@ -13,6 +13,7 @@
 
 
 LUAMOD_API int (luaopen_base) (lua_State *L);
+LUAMOD_API int (luaopen_cartbase) (lua_State *L);
 
 LUAMOD_API int (luaopen_pico8) (lua_State *L);
 
@@ -47,6 +48,9 @@ LUAMOD_API int (luaopen_package) (lua_State *L);
 /* open all previous libraries */
 LUALIB_API void (luaL_openlibs) (lua_State *L);
 
+/* open only what carts can see, in a global table with room for 'n' */
+LUALIB_API void (luaL_opencartlibs) (lua_State *L, int n);
+
 
 
 #if !defined(lua_assert)
@@ -100,6 +100,8 @@ static void LoadConstants(LoadState* S, Proto* f)
  f->k=luaM_newvector(S->L,n,TValue);
  f->sizek=n;
  for (i=0; i<n; i++) setnilvalue(&f->k[i]);
+ f->kslot=luaM_newvector(S->L,n,int);
+ if (n>0) memset(f->kslot,0,n*sizeof(int));
  for (i=0; i<n; i++)
  {
   TValue* o=&f->k[i];
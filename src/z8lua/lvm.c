@@ -146,8 +146,60 @@ void luaV_gettable (lua_State *L, const TValue *t, TValue *key, StkId val) {
 }
 
 
+/*
+** Inline cache for constant string keys: 'slot' is the node where the
+** key was found last time.  A hit needs that node to still hold the key
+** with a non-nil value, so rehashes and removals need no invalidation,
+** and absent keys always go through the metatable.
+*/
+static const TValue *getslot (Table *h, const TValue *key, int *slot) {
+  const TValue *res;
+  if (*slot < sizenode(h)) {
+    Node *n = gnode(h, *slot);
+    if (ttisshrstring(gkey(n)) && rawtsvalue(gkey(n)) == rawtsvalue(key) &&
+        !ttisnil(gval(n)))
+      return gval(n);
+  }
+  res = luaH_getstr(h, rawtsvalue(key));
+  if (!ttisnil(res))
+    *slot = cast_int(cast(Node *, cast(char *, res) -
+                                  offsetof(Node, i_val)) - h->node);
+  return res;
+}
+
+
+/*
+** luaV_gettable for a constant key, once the check done by 'gettablek'
+** in the interpreter loop failed.  The slot follows the key into
+** __index tables, which is where methods are found.
+*/
+void luaV_gettablek (lua_State *L, const TValue *t, TValue *key, StkId val,
+                     int *slot) {
+  int loop;
+  for (loop = 0; loop < MAXTAGLOOP && ttistable(t) && ttisshrstring(key);
+       loop++) {
+    Table *h = hvalue(t);
+    const TValue *res = getslot(h, key, slot);
+    const TValue *tm;
+    if (!ttisnil(res) ||  /* result is not nil? */
+        (tm = fasttm(L, h->metatable, TM_INDEX)) == NULL) { /* or no TM? */
+      setobj2s(L, val, res);
+      return;
+    }
+    if (ttisfunction(tm)) {
+      callTM(L, tm, t, key, val, 1);
+      return;
+    }
+    t = tm;  /* else repeat with 'tm' */
+  }
+  luaV_gettable(L, t, key, val);
+}
+
+
 void luaV_settable (lua_State *L, const TValue *t, TValue *key, StkId val) {
   int loop;
+  luaS_escape(L, key);
+  luaS_escape(L, val);
   for (loop = 0; loop < MAXTAGLOOP; loop++) {
     const TValue *tm;
     if (ttistable(t)) {  /* `t' is a table? */
@@ -230,7 +282,7 @@ static lua_Number lua_Number_from_bits(uint64_t bits) {
 lua_Number luaV_peek(struct lua_State *L, lua_Number a, int count)
 {
   unsigned char const *p = G(L)->pico8memory;
-  int address = (int)(a) & 0x7fff;
+  int address = fix32_to_int(a) & 0x7fff;
   uint32_t ret = 0;
   switch (count) {
     case 4:
@@ -307,6 +359,7 @@ int luaV_equalobj_ (lua_State *L, const TValue *t1, const TValue *t2) {
     case LUA_TBOOLEAN: return bvalue(t1) == bvalue(t2);  /* true must be 1 !! */
     case LUA_TLIGHTUSERDATA: return pvalue(t1) == pvalue(t2);
     case LUA_TLCF: return fvalue(t1) == fvalue(t2);
+    case LUA_TFCF: return fcfvalue(t1) == fcfvalue(t2);
     case LUA_TSHRSTR: return eqshrstr(rawtsvalue(t1), rawtsvalue(t2));
     case LUA_TLNGSTR: return luaS_eqlngstr(rawtsvalue(t1), rawtsvalue(t2));
     case LUA_TUSERDATA: {
@@ -331,41 +384,115 @@ int luaV_equalobj_ (lua_State *L, const TValue *t1, const TValue *t2) {
 }
 
 
-void luaV_concat (lua_State *L, int total) {
+/* values that concatenate as strings; numbers are written out as such */
+#define concatable(o)	(ttisstring(o) || ttisnumber(o))
+
+
+/*
+** Length of 'o' as concatenated, with numbers written to 's'
+*/
+static size_t concatpart (const TValue *o, char *s, const char **p) {
+  if (ttisstring(o)) {
+    *p = svalue(o);
+    return tsvalue(o)->len;
+  }
+  *p = s;
+  return cast(size_t, lua_number2str(s, nvalue(o)));
+}
+
+
+/*
+** Whether the last concatenation result, as left operand 'left', can be
+** appended to in place: the stack must hold it nowhere else but in 'ra',
+** about to be overwritten with the result.  Anything that keeps it off
+** the stack forgets it (see luaS_escape); what stays on the stack is
+** below 'left', as the operands are the topmost temporaries.
+*/
+static int appendable (lua_State *L, StkId left, StkId ra) {
+  TString *s = G(L)->lastcat;
+  StkId o;
+  if (s == NULL || !ttislngstring(left) || rawtsvalue(left) != s)
+    return 0;
+  for (o = L->stack; o < left; o++) {
+    if (o != ra && ttislngstring(o) && rawtsvalue(o) == s)
+      return 0;
+  }
+  return 1;
+}
+
+
+/*
+** 'a' is the register OP_CONCAT puts the result in, or -1; with it, a
+** long result is remembered, and its next concatenation with itself as
+** the left operand (as in 's = s .. x') appends to it in place when it
+** has room, or makes a result with room to spare.
+*/
+void luaV_concat (lua_State *L, int total, int a) {
   lua_assert(total >= 2);
   do {
     StkId top = L->top;
     int n = 2;  /* number of elements handled in this pass (at least 2) */
-    if (!(ttisstring(top-2) || ttisnumber(top-2)) || !tostring(L, top-1)) {
+    if (!concatable(top-2) || !concatable(top-1)) {
       if (!call_binTM(L, top-2, top-1, top-2, TM_CONCAT))
         luaG_concaterror(L, top-2, top-1);
     }
-    else if (tsvalue(top-1)->len == 0)  /* second operand is empty? */
+    else if (ttisstring(top-1) && tsvalue(top-1)->len == 0)  /* second operand is empty? */
       (void)tostring(L, top - 2);  /* result is first operand */
     else if (ttisstring(top-2) && tsvalue(top-2)->len == 0) {
+      (void)tostring(L, top - 1);
       setobjs2s(L, top - 2, top - 1);  /* result is second op. */
     }
     else {
-      /* at least two non-empty string values; get as many as possible */
-      size_t tl = tsvalue(top-1)->len;
+      /* at least two non-empty values; get as many as possible.  Numbers
+         are written straight into the result, not made into strings */
+      char num[LUAI_MAXNUMBER2STR];
+      const char *p;
+      size_t tl = 0;
+      size_t room = 0;  /* room of a string appended to in place */
+      TString *ts = NULL;
       char *buffer;
       int i;
       /* collect total length */
-      for (i = 1; i < total && tostring(L, top-i-1); i++) {
-        size_t l = tsvalue(top-i-1)->len;
+      for (i = 0; i < total && concatable(top-i-1); i++) {
+        size_t l = concatpart(top-i-1, num, &p);
         if (l >= (MAX_SIZET/sizeof(char)) - tl)
           luaG_runerror(L, "string length overflow");
         tl += l;
       }
-      buffer = luaZ_openspace(L, &G(L)->buff, tl);
-      tl = 0;
       n = i;
+      if (tl > LUAI_MAXSHORTLEN) {  /* long strings are not interned */
+        /* so copy the parts right into it */
+        if (a >= 0 && n == total && appendable(L, top-n, L->ci->u.l.base + a)) {
+          ts = rawtsvalue(top-n);
+          if ((ts->tsv.extra & LNGSTR_ROOM) &&
+              tl + 1 + sizeof(size_t) <= luaS_room(ts))
+            room = luaS_room(ts);  /* first part is in place already */
+          else
+            ts = luaS_newlngbuf(L, tl);
+        }
+        else
+          ts = luaS_newlngstr(L, tl);
+        buffer = cast(char *, getstr(ts));
+      }
+      else
+        buffer = luaZ_openspace(L, &G(L)->buff, tl);
+      tl = 0;
+      if (room > 0)
+        tl = tsvalue(top - i--)->len;
       do {  /* concat all strings */
-        size_t l = tsvalue(top-i)->len;
-        memcpy(buffer+tl, svalue(top-i), l * sizeof(char));
+        size_t l = concatpart(top-i, num, &p);
+        memcpy(buffer+tl, p, l * sizeof(char));
         tl += l;
       } while (--i > 0);
-      setsvalue2s(L, top-n, luaS_newlstr(L, buffer, tl));
+      if (ts == NULL)
+        ts = luaS_newlstr(L, buffer, tl);
+      else {
+        if (room > 0)
+          luaS_setroom(L, ts, tl, room);
+        if (a >= 0)
+          G(L)->lastcat = ts;
+      }
+      setsvalue2s(L, top-n, ts);
     }
     total -= n-1;  /* got 'n' strings to create 1 new */
     L->top -= n-1;  /* popped 'n' strings and pushed one */
@@ -458,6 +585,137 @@ static void pushclosure (lua_State *L, Proto *p, UpVal **encup, StkId base,
 }
 
 
+/*
+** Calls a fast C function straight from OP_CALL, with no CallInfo, if
+** all its 'nargs' arguments are numbers.  Returns 0 when the call must
+** go through luaD_precall instead.
+*/
+static int fastcall (lua_State *L, StkId func, int nargs, int nresults) {
+  const lua_FastReg *r = fcfvalue(func);
+  lua_Number args[LUA_FASTMAXARGS];
+  lua_Number res;
+  int i, n;
+  if (nargs < r->minargs || nargs > LUA_FASTMAXARGS ||
+      (L->hookmask & (LUA_MASKCALL | LUA_MASKRET)))
+    return 0;
+  for (i = 0; i < nargs; i++) {
+    if (!ttisnumber(func + 1 + i)) return 0;
+    args[i] = nvalue(func + 1 + i);
+  }
+  switch ((*r->ff)(args, nargs, &res)) {
+    case LUA_FASTNUMBER: setnvalue(func, res); n = 1; break;
+    case LUA_FASTBOOLEAN: setbvalue(func, res != 0); n = 1; break;
+    default: n = 0; break;
+  }
+  if (nresults == LUA_MULTRET)
+    L->top = func + n;
+  else {
+    for (i = n; i < nresults; i++)
+      setnilvalue(func + i);
+  }
+  return 1;
+}
+
+
+/*
+** Does the stores of OP_POKE when 'func' is still the builtin registered
+** for 'width' bytes and both arguments are numbers, with the same address
+** clipping and byte order as the builtin.  Returns 0 to make OP_POKE do
+** the call instead.
+*/
+static int pokecall (lua_State *L, StkId func, int width, int nresults) {
+  global_State *g = G(L);
+  lu_byte *p = g->pico8memory;
+  unsigned int address;
+  uint32_t data;
+  int i;
+  if (!ttislcf(func) || fvalue(func) != g->pico8poke[width >> 1] ||
+      p == NULL || !ttisnumber(func + 1) || !ttisnumber(func + 2) ||
+      (L->hookmask & (LUA_MASKCALL | LUA_MASKRET)))
+    return 0;
+  address = fix32_to_uint16(nvalue(func + 1));
+  data = fix32_to_uint32(nvalue(func + 2));
+  if (address + width <= 0x8000) {
+    for (i = width - 1; i >= 0; i--) {  /* big-endian, like the builtin */
+      p[address + i] = cast_byte(data);
+      data >>= 8;
+    }
+  }
+  if (nresults == LUA_MULTRET)
+    L->top = func;
+  else {
+    for (i = 0; i < nresults; i++)
+      setnilvalue(func + i);
+  }
+  return 1;
+}
+
+
+/*
+** Does the calls of the builtin 'sub' with a string and one or two
+** numbers, and of the builtin 'ord' with a string and at most one
+** number, with the same index handling as the builtins.  Returns 0 to
+** make OP_CALL do the call instead.
+*/
+static int strcall (lua_State *L, StkId func, int nargs, int nresults) {
+  global_State *g = G(L);
+  lua_CFunction f = fvalue(func);
+  TString *ts;
+  const char *s;
+  int32_t len;
+  int i, n = 1;
+  if ((f != g->pico8sub && f != g->pico8ord) ||
+      nargs < 1 || !ttisstring(func + 1) ||
+      (L->hookmask & (LUA_MASKCALL | LUA_MASKRET)))
+    return 0;
+  s = svalue(func + 1);
+  len = cast(int32_t, tsvalue(func + 1)->len);
+  if (f == g->pico8sub) {
+    int32_t start, end = -1;
+    if (nargs < 2 || !ttisnumber(func + 2))
+      return 0;
+    start = fix32_to_int32(nvalue(func + 2));
+    if (nargs >= 3 && !ttisnil(func + 3)) {
+      if (!ttisnumber(func + 3)) return 0;
+      end = fix32_to_int32(nvalue(func + 3));
+    }
+    if (start < 0) start += len + 1;  /* negative indices count from the end */
+    if (end < 0) end += len + 1;
+    if (start < 1) start = 1;
+    if (end > len) end = len;
+    if (start > end)
+      start = end = 1;  /* empty result */
+    else
+      end++;
+    ts = (end - start == 1) ? g->onechar[cast_byte(s[start - 1])] : NULL;
+    if (ts == NULL)
+      ts = luaS_newlstr(L, s + start - 1, end - start);
+    setsvalue2s(L, func, ts);
+  }
+  else {
+    int32_t index = 0;
+    if (nargs > 2) return 0;  /* several codes */
+    if (nargs == 2) {
+      if (!ttisnumber(func + 2)) return 0;
+      index = fix32_to_int32(nvalue(func + 2)) - 1;
+    }
+    if (index < 0 || index >= len)
+      n = 0;
+    else
+      setnvalue(func, fix32_from_uint8(cast_byte(s[index])));
+  }
+  if (nresults == LUA_MULTRET)
+    L->top = func + n;
+  else {
+    for (i = n; i < nresults; i++)
+      setnilvalue(func + i);
+    L->top = func + nresults;
+  }
+  luaC_checkGC(L);  /* 'sub' may have made a string */
+  return 1;
+}
+
+
 /*
 ** finish execution of an opcode interrupted by an yield
 */
@@ -471,21 +729,22 @@ void luaV_finishOp (lua_State *L) {
     case OP_MOD: case OP_POW: case OP_IDIV: case OP_BAND:
     case OP_BOR: case OP_BXOR: case OP_SHL: case OP_SHR:
     case OP_LSHR: case OP_ROTL: case OP_ROTR:
+    case OP_ADDK: case OP_SUBK: case OP_MULK:
     case OP_UNM: case OP_BNOT: case OP_LEN:
     case OP_GETTABUP: case OP_GETTABLE: case OP_SELF: {
       setobjs2s(L, base + GETARG_A(inst), --L->top);
       break;
     }
-    case OP_LE: case OP_LT: case OP_EQ: {
+    case OP_LE: case OP_LT: case OP_EQ: case OP_LEK: case OP_LTK: {
       int res = !l_isfalse(L->top - 1);
       L->top--;
       /* metamethod should not be called when operand is K */
       lua_assert(!ISK(GETARG_B(inst)));
-      if (op == OP_LE &&  /* "<=" using "<" instead? */
+      if ((op == OP_LE || op == OP_LEK) &&  /* "<=" using "<" instead? */
           ttisnil(luaT_gettmbyobj(L, base + GETARG_B(inst), TM_LE)))
         res = !res;  /* invert result */
       lua_assert(GET_OPCODE(*ci->u.l.savedpc) == OP_JMP);
-      if (res != GETARG_A(inst))  /* condition failed? */
+      if (res != (GETARG_A(inst) & 1))  /* condition failed? */
         ci->u.l.savedpc++;  /* skip jump instruction */
       break;
     }
@@ -496,7 +755,7 @@ void luaV_finishOp (lua_State *L) {
       setobj2s(L, top - 2, top);  /* put TM result in proper position */
       if (total > 1) {  /* are there elements to concat? */
         L->top = top - 1;  /* top is one after last element (at top-2) */
-        luaV_concat(L, total);  /* concat them (may yield again) */
+        luaV_concat(L, total, -1);  /* concat them (may yield again) */
       }
       /* move final result to final position */
       setobj2s(L, ci->u.l.base + GETARG_A(inst), L->top - 1);
@@ -508,7 +767,7 @@ void luaV_finishOp (lua_State *L) {
       L->top = ci->top;  /* correct top */
       break;
     }
-    case OP_CALL: {
+    case OP_CALL: case OP_POKE: {
       if (GETARG_C(inst) - 1 >= 0)  /* nresults >= 0? */
         L->top = ci->top;  /* adjust results */
       break;
@@ -538,6 +797,7 @@ void luaV_finishOp (lua_State *L) {
 	ISK(GETARG_B(i)) ? k+INDEXK(GETARG_B(i)) : base+GETARG_B(i))
 #define RKC(i)	check_exp(getCMode(GET_OPCODE(i)) == OpArgK, \
 	ISK(GETARG_C(i)) ? k+INDEXK(GETARG_C(i)) : base+GETARG_C(i))
+#define KC(i)	check_exp(ISK(GETARG_C(i)), k+INDEXK(GETARG_C(i)))
 #define KBx(i)  \
   (k + (GETARG_Bx(i) != 0 ? GETARG_Bx(i) - 1 : GETARG_Ax(*ci->u.l.savedpc++)))
 
@@ -548,8 +808,11 @@ void luaV_finishOp (lua_State *L) {
     if (a > 0) luaF_close(L, ci->u.l.base + a - 1); \
     ci->u.l.savedpc += GETARG_sBx(i) + e; }
 
-/* for test instructions, execute the jump instruction that follows it */
-#define donextjump(ci)	{ i = *ci->u.l.savedpc; dojump(ci, i, 1); }
+/* for test instructions, execute the jump instruction that follows it;
+   a jump back closes a loop like OP_JMP does, so it traps as well */
+#define donextjump(ci) \
+  { i = *ci->u.l.savedpc; dojump(ci, i, 1); \
+    if (GETARG_sBx(i) < 0) vmtrap(); }
 
 
 #define Protect(x)	{ {x;}; base = ci->u.l.base; }
@@ -570,391 +833,159 @@ void luaV_finishOp (lua_State *L) {
         } \
         else { Protect(luaV_arith(L, ra, rb, rc, tm)); } }
 
-#define unary_op(op,tm) {\
+/* R(B) op K(C), with K(C) known to be a number */
+#define arithk_op(op,tm) { \
+        TValue *rb = RB(i); \
+        TValue *rc = KC(i); \
+        if (ttisnumber(rb)) { \
+          lua_Number nb = nvalue(rb), nc = nvalue(rc); \
+          setnvalue(ra, op(L, nb, nc)); \
+        } \
+        else { Protect(luaV_arith(L, ra, rb, rc, tm)); } }
+
+/* skip the jump that follows a test, or take it without a dispatch */
+#define condjump(res,a) { \
+        if ((res) != (a)) ci->u.l.savedpc++; \
+        else donextjump(ci); }
+
+#define compare_op(op,f,rb,rc,a) { \
+        int res; \
+        if (ttisnumber(rb) && ttisnumber(rc)) \
+          res = op(L, nvalue(rb), nvalue(rc)); \
+        else { Protect(res = f(L, rb, rc)); } \
+        condjump(res, a); }
+
+#define comparek_op(op,f) { \
         TValue *rb = RB(i); \
+        TValue *rc = KC(i); \
+        if (GETARG_A(i) & 2) { TValue *t = rb; rb = rc; rc = t; } \
+        compare_op(op, f, rb, rc, GETARG_A(i) & 1); }
+
+/* R(A) := t[K(C)], through the constant's inline cache */
+#define gettablek(t) { \
+        int kc = INDEXK(GETARG_C(i)); \
+        TValue *rc = k + kc; \
+        int *slot = cl->p->kslot + kc; \
+        Node *n; \
+        if (ttistable(t) && *slot < sizenode(hvalue(t)) && \
+            (n = gnode(hvalue(t), *slot), \
+             ttisshrstring(gkey(n)) && ttisshrstring(rc) && \
+             rawtsvalue(gkey(n)) == rawtsvalue(rc) && !ttisnil(gval(n)))) { \
+          setobj2s(L, ra, gval(n)); \
+        } \
+        else { Protect(luaV_gettablek(L, t, rc, ra, slot)); } }
+
+/*
+** Fast path for t[i] with an integral number 'i' inside the array part;
+** a nil there only goes the generic way when 't' has a metatable
+*/
+#define arrayindex(h,n) \
+        (((n) & 0xffff) == 0 && \
+         cast(unsigned int, fix32_to_int(n) - 1) < \
+         cast(unsigned int, (h)->sizearray))
+
+/* R(A) := t[RK(C)] */
+#define gettable(t) { \
+        TValue *rc = RKC(i); \
+        TValue *v; \
+        if (ttistable(t) && ttisnumber(rc) && \
+            arrayindex(hvalue(t), nvalue(rc)) && \
+            (v = &hvalue(t)->array[fix32_to_int(nvalue(rc)) - 1], \
+             !ttisnil(v) || hvalue(t)->metatable == NULL)) { \
+          setobj2s(L, ra, v); \
+        } \
+        else { Protect(luaV_gettable(L, t, rc, ra)); } }
+
+/* t[RK(B)] := RK(C) */
+#define settable(t) { \
+        TValue *rb = RKB(i); \
+        TValue *rc = RKC(i); \
+        TValue *v; \
+        if (ttistable(t) && ttisnumber(rb) && \
+            arrayindex(hvalue(t), nvalue(rb)) && \
+            (v = &hvalue(t)->array[fix32_to_int(nvalue(rb)) - 1], \
+             !ttisnil(v) || hvalue(t)->metatable == NULL)) { \
+          luaS_escape(L, rc); \
+          setobj2t(L, v, rc); \
+          luaC_barrierback(L, obj2gco(hvalue(t)), rc); \
+        } \
+        else { Protect(luaV_settable(L, t, rb, rc)); } }
+
+#define unary_op(op,tm,getb) {\
+        TValue *rb = getb(i); \
         if (ttisnumber(rb)) { \
           lua_Number nb = nvalue(rb); \
           setnvalue(ra, op(L, nb)); \
         } \
         else { Protect(luaV_arith(L, ra, rb, rb, tm)); } }
 
+/*
+** Opcode dispatch. With compilers that support labels as values, every
+** instruction jumps straight to the next one through a table of label
+** addresses (see ljumptab.h); otherwise it is a plain 'switch'.
+*/
+#if !defined(LUA_USE_JUMPTABLE)
+#if defined(__GNUC__)
+#define LUA_USE_JUMPTABLE	1
+#else
+#define LUA_USE_JUMPTABLE	0
+#endif
+#endif
+
+/* WARNING: several calls may realloc the stack and invalidate `ra' */
+#define vmfetch()	{ \
+  i = *(ci->u.l.savedpc++); \
+  vmhook(); \
+  ra = RA(i); \
+  lua_assert(base == ci->u.l.base); \
+  lua_assert(base <= L->top && L->top < L->stack + L->stacksize); }
+
+#if LUA_USE_JUMPTABLE
+#define vmdispatch(o)	goto *disptab[o];
+#define vmbreak		{ vmfetch(); vmdispatch(GET_OPCODE(i)); }
+#define vmcase(l,b)	L_##l: {b}  vmbreak;
+#define vmcasenb(l,b)	L_##l: {b}		/* nb = no break */
+#else
 #define vmdispatch(o)	switch(o)
 #define vmcase(l,b)	case l: {b}  break;
 #define vmcasenb(l,b)	case l: {b}		/* nb = no break */
+#endif
+
+
+#define anyhook(L)	((L)->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT))
+
+/*
+** Loop used while line or count hooks are installed: checks them before
+** every instruction.
+*/
+#define luaV_execloop	execute_hooked
+#define vmhook()	{ \
+  if (anyhook(L) && (--L->hookcount == 0 || L->hookmask & LUA_MASKLINE)) \
+    Protect(traceexec(L)); }
+#define vmtrap()	((void)0)
+#include "lvmloop.h"
+#undef luaV_execloop
+#undef vmhook
+#undef vmtrap
+
+/*
+** Loop used otherwise. A hook installed meanwhile is noticed at the next
+** call, return or backward jump, where the rest of the invocation moves
+** over to the hooked loop.
+*/
+#define luaV_execloop	execute_fast
+#define vmhook()	/* void */
+#define vmtrap()	{ if (anyhook(L)) { execute_hooked(L); return; } }
+#include "lvmloop.h"
+#undef luaV_execloop
+#undef vmhook
+#undef vmtrap
+
 
 void luaV_execute (lua_State *L) {
-  CallInfo *ci = L->ci;
-  LClosure *cl;
-  TValue *k;
-  StkId base;
- newframe:  /* reentry point when frame changes (call/return) */
-  lua_assert(ci == L->ci);
-  cl = clLvalue(ci->func);
-  k = cl->p->k;
-  base = ci->u.l.base;
-  /* main loop of interpreter */
-  for (;;) {
-    Instruction i = *(ci->u.l.savedpc++);
-    StkId ra;
-    if ((L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) &&
-        (--L->hookcount == 0 || L->hookmask & LUA_MASKLINE)) {
-      Protect(traceexec(L));
-    }
-    /* WARNING: several calls may realloc the stack and invalidate `ra' */
-    ra = RA(i);
-    lua_assert(base == ci->u.l.base);
-    lua_assert(base <= L->top && L->top < L->stack + L->stacksize);
-    vmdispatch (GET_OPCODE(i)) {
-      vmcase(OP_MOVE,
-        setobjs2s(L, ra, RB(i));
-      )
-      vmcase(OP_LOADK,
-        TValue *rb = k + GETARG_Bx(i);
-        setobj2s(L, ra, rb);
-      )
-      vmcase(OP_LOADKX,
-        TValue *rb;
-        lua_assert(GET_OPCODE(*ci->u.l.savedpc) == OP_EXTRAARG);
-        rb = k + GETARG_Ax(*ci->u.l.savedpc++);
-        setobj2s(L, ra, rb);
-      )
-      vmcase(OP_LOADBOOL,
-        setbvalue(ra, GETARG_B(i));
-        if (GETARG_C(i)) ci->u.l.savedpc++;  /* skip next instruction (if C) */
-      )
-      vmcase(OP_LOADNIL,
-        int b = GETARG_B(i);
-        do {
-          setnilvalue(ra++);
-        } while (b--);
-      )
-      vmcase(OP_GETUPVAL,
-        int b = GETARG_B(i);
-        setobj2s(L, ra, cl->upvals[b]->v);
-      )
-      vmcase(OP_GETTABUP,
-        int b = GETARG_B(i);
-        Protect(luaV_gettable(L, cl->upvals[b]->v, RKC(i), ra));
-      )
-      vmcase(OP_GETTABLE,
-        Protect(luaV_gettable(L, RB(i), RKC(i), ra));
-      )
-      vmcase(OP_SETTABUP,
-        int a = GETARG_A(i);
-        Protect(luaV_settable(L, cl->upvals[a]->v, RKB(i), RKC(i)));
-      )
-      vmcase(OP_SETUPVAL,
-        UpVal *uv = cl->upvals[GETARG_B(i)];
-        setobj(L, uv->v, ra);
-        luaC_barrier(L, uv, ra);
-      )
-      vmcase(OP_SETTABLE,
-        Protect(luaV_settable(L, ra, RKB(i), RKC(i)));
-      )
-      vmcase(OP_NEWTABLE,
-        int b = GETARG_B(i);
-        int c = GETARG_C(i);
-        Table *t = luaH_new(L);
-        sethvalue(L, ra, t);
-        if (b != 0 || c != 0)
-          luaH_resize(L, t, luaO_fb2int(b), luaO_fb2int(c));
-        checkGC(L, ra + 1);
-      )
-      vmcase(OP_SELF,
-        StkId rb = RB(i);
-        setobjs2s(L, ra+1, rb);
-        Protect(luaV_gettable(L, rb, RKC(i), ra));
-      )
-      vmcase(OP_ADD,
-        arith_op(luai_numadd, TM_ADD);
-      )
-      vmcase(OP_SUB,
-        arith_op(luai_numsub, TM_SUB);
-      )
-      vmcase(OP_MUL,
-        arith_op(luai_nummul, TM_MUL);
-      )
-      vmcase(OP_DIV,
-        arith_op(luai_numdiv, TM_DIV);
-      )
-      vmcase(OP_MOD,
-        arith_op(luai_nummod, TM_MOD);
-      )
-      vmcase(OP_POW,
-        arith_op(luai_numpow, TM_POW);
-      )
-      vmcase(OP_IDIV,
-        arith_op(luai_numidiv, TM_IDIV);
-      )
-      vmcase(OP_BAND,
-        arith_op(luai_numband, TM_BAND);
-      )
-      vmcase(OP_BOR,
-        arith_op(luai_numbor, TM_BOR);
-      )
-      vmcase(OP_BXOR,
-        arith_op(luai_numbxor, TM_BXOR);
-      )
-      vmcase(OP_SHL,
-        arith_op(luai_numshl, TM_SHL);
-      )
-      vmcase(OP_SHR,
-        arith_op(luai_numshr, TM_SHR);
-      )
-      vmcase(OP_LSHR,
-        arith_op(luai_numlshr, TM_LSHR);
-      )
-      vmcase(OP_ROTL,
-        arith_op(luai_numrotl, TM_ROTL);
-      )
-      vmcase(OP_ROTR,
-        arith_op(luai_numrotr, TM_ROTR);
-      )
-      vmcase(OP_UNM,
-        unary_op(luai_numunm, TM_UNM);
-      )
-      vmcase(OP_BNOT,
-        unary_op(luai_numbnot, TM_BNOT);
-      )
-      vmcase(OP_PEEK,
-        unary_op(luai_numpeek, TM_PEEK);
-      )
-      vmcase(OP_PEEK2,
-        unary_op(luai_numpeek2, TM_PEEK2);
-      )
-      vmcase(OP_PEEK4,
-        unary_op(luai_numpeek4, TM_PEEK4);
-      )
-      vmcase(OP_NOT,
-        TValue *rb = RB(i);
-        int res = l_isfalse(rb);  /* next assignment may change this value */
-        setbvalue(ra, res);
-      )
-      vmcase(OP_LEN,
-        Protect(luaV_objlen(L, ra, RB(i)));
-      )
-      vmcase(OP_CONCAT,
-        int b = GETARG_B(i);
-        int c = GETARG_C(i);
-        StkId rb;
-        L->top = base + c + 1;  /* mark the end of concat operands */
-        Protect(luaV_concat(L, c - b + 1));
-        ra = RA(i);  /* 'luav_concat' may invoke TMs and move the stack */
-        rb = b + base;
-        setobjs2s(L, ra, rb);
-        checkGC(L, (ra >= rb ? ra + 1 : rb));
-        L->top = ci->top;  /* restore top */
-      )
-      vmcase(OP_JMP,
-        dojump(ci, i, 0);
-      )
-      vmcase(OP_EQ,
-        TValue *rb = RKB(i);
-        TValue *rc = RKC(i);
-        Protect(
-          if (cast_int(equalobj(L, rb, rc)) != GETARG_A(i))
-            ci->u.l.savedpc++;
-          else
-            donextjump(ci);
-        )
-      )
-      vmcase(OP_LT,
-        Protect(
-          if (luaV_lessthan(L, RKB(i), RKC(i)) != GETARG_A(i))
-            ci->u.l.savedpc++;
-          else
-            donextjump(ci);
-        )
-      )
-      vmcase(OP_LE,
-        Protect(
-          if (luaV_lessequal(L, RKB(i), RKC(i)) != GETARG_A(i))
-            ci->u.l.savedpc++;
-          else
-            donextjump(ci);
-        )
-      )
-      vmcase(OP_TEST,
-        if (GETARG_C(i) ? l_isfalse(ra) : !l_isfalse(ra))
-            ci->u.l.savedpc++;
-          else
-          donextjump(ci);
-      )
-      vmcase(OP_TESTSET,
-        TValue *rb = RB(i);
-        if (GETARG_C(i) ? l_isfalse(rb) : !l_isfalse(rb))
-          ci->u.l.savedpc++;
-        else {
-          setobjs2s(L, ra, rb);
-          donextjump(ci);
-        }
-      )
-      vmcase(OP_CALL,
-        int b = GETARG_B(i);
-        int nresults = GETARG_C(i) - 1;
-        if (b != 0) L->top = ra+b;  /* else previous instruction set top */
-        if (luaD_precall(L, ra, nresults)) {  /* C function? */
-          if (nresults >= 0) L->top = ci->top;  /* adjust results */
-          base = ci->u.l.base;
-        }
-        else {  /* Lua function */
-          ci = L->ci;
-          ci->callstatus |= CIST_REENTRY;
-          goto newframe;  /* restart luaV_execute over new Lua function */
-        }
-      )
-      vmcase(OP_TAILCALL,
-        int b = GETARG_B(i);
-        if (b != 0) L->top = ra+b;  /* else previous instruction set top */
-        lua_assert(GETARG_C(i) - 1 == LUA_MULTRET);
-        if (luaD_precall(L, ra, LUA_MULTRET))  /* C function? */
-          base = ci->u.l.base;
-        else {
-          /* tail call: put called frame (n) in place of caller one (o) */
-          CallInfo *nci = L->ci;  /* called frame */
-          CallInfo *oci = nci->previous;  /* caller frame */
-          StkId nfunc = nci->func;  /* called function */
-          StkId ofunc = oci->func;  /* caller function */
-          /* last stack slot filled by 'precall' */
-          StkId lim = nci->u.l.base + getproto(nfunc)->numparams;
-          int aux;
-          /* close all upvalues from previous call */
-          if (cl->p->sizep > 0) luaF_close(L, oci->u.l.base);
-          /* move new frame into old one */
-          for (aux = 0; nfunc + aux < lim; aux++)
-            setobjs2s(L, ofunc + aux, nfunc + aux);
-          oci->u.l.base = ofunc + (nci->u.l.base - nfunc);  /* correct base */
-          oci->top = L->top = ofunc + (L->top - nfunc);  /* correct top */
-          oci->u.l.savedpc = nci->u.l.savedpc;
-          oci->callstatus |= CIST_TAIL;  /* function was tail called */
-          ci = L->ci = oci;  /* remove new frame */
-          lua_assert(L->top == oci->u.l.base + getproto(ofunc)->maxstacksize);
-          goto newframe;  /* restart luaV_execute over new Lua function */
-        }
-      )
-      vmcasenb(OP_RETURN,
-        int b = GETARG_B(i);
-        if (b != 0) L->top = ra+b-1;
-        if (cl->p->sizep > 0) luaF_close(L, base);
-        b = luaD_poscall(L, ra);
-        if (!(ci->callstatus & CIST_REENTRY))  /* 'ci' still the called one */
-          return;  /* external invocation: return */
-        else {  /* invocation via reentry: continue execution */
-          ci = L->ci;
-          if (b) L->top = ci->top;
-          lua_assert(isLua(ci));
-          lua_assert(GET_OPCODE(*((ci)->u.l.savedpc - 1)) == OP_CALL);
-          goto newframe;  /* restart luaV_execute over new Lua function */
-        }
-      )
-      vmcase(OP_FORLOOP,
-        lua_Number step  = nvalue(ra+2);
-        lua_Number idx   = luai_numadd(L, nvalue(ra), step); /* increment index */
-        lua_Number limit = nvalue(ra+1);
-        /* Evaluate step direction once; fix32 is int32_t so > 0 is a plain compare. */
-        if (step > 0) {
-          /* positive step: guard against wrap-around, then check idx <= limit */
-          if (idx >= nvalue(ra) && idx <= limit) {
-            ci->u.l.savedpc += GETARG_sBx(i);
-            setnvalue(ra,   idx);
-            setnvalue(ra+3, idx);
-          }
-        } else {
-          /* negative step: guard against wrap-around, then check limit <= idx */
-          if (idx <= nvalue(ra) && limit <= idx) {
-            ci->u.l.savedpc += GETARG_sBx(i);
-            setnvalue(ra,   idx);
-            setnvalue(ra+3, idx);
-          }
-        }
-      )
-      vmcase(OP_FORPREP,
-        const TValue *init = ra;
-        const TValue *plimit = ra+1;
-        const TValue *pstep = ra+2;
-        if (!tonumber(init, ra))
-          luaG_runerror(L, LUA_QL("for") " initial value must be a number");
-        else if (!tonumber(plimit, ra+1))
-          luaG_runerror(L, LUA_QL("for") " limit must be a number");
-        else if (!tonumber(pstep, ra+2))
-          luaG_runerror(L, LUA_QL("for") " step must be a number");
-        setnvalue(ra, luai_numsub(L, nvalue(ra), nvalue(pstep)));
-        ci->u.l.savedpc += GETARG_sBx(i);
-      )
-      vmcasenb(OP_TFORCALL,
-        StkId cb = ra + 3;  /* call base */
-        setobjs2s(L, cb+2, ra+2);
-        setobjs2s(L, cb+1, ra+1);
-        setobjs2s(L, cb, ra);
-        L->top = cb + 3;  /* func. + 2 args (state and index) */
-        Protect(luaD_call(L, cb, GETARG_C(i), 1));
-        L->top = ci->top;
-        i = *(ci->u.l.savedpc++);  /* go to next instruction */
-        ra = RA(i);
-        lua_assert(GET_OPCODE(i) == OP_TFORLOOP);
-        goto l_tforloop;
-      )
-      vmcase(OP_TFORLOOP,
-        l_tforloop:
-        if (!ttisnil(ra + 1)) {  /* continue loop? */
-          setobjs2s(L, ra, ra + 1);  /* save control variable */
-           ci->u.l.savedpc += GETARG_sBx(i);  /* jump back */
-        }
-      )
-      vmcase(OP_SETLIST,
-        int n = GETARG_B(i);
-        int c = GETARG_C(i);
-        int last;
-        Table *h;
-        if (n == 0) n = cast_int(L->top - ra) - 1;
-        if (c == 0) {
-          lua_assert(GET_OPCODE(*ci->u.l.savedpc) == OP_EXTRAARG);
-          c = GETARG_Ax(*ci->u.l.savedpc++);
-        }
-        luai_runtimecheck(L, ttistable(ra));
-        h = hvalue(ra);
-        last = ((c-1)*LFIELDS_PER_FLUSH) + n;
-        if (last > h->sizearray)  /* needs more space? */
-          luaH_resizearray(L, h, last);  /* pre-allocate it at once */
-        for (; n > 0; n--) {
-          TValue *val = ra+n;
-          luaH_setint(L, h, last--, val);
-          luaC_barrierback(L, obj2gco(h), val);
-        }
-        L->top = ci->top;  /* correct top (in case of previous open call) */
-      )
-      vmcase(OP_CLOSURE,
-        Proto *p = cl->p->p[GETARG_Bx(i)];
-        Closure *ncl = getcached(p, cl->upvals, base);  /* cached closure */
-        if (ncl == NULL)  /* no match? */
-          pushclosure(L, p, cl->upvals, base, ra);  /* create a new one */
-        else
-          setclLvalue(L, ra, ncl);  /* push cashed closure */
-        checkGC(L, ra + 1);
-      )
-      vmcase(OP_VARARG,
-        int b = GETARG_B(i) - 1;
-        int j;
-        int n = cast_int(base - ci->func) - cl->p->numparams - 1;
-        if (b < 0) {  /* B == 0? */
-          b = n;  /* get all var. arguments */
-          Protect(luaD_checkstack(L, n));
-          ra = RA(i);  /* previous call may change the stack */
-          L->top = ra + n;
-        }
-        for (j = 0; j < b; j++) {
-          if (j < n) {
-            setobjs2s(L, ra + j, base - n + j);
-          }
-          else {
-            setnilvalue(ra + j);
-          }
-        }
-      )
-      vmcase(OP_EXTRAARG,
-        lua_assert(0);
-      )
-    }
-  }
+  if (anyhook(L))
+    execute_hooked(L);
+  else
+    execute_fast(L);
 }
 
@@ -0,0 +1,145 @@
+/** @file compile_bench.c
+ *
+ *  A portable PICO-8 emulator written in C.
+ *
+ *  Copyright (c) 2025-2026, Michael Fitzmayer. All rights reserved.
+ *  SPDX-License-Identifier: MIT
+ *
+ **/
+
+#include <SDL3/SDL.h>
+#include <stdlib.h>
+#include "z8lua/lua.h"
+#include "z8lua/lauxlib.h"
+#include "cart.h"
+#include "pool.h"
+
+#define STBI_ONLY_PNG
+#define STBI_NO_THREAD_LOCALS
+#define STBI_MALLOC SDL_malloc
+#define STBI_REALLOC SDL_realloc
+#define STBI_FREE SDL_free
+#define STB_IMAGE_IMPLEMENTATION
+#include "misc/stb_image.h"
+
+#define CARTS_DIR "../export/carts/"
+
+// Every cart is compiled this many times and the fastest run is kept, which
+// leaves out page faults on the first run and most of the noise of the host.
+#define COMPILE_RUNS 20
+
+static int compare_names(const void* a, const void* b)
+{
+    return SDL_strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+static uint32_t count_lines(const uint8_t* code, uint32_t size)
+{
+    uint32_t lines = 1;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        lines += code[i] == '\n';
+    }
+    return lines;
+}
+
+// Returns the best time in nanoseconds it takes luaL_loadbuffer to compile
+// the code of a cart, or 0 if it doesn't compile.
+static Uint64 time_compile(const cart_t* cart)
+{
+    pool_t pool;
+    init_pool(&pool);
+    lua_State* vm = lua_newstate(pool_allocator, &pool);
+    if (!vm)
+    {
+        return 0;
+    }
+
+    Uint64 best = 0;
+    for (int run = 0; run < COMPILE_RUNS; run++)
+    {
+        Uint64 start = SDL_GetTicksNS();
+        int status = luaL_loadbuffer(vm, (const char*)cart->code, cart->code_size, "cart");
+        Uint64 elapsed = SDL_GetTicksNS() - start;
+
+        if (status != LUA_OK)
+        {
+            SDL_Log("  %s", lua_tostring(vm, -1));
+            best = 0;
+            break;
+        }
+        lua_pop(vm, 1);
+        lua_gc(vm, LUA_GCCOLLECT, 0);
+
+        if (run == 0 || elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+
+    lua_close(vm);
+    destroy_pool(&pool);
+    return best;
+}
+
+// Reports the compile throughput (lines/s and bytes/s) of the bundled carts.
+int main()
+{
+    static cart_t cart;
+    int count = 0;
+    char** names = SDL_GlobDirectory(CARTS_DIR, "*.PNG", 0, &count);
+    if (!names || count == 0)
+    {
+        SDL_Log("No carts found in %s", CARTS_DIR);
+        SDL_free(names);
+        return EXIT_FAILURE;
+    }
+    SDL_qsort(names, count, sizeof(char*), compare_names);
+
+    Uint64 total_ns = 0;
+    Uint64 total_bytes = 0;
+    Uint64 total_lines = 0;
+    int failed = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        char path[256];
+        SDL_snprintf(path, sizeof(path), "%s%s", CARTS_DIR, names[i]);
+
+        SDL_zero(cart);
+        if (!read_cart(path, &cart, NULL) || !load_cart_code(&cart))
+        {
+            SDL_Log("%-14s skipped: no code", names[i]);
+            free_cart_code(&cart);
+            continue;
+        }
+
+        uint32_t lines = count_lines(cart.code, cart.code_size);
+        Uint64 ns = time_compile(&cart);
+        if (ns)
+        {
+            SDL_Log("%-14s %6u bytes %5u lines %8.3f ms",
+                names[i], cart.code_size, lines, ns / 1e6);
+            total_ns += ns;
+            total_bytes += cart.code_size;
+            total_lines += lines;
+        }
+        else
+        {
+            SDL_Log("%-14s failed to compile", names[i]);
+            failed++;
+        }
+        free_cart_code(&cart);
+    }
+    SDL_free(names);
+
+    if (total_ns)
+    {
+        double seconds = total_ns / 1e9;
+        SDL_Log("total: %llu bytes, %llu lines in %.3f ms: %.0f lines/s, %.0f KB/s",
+            (unsigned long long)total_bytes, (unsigned long long)total_lines, total_ns / 1e6,
+            total_lines / seconds, total_bytes / seconds / 1024.0);
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+/** @file digest.c
+ *
+ *  A portable PICO-8 emulator written in C.
+ *
+ *  Copyright (c) 2025-2026, Michael Fitzmayer. All rights reserved.
+ *  SPDX-License-Identifier: MIT
+ *
+ **/
+
+#include <SDL3/SDL.h>
+#include <stdlib.h>
+#include "z8lua/lua.h"
+#include "z8lua/lualib.h"
+#include "api.h"
+#include "cart.h"
+#include "memory.h"
+#include "pool.h"
+
+#define STBI_ONLY_PNG
+#define STBI_NO_THREAD_LOCALS
+#define STBI_MALLOC SDL_malloc
+#define STBI_REALLOC SDL_realloc
+#define STBI_FREE SDL_free
+#define STB_IMAGE_IMPLEMENTATION
+#include "misc/stb_image.h"
+
+#define CARTS_DIR "../export/carts/"
+
+// Every cart runs this many frames; time() stands still meanwhile, and no
+// button is ever pressed.
+#define DIGEST_FRAMES 300
+
+static int compare_names(const void* a, const void* b)
+{
+    return SDL_strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+static uint32_t fnv1a(uint32_t hash, const uint8_t* data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static lua_State* new_vm(pool_t* pool)
+{
+    init_pool(pool);
+    lua_State* vm = lua_newstate(pool_allocator, pool);
+    if (!vm)
+    {
+        return NULL;
+    }
+    lua_setpico8memory(vm, pico8_ram);
+    luaL_openlibs(vm);
+    init_api(vm);
+    (void)luaL_dostring(vm, "srand(1)");
+    return vm;
+}
+
+// Returns 1 if the global function ran, 0 if there is none and -1 if it
+// raised an error.
+static int call_global(lua_State* vm, const char* name)
+{
+    lua_getglobal(vm, name);
+    if (!lua_isfunction(vm, -1))
+    {
+        lua_pop(vm, 1);
+        return 0;
+    }
+    return lua_pcall(vm, 0, 0, 0) == LUA_OK ? 1 : -1;
+}
+
+// Logs the RAM hash after the frames of a cart, or where it stopped.
+static void digest_cart(const char* name, const cart_t* cart)
+{
+    pool_t pool;
+    lua_State* vm = new_vm(&pool);
+    if (!vm)
+    {
+        SDL_Log("%-14s no state", name);
+        return;
+    }
+
+    reset_memory();
+    SDL_memcpy(pico8_ram, cart->cart_data, 0x42ff * sizeof(uint8_t));
+
+    if (luaL_loadbuffer(vm, (const char*)cart->code, cart->code_size, "cart")
+        || lua_pcall(vm, 0, 0, 0))
+    {
+        SDL_Log("%-14s %s", name, lua_tostring(vm, -1));
+    }
+    else
+    {
+        uint32_t hash = 2166136261u;
+        int frame = 0;
+        int status = call_global(vm, "_init");
+        for (; status >= 0 && frame < DIGEST_FRAMES; frame++)
+        {
+            status = call_global(vm, "_update60");
+            if (status == 0)
+            {
+                status = call_global(vm, "_update");
+            }
+            if (status >= 0)
+            {
+                status = call_global(vm, "_draw");
+            }
+            hash = fnv1a(hash, pico8_ram, RAM_SIZE);
+        }
+        if (status < 0)
+        {
+            SDL_Log("%-14s %08x, frame %d: %s", name, hash, frame, lua_tostring(vm, -1));
+        }
+        else
+        {
+            SDL_Log("%-14s %08x", name, hash);
+        }
+    }
+
+    lua_close(vm);
+    destroy_pool(&pool);
+}
+
+// Logs what tests.lua logs and the RAM hash after each frame of the bundled
+// carts. Built with and without the peephole optimizer (see lopt.h), the
+// two logs must be the same; opt_diff.cmake compares them.
+int main()
+{
+    static cart_t cart;
+    pool_t pool;
+    lua_State* vm = new_vm(&pool);
+    if (!vm)
+    {
+        SDL_Log("Couldn't create Lua state.");
+        return EXIT_FAILURE;
+    }
+    if (luaL_loadfile(vm, "tests.lua") || lua_pcall(vm, 0, 1, 0))
+    {
+        SDL_Log("tests.lua: %s", lua_tostring(vm, -1));
+    }
+    else
+    {
+        SDL_Log("tests.lua: %d failed", (int)lua_tointeger(vm, -1));
+    }
+    lua_close(vm);
+    destroy_pool(&pool);
+
+    int count = 0;
+    char** names = SDL_GlobDirectory(CARTS_DIR, "*.PNG", 0, &count);
+    if (!names || count == 0)
+    {
+        SDL_Log("No carts found in %s", CARTS_DIR);
+        SDL_free(names);
+        return EXIT_FAILURE;
+    }
+    SDL_qsort(names, count, sizeof(char*), compare_names);
+
+    for (int i = 0; i < count; i++)
+    {
+        char path[256];
+        SDL_snprintf(path, sizeof(path), "%s%s", CARTS_DIR, names[i]);
+
+        SDL_zero(cart);
+        if (!read_cart(path, &cart, NULL) || !load_cart_code(&cart))
+        {
+            SDL_Log("%-14s skipped: no code", names[i]);
+        }
+        else
+        {
+            digest_cart(names[i], &cart);
+        }
+        free_cart_code(&cart);
+    }
+    SDL_free(names);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,19 @@
+# Fails if the digest of the build with the peephole optimizer differs from
+# the one without it; see digest.c.
+#
+# cmake -DDIGEST=<digest> -DDIGEST_NOOPT=<digest_noopt> -P opt_diff.cmake
+
+execute_process(COMMAND ${DIGEST} OUTPUT_VARIABLE opt ERROR_VARIABLE opt RESULT_VARIABLE opt_result)
+execute_process(COMMAND ${DIGEST_NOOPT} OUTPUT_VARIABLE noopt ERROR_VARIABLE noopt RESULT_VARIABLE noopt_result)
+
+if(NOT opt_result EQUAL 0 OR NOT noopt_result EQUAL 0)
+  message(FATAL_ERROR "digest failed:\n${opt}")
+endif()
+
+if(NOT opt STREQUAL noopt)
+  file(WRITE digest.txt "${opt}")
+  file(WRITE digest_noopt.txt "${noopt}")
+  message(FATAL_ERROR "The optimizer changes what the code does; compare digest.txt and digest_noopt.txt.")
+endif()
+
+message(STATUS "The optimizer doesn't change what the code does.")
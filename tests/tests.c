@@ -11,19 +11,828 @@
 #include <stdlib.h>
 #include "z8lua/lua.h"
 #include "z8lua/lualib.h"
+#include "lexaloffle/p8_compress.h"
 #include "api.h"
+#include "cart.h"
+#include "core.h"
+#include "memory.h"
+#include "pool.h"
 
-static uint8_t ram[32768];
+#define STBI_ONLY_PNG
+#define STBI_NO_THREAD_LOCALS
+#define STBI_MALLOC SDL_malloc
+#define STBI_REALLOC SDL_realloc
+#define STBI_FREE SDL_free
+#define STB_IMAGE_IMPLEMENTATION
+#include "misc/stb_image.h"
 
-int main()
+#define CARTS_DIR "../export/carts/"
+
+typedef struct
+{
+    const char* file_name;
+    int code_size;
+    uint32_t code_hash;
+
+} cart_checksum_t;
+
+// Decompressed code size and FNV-1a hash of the bundled carts, as produced
+// by the reference Lexaloffle decoders.
+static const cart_checksum_t cart_checksums[] =
+{
+    { "0PTENNIS.PNG", 41468, 0xf4fb6712 },
+    { "1CELESTE.PNG", 26589, 0x987e2161 },
+    { "2API.PNG",      2780, 0xa135aa83 },
+    { "4RACER.PNG",   28677, 0x2275c184 },
+    { "5PICOPON.PNG", 45844, 0xd6e9aa6d },
+    { "6PROVNCE.PNG", 27927, 0x063a1459 },
+    { "7PICROSS.PNG", 10564, 0xdf0310fb },
+    { "8BITANGL.PNG", 37877, 0xda7aa27d },
+    { "8CABRIDE.PNG", 45268, 0x897a2ea9 },
+    { "9CARDSWP.PNG", 43258, 0xa0aa1b82 },
+    { "APICOFOX.PNG", 41938, 0xed487100 },
+    { "BSMB.PNG",     31084, 0xce3f6672 },
+    { "CMOTNREC.PNG", 41521, 0xc610a44f },
+    { "FUZ.PNG",      38753, 0x6e9eaf3d },
+    { "LIONKING.PNG", 30426, 0x9fc96b27 },
+    { "PICOPORT.PNG", 11977, 0xfc780ad9 },
+    { "WOLFHUNT.PNG", 33967, 0x68419721 }
+};
+
+static uint32_t fnv1a(const uint8_t* data, size_t length)
+{
+    uint32_t hash = 0x811c9dc5;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+static bool load_cart_data(const char* file_name, uint8_t* cart_data)
+{
+    int width, height, bpp;
+    uint8_t* image_data = stbi_load(file_name, &width, &height, &bpp, 4);
+    if (!image_data)
+    {
+        return false;
+    }
+
+    if (width != CART_WIDTH || height != CART_HEIGHT)
+    {
+        stbi_image_free(image_data);
+        return false;
+    }
+
+    for (size_t i = 0; i < CART_DATA_SIZE; i++)
+    {
+        const uint8_t* p = &image_data[i * 4];
+        cart_data[i] = ((p[3] & 0x03) << 6) | ((p[0] & 0x03) << 4) | ((p[1] & 0x03) << 2) | (p[2] & 0x03);
+    }
+
+    stbi_image_free(image_data);
+    return true;
+}
+
+static int decompress_code(const uint8_t* cart_data, int in_len, uint8_t* code)
+{
+    const uint8_t* in = &cart_data[0x4300];
+
+    if (in[0] == ':' && in[1] == 'c' && in[2] == ':' && in[3] == 0)
+    {
+        return decompress_mini(in, in_len, code, MAX_CODE_SIZE);
+    }
+    return pxa_decompress(in, in_len, code, MAX_CODE_SIZE);
+}
+
+// Checks that the decoders reproduce the reference output for every bundled
+// cart and reject truncated input instead of reading past its end.
+static int test_decompression(void)
+{
+    static uint8_t cart_data[CART_DATA_SIZE];
+    static uint8_t code[MAX_CODE_SIZE];
+    int failed = 0;
+
+    for (size_t i = 0; i < SDL_arraysize(cart_checksums); i++)
+    {
+        const cart_checksum_t* cart = &cart_checksums[i];
+        char path[256];
+
+        SDL_snprintf(path, sizeof(path), "%s%s", CARTS_DIR, cart->file_name);
+        if (!load_cart_data(path, cart_data))
+        {
+            SDL_Log("decompress %s skipped: cart not found", cart->file_name);
+            continue;
+        }
+
+        int size = decompress_code(cart_data, CART_DATA_SIZE - 0x4300, code);
+        if (size == cart->code_size && fnv1a(code, size) == cart->code_hash)
+        {
+            SDL_Log("decompress %s passed", cart->file_name);
+        }
+        else
+        {
+            SDL_Log("decompress %s failed: got %d bytes", cart->file_name, size);
+            failed++;
+        }
+
+        if (decompress_code(cart_data, 64, code) < 0)
+        {
+            SDL_Log("decompress %s truncated passed", cart->file_name);
+        }
+        else
+        {
+            SDL_Log("decompress %s truncated failed", cart->file_name);
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+static int check(bool condition, const char* name)
+{
+    SDL_Log("%s %s", name, condition ? "passed" : "failed");
+    return condition ? 0 : 1;
+}
+
+// Checks that the sections of a .p8 text cart end up at the right place in
+// the ROM and that plain ASCII code is used where it is.
+static int test_text_cart(void)
+{
+    static const char text[] =
+        "pico-8 cartridge // http://www.pico-8.com\n"
+        "version 41\n"
+        "__lua__\n"
+        "x=1\r\n"
+        "__gfx__\n"
+        "1234\n"
+        "__gff__\n"
+        "0102\n"
+        "__map__\n"
+        "a0b1\n"
+        "__sfx__\n"
+        "001000200c47118800000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000\n"
+        "__music__\n"
+        "03 01424344\n";
+    static const char glyphs[] =
+        "pico-8 cartridge // http://www.pico-8.com\n"
+        "__lua__\n"
+        "if btn(⬅️) then print(\"█\") end\n";
+    static cart_t cart;
+    static uint8_t data[sizeof(text)];
+    int failed = 0;
+
+    SDL_memcpy(data, text, sizeof(text));
+    failed += check(parse_cart(data, sizeof(text) - 1, CART_FORMAT_P8, &cart, NULL), "p8 parse");
+    failed += check(cart.code == &data[sizeof("pico-8 cartridge // http://www.pico-8.com\nversion 41\n__lua__\n") - 1]
+        && cart.code_size == 5 && !cart.owns_code, "p8 code in place");
+    failed += check(cart.cart_data[0x0000] == 0x21 && cart.cart_data[0x0001] == 0x43, "p8 gfx");
+    failed += check(cart.cart_data[0x3000] == 0x01 && cart.cart_data[0x3001] == 0x02, "p8 gff");
+    failed += check(cart.cart_data[0x2000] == 0xa0 && cart.cart_data[0x2001] == 0xb1, "p8 map");
+    failed += check(cart.cart_data[0x3200] == 0x0c && cart.cart_data[0x3201] == 0x1f
+        && cart.cart_data[0x3202] == 0x18 && cart.cart_data[0x3203] == 0x80
+        && cart.cart_data[0x3241] == 0x10 && cart.cart_data[0x3242] == 0x00, "p8 sfx");
+    failed += check(cart.cart_data[0x3100] == 0x81 && cart.cart_data[0x3101] == 0xc2
+        && cart.cart_data[0x3102] == 0x43 && cart.cart_data[0x3103] == 0x44, "p8 music");
+
+    uint8_t* glyph_data = SDL_malloc(sizeof(glyphs));
+    SDL_memcpy(glyph_data, glyphs, sizeof(glyphs));
+    failed += check(parse_cart(glyph_data, sizeof(glyphs) - 1, CART_FORMAT_P8, &cart, NULL)
+        && !cart.has_code && !cart.owns_code, "p8 code deferred");
+    failed += check(load_cart_code(&cart)
+        && cart.owns_code
+        && cart.code_size == 32
+        && SDL_memcmp(cart.code, "if btn(\"\x8b\") then print(\"\x80\") end\n", 32) == 0, "p8 glyphs");
+    free_cart_code(&cart);
+    SDL_free(glyph_data);
+
+    failed += check(!parse_cart(data, 10, CART_FORMAT_P8, &cart, NULL), "p8 truncated header");
+    failed += check(!parse_cart(data, 0x100, CART_FORMAT_ROM, &cart, NULL), "rom truncated");
+    free_cart_code(&cart);
+
+    return failed;
+}
+
+// Checks that reload() from other carts decodes each one once and evicts
+// the least recently used ROM when the cache is full.
+static int test_cart_cache(void)
+{
+    static uint8_t cart_data[CART_DATA_SIZE];
+    char paths[CART_CACHE_SIZE + 1][256];
+    uint32_t hits, misses, prev_hits, prev_misses;
+    int failed = 0;
+
+    if (SDL_arraysize(cart_checksums) < CART_CACHE_SIZE + 1)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i <= CART_CACHE_SIZE; i++)
+    {
+        SDL_snprintf(paths[i], sizeof(paths[i]), "%s%s", CARTS_DIR, cart_checksums[i].file_name);
+    }
+
+    if (!load_cart_data(paths[0], cart_data))
+    {
+        SDL_Log("cart cache skipped: cart not found");
+        return 0;
+    }
+
+    clear_cart_cache();
+    get_cart_cache_stats(&prev_hits, &prev_misses);
+
+    const uint8_t* rom = load_cart_rom(paths[0]);
+    failed += check(rom && SDL_memcmp(rom, cart_data, CART_ROM_SIZE) == 0, "cart cache rom");
+
+    load_cart_rom(paths[0]);
+    get_cart_cache_stats(&hits, &misses);
+    failed += check(hits == prev_hits + 1 && misses == prev_misses + 1, "cart cache hit");
+
+    for (int i = 1; i <= CART_CACHE_SIZE; i++)
+    {
+        load_cart_rom(paths[i]);
+    }
+    load_cart_rom(paths[0]);
+    load_cart_rom(paths[CART_CACHE_SIZE]);
+    get_cart_cache_stats(&hits, &misses);
+    failed += check(hits == prev_hits + 2 && misses == prev_misses + CART_CACHE_SIZE + 2, "cart cache eviction");
+
+    set_cart_cache_size(1);
+    get_cart_cache_stats(&prev_hits, &prev_misses);
+    load_cart_rom(paths[0]);
+    load_cart_rom(paths[1]);
+    rom = load_cart_rom(paths[0]);
+    get_cart_cache_stats(&hits, &misses);
+    failed += check(rom && SDL_memcmp(rom, cart_data, CART_ROM_SIZE) == 0
+        && hits == prev_hits && misses == prev_misses + 3, "cart cache size");
+
+    set_cart_cache_size(CART_CACHE_SIZE);
+    return failed;
+}
+
+// Checks that the Lua heap cannot grow past the pool limit, that garbage is
+// collected before an allocation fails and that the census sees the objects.
+static int test_heap_limit(void)
+{
+    size_t count[LUA_NUMCENSUS];
+    size_t bytes[LUA_NUMCENSUS];
+    pool_t pool;
+    int failed = 0;
+
+    init_pool(&pool);
+    pool.limit = 256 * 1024;
+    lua_State* vm = lua_newstate(pool_allocator, &pool);
+    if (!vm)
+    {
+        return check(false, "heap limit state");
+    }
+    luaL_openlibs(vm);
+
+    // With this pause only the emergency collection can keep up.
+    lua_gc(vm, LUA_GCSETPAUSE, 1000);
+    failed += check(luaL_dostring(vm, "for i = 1, 30000 do local t = {i} end") == 0
+        && pool.reserved <= pool.limit, "heap limit collects garbage");
+
+    failed += check(luaL_loadstring(vm, "t = {} for i = 1, 30000 do t[i] = {} end") == 0
+        && lua_pcall(vm, 0, 0, 0) == LUA_ERRMEM
+        && pool.reserved <= pool.limit, "heap limit out of memory");
+    lua_pop(vm, 1);
+
+    lua_pushnil(vm);
+    lua_setglobal(vm, "t");
+    failed += check(luaL_dostring(vm, "t = {} for i = 1, 1000 do t[i] = {} end") == 0,
+        "heap limit recovers");
+    lua_census(vm, count, bytes);
+    failed += check(count[LUA_TTABLE] > 1000
+        && bytes[LUA_TTABLE] > 1000 * 32
+        && count[LUA_TTHREAD] == 1, "heap census");
+
+    lua_close(vm);
+    destroy_pool(&pool);
+    return failed;
+}
+
+// Checks that slabs count against the limit when each size class in turn
+// fills the heap, and that a large block shrunk at the limit stays usable.
+static int test_heap_limit_slabs(void)
+{
+    pool_t pool;
+    int failed = 0;
+
+    init_pool(&pool);
+    pool.limit = 256 * 1024;
+    lua_State* vm = lua_newstate(pool_allocator, &pool);
+    if (!vm)
+    {
+        return check(false, "heap limit slabs state");
+    }
+    luaL_openlibs(vm);
+
+    // Tables of n slots fill blocks of a different class for each n.
+    const char* churn =
+        "for n = 0, 4 do\n"
+        "  local t = {}\n"
+        "  pcall(function() for i = 1, 30000 do t[i] = {} for j = 1, n do t[i][j] = j end end end)\n"
+        "  t = nil collectgarbage()\n"
+        "end";
+    failed += check(luaL_dostring(vm, churn) == 0
+        && pool.reserved <= pool.limit, "heap limit counts slabs");
+    lua_close(vm);
+    destroy_pool(&pool);
+
+    init_pool(&pool);
+    char* block = pool_allocator(&pool, NULL, LUA_TSTRING, 1000);
+    pool.limit = pool.reserved;
+    SDL_memset(block, 'x', 1000);
+    block = pool_allocator(&pool, block, 1000, 24);
+    failed += check(block && block[0] == 'x' && block[23] == 'x'
+        && pool.reserved <= pool.limit, "heap limit shrinks large blocks");
+    pool_allocator(&pool, block, 24, 0);
+    destroy_pool(&pool);
+    return failed;
+}
+
+static uint32_t count_allocations(const pool_t* pool)
+{
+    uint32_t count = pool->large;
+
+    for (int i = 0; i < POOL_NUM_CLASSES; i++)
+    {
+        count += pool->hits[i] + pool->misses[i];
+    }
+    return count;
+}
+
+static bool call_frame(lua_State* vm)
+{
+    lua_getglobal(vm, "_update");
+    if (lua_pcall(vm, 0, 0, 0) != LUA_OK)
+    {
+        SDL_Log("Lua error: %s", lua_tostring(vm, -1));
+        return false;
+    }
+    lua_getglobal(vm, "_draw");
+    if (lua_pcall(vm, 0, 0, 0) != LUA_OK)
+    {
+        SDL_Log("Lua error: %s", lua_tostring(vm, -1));
+        return false;
+    }
+    return true;
+}
+
+// Checks that a cart whose own code does not allocate gets through its frames
+// without a single allocation once warmed up, i.e. that the API calls it makes
+// do not allocate behind the scenes.
+static int test_frame_allocations(void)
+{
+    static const char cart[] =
+        "entities = { { x = 0 }, { x = 1 }, { x = 2 } }\n"
+        "function move(e) e.x -= 1 end\n"
+        "co = cocreate(function() while true do yield() end end)\n"
+        "x = 0\n"
+        "function _update()\n"
+        "  x = (x + 1) % 128\n"
+        "  if btn(0) then x -= 1 end\n"
+        "  if btnp(5) then x += 1 end\n"
+        "  coresume(co)\n"
+        "  if costatus(co) == \"dead\" then x = 0 end\n"
+        "  for e in all(entities) do e.x += 1 end\n"
+        "  foreach(entities, move)\n"
+        "  add(entities, del(entities, entities[1]))\n"
+        "  x += count(entities) - 3\n"
+        "end\n"
+        "function _draw()\n"
+        "  cls(1)\n"
+        "  camera(x, 0)\n"
+        "  map(0, 0, 0, 0, 16, 16)\n"
+        "  for i = 0, 15 do spr(i, i * 8, x) end\n"
+        "  camera()\n"
+        "  pal(1, 2)\n"
+        "  rectfill(0, 0, 127, 8, 0)\n"
+        "  circfill(64, 64, 8, 7)\n"
+        "  line(0, 0, x, 127, 8)\n"
+        "  pal()\n"
+        "  print(\"score\", 1, 1, 7)\n"
+        "  print(x, 40, 1, 7)\n"
+        "  print(x / 3, 60, 1, 7)\n"
+        "  print(stat(0), 80, 1)\n"
+        "  poke(0x5f00, peek(0x5f00))\n"
+        "  pset(x, x, sin(x / 128) + cos(x / 128) + flr(rnd(4)) + mid(0, x, 1))\n"
+        "end\n";
+    pool_t pool;
+    int failed = 0;
+
+    init_pool(&pool);
+    lua_State* vm = lua_newstate(pool_allocator, &pool);
+    if (!vm)
+    {
+        return check(false, "frame allocations state");
+    }
+    lua_setpico8memory(vm, pico8_ram);
+    luaL_openlibs(vm);
+    init_api(vm);
+
+    bool ok = luaL_dostring(vm, cart) == LUA_OK;
+    for (int i = 0; ok && i < 3; i++)
+    {
+        ok = call_frame(vm);
+    }
+
+    // Collect between frames, as the frame loop does, so that nothing the
+    // API merely recreates each frame survives from one frame to the next.
+    uint32_t allocations = 0;
+    for (int i = 0; ok && i < 30; i++)
+    {
+        lua_gc(vm, LUA_GCCOLLECT, 0);
+        uint32_t before = count_allocations(&pool);
+        ok = call_frame(vm);
+        allocations += count_allocations(&pool) - before;
+    }
+
+    if (allocations)
+    {
+        SDL_Log("%u allocations in 30 frames", allocations);
+    }
+    failed += check(ok && allocations == 0, "frames do not allocate");
+
+    lua_close(vm);
+    destroy_pool(&pool);
+    return failed;
+}
+
+typedef struct
+{
+    const char* data;
+    size_t size;
+
+} byte_reader_t;
+
+// Hands the source over one byte at a time, so that no token is ever whole
+// in the buffer the lexer scans.
+static const char* read_byte(lua_State* vm, void* ud, size_t* size)
+{
+    byte_reader_t* reader = (byte_reader_t*)ud;
+    (void)vm;
+
+    if (reader->size == 0)
+    {
+        *size = 0;
+        return NULL;
+    }
+    reader->size--;
+    *size = 1;
+    return reader->data++;
+}
+
+static int hash_dump(lua_State* vm, const void* p, size_t size, void* ud)
+{
+    uint32_t* hash = (uint32_t*)ud;
+    const uint8_t* data = (const uint8_t*)p;
+    (void)vm;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        *hash = (*hash ^ data[i]) * 0x01000193;
+    }
+    return 0;
+}
+
+// Compiles source whole and byte by byte; returns the hash of the bytecode or
+// 0 and the error message through message.
+static uint32_t compile_hash(lua_State* vm, const char* source, bool whole, char* message, size_t length)
+{
+    byte_reader_t reader = { source, SDL_strlen(source) };
+    uint32_t hash = 0x811c9dc5;
+    int status = whole
+        ? luaL_loadbuffer(vm, source, reader.size, "chunk")
+        : lua_load(vm, read_byte, &reader, "chunk", NULL);
+
+    if (status != LUA_OK)
+    {
+        SDL_strlcpy(message, lua_tostring(vm, -1), length);
+        lua_pop(vm, 1);
+        return 0;
+    }
+    lua_dump(vm, hash_dump, &hash);
+    lua_pop(vm, 1);
+    return hash;
+}
+
+// Checks that the lexer gives the same tokens whether it scans them straight
+// from the source or has to put them together across reads.
+static int test_chunked_source(void)
+{
+    static const char source[] =
+        "local a_rather_long_name_that_is_not_a_short_string_any_more = 1\r\n"
+        "local name, n2 = \"str\\\"ing\\n\\x41\\65\\z\n   end\", 'x'\n"
+        "local long = [==[\nline ]] ]=] 1\nline 2]==]\n"
+        "-- comment\n"
+        "--[[ long\ncomment ]] // another comment\n"
+        "\t  \t if name ~= long then n2 = 0x1f + 0b101 + .5 + 1.25 end\n"
+        "function f(...) return a_rather_long_name_that_is_not_a_short_string_any_more, ... end\n"
+        "return f(name, n2, long) -- no newline at the end";
+    static const char broken[] = "x = 1\nfoo bar baz";
+    char whole_message[256] = "";
+    char chunked_message[256] = "";
+    int failed = 0;
+
+    lua_State* vm = luaL_newstate();
+    if (!vm)
+    {
+        return check(false, "chunked source state");
+    }
+
+    uint32_t whole = compile_hash(vm, source, true, whole_message, sizeof(whole_message));
+    uint32_t chunked = compile_hash(vm, source, false, chunked_message, sizeof(chunked_message));
+    failed += check(whole && whole == chunked, "chunked source compiles the same");
+
+    compile_hash(vm, broken, true, whole_message, sizeof(whole_message));
+    compile_hash(vm, broken, false, chunked_message, sizeof(chunked_message));
+    failed += check(SDL_strstr(whole_message, "near 'bar'")
+        && SDL_strcmp(whole_message, chunked_message) == 0, "chunked source errors the same");
+
+    lua_close(vm);
+    return failed;
+}
+
+static int interrupted_line;
+
+static void interrupt_hook(lua_State* L, lua_Debug* ar)
+{
+    lua_getinfo(L, "l", ar);
+    interrupted_line = ar->currentline;
+    lua_sethook(L, NULL, 0, 0);
+    luaL_error(L, "interrupted!");
+}
+
+static int set_hook_later(void* data)
+{
+    SDL_Delay(10);
+    lua_sethook((lua_State*)data, interrupt_hook, LUA_MASKCALL | LUA_MASKRET | LUA_MASKCOUNT, 1);
+    return 0;
+}
+
+// Checks that a hook set from another thread while a loop runs, as lua.c
+// does on Ctrl+C, is noticed at the loop's backward jump and not only when
+// the loop is over. This loop only jumps back from its condition; it ends
+// by itself after 2^28 steps.
+static int test_async_hook(void)
 {
     lua_State* vm = luaL_newstate();
     if (!vm)
+    {
+        return check(false, "async hook state");
+    }
+
+    int status = luaL_loadstring(vm, "local a = 0x7000\nrepeat a += 0x0.0001 until a < 0\nreturn a");
+    if (status == LUA_OK)
+    {
+        SDL_Thread* thread = SDL_CreateThread(set_hook_later, "hook", vm);
+        status = lua_pcall(vm, 0, 0, 0);
+        SDL_WaitThread(thread, NULL);
+    }
+    const char* message = lua_tostring(vm, -1);
+    int failed = check(status == LUA_ERRRUN && message && SDL_strstr(message, "interrupted!")
+        && interrupted_line == 2,
+        "hook set meanwhile stops a loop");
+
+    lua_close(vm);
+    return failed;
+}
+
+// Sets up a VM for a cart the way init_vm does, or with every standard
+// library if 'full' is set.
+static lua_State* new_cart_vm(pool_t* pool, bool full)
+{
+    init_pool(pool);
+    lua_State* vm = lua_newstate(pool_allocator, pool);
+    if (vm)
+    {
+        lua_setpico8memory(vm, pico8_ram);
+        if (full)
+        {
+            luaL_openlibs(vm);
+        }
+        else
+        {
+            luaL_opencartlibs(vm, VM_GLOBALS);
+        }
+        init_api(vm);
+    }
+    return vm;
+}
+
+// Checks that carts only see PICO-8's builtins, and that leaving out the
+// rest of the standard library makes the VM smaller.
+static int test_cart_libs(void)
+{
+    static const char cart[] =
+        "for name in all(split('io,os,debug,package,string,table,coroutine,"
+        "dofile,loadfile,load,collectgarbage,pcall,error,_VERSION')) do\n"
+        "  assert(_ENV[name] == nil, name)\n"
+        "end\n"
+        "assert(_G == _ENV and tostring(1) == '1' and type(sub) == 'function')\n"
+        "local n = 0 for k, v in pairs({1, 2}) do n += v end assert(n == 3)\n"
+        "assert(getmetatable(setmetatable({}, {x = 1})).x == 1)\n";
+    pool_t full_pool;
+    pool_t cart_pool;
+    int failed = 0;
+
+    lua_State* full = new_cart_vm(&full_pool, true);
+    lua_State* vm = new_cart_vm(&cart_pool, false);
+    if (!full || !vm)
+    {
+        if (full)
+        {
+            lua_close(full);
+        }
+        if (vm)
+        {
+            lua_close(vm);
+        }
+        destroy_pool(&full_pool);
+        destroy_pool(&cart_pool);
+        return check(false, "cart libs state");
+    }
+
+    lua_gc(full, LUA_GCCOLLECT, 0);
+    lua_gc(vm, LUA_GCCOLLECT, 0);
+    SDL_Log("cart libs: %u bytes, all libs: %u bytes",
+        (unsigned)cart_pool.used, (unsigned)full_pool.used);
+    failed += check(cart_pool.used < full_pool.used, "cart libs use less memory");
+
+    bool ok = luaL_dostring(vm, cart) == LUA_OK;
+    if (!ok)
+    {
+        SDL_Log("%s", lua_tostring(vm, -1));
+    }
+    failed += check(ok, "cart libs hide the standard library");
+
+    lua_close(full);
+    lua_close(vm);
+    destroy_pool(&full_pool);
+    destroy_pool(&cart_pool);
+    return failed;
+}
+
+// Checks that run() unwinds the cart and that restarting it runs the kept
+// main chunk again on pristine globals, without loading it anew.
+static int test_run_restart(void)
+{
+    static const char cart[] =
+        "runs = (runs or 0) + 1\n"
+        "function count() return runs end\n";
+    pool_t pool;
+    int failed = 0;
+
+    lua_State* vm = new_cart_vm(&pool, false);
+    if (!vm)
+    {
+        destroy_pool(&pool);
+        return check(false, "run state");
+    }
+
+    save_base_globals(vm);
+    bool ok = luaL_loadstring(vm, cart) == LUA_OK && call_main_chunk(vm) == LUA_OK;
+    failed += check(ok && luaL_dostring(vm, "assert(count() == 1) runs = 5 leftover = 1") == LUA_OK,
+        "main chunk runs");
+
+    pico8_run_requested = false;
+    failed += check(luaL_dostring(vm, "run() leftover = 2") != LUA_OK && pico8_run_requested,
+        "run() unwinds the cart");
+    lua_settop(vm, 0);
+
+    for (int i = 0; i < 2; i++)
+    {
+        ok = restart_main_chunk(vm) == LUA_OK;
+        if (!ok)
+        {
+            SDL_Log("%s", lua_tostring(vm, -1));
+        }
+        failed += check(ok && luaL_dostring(vm,
+            "assert(count() == 1 and runs == 1 and leftover == nil and _G.count == count)") == LUA_OK,
+            "restart starts from the first globals");
+        lua_settop(vm, 0);
+        luaL_dostring(vm, "runs = 7 leftover = 3");
+    }
+    pico8_run_requested = false;
+
+    lua_close(vm);
+    destroy_pool(&pool);
+    return failed;
+}
+
+// Checks a single value: its decimal form matches what "%1.4f" prints, it
+// parses back to the nearest value, and its hex form parses back exactly.
+static bool check_number(fix32_t x)
+{
+    char text[LUAI_MAXNUMBER2STR];
+    char expected[32];
+    char hex[16];
+    fix32_t parsed;
+
+    int len = lua_number2str(text, x);
+    int n = SDL_snprintf(expected, sizeof(expected), "%1.4f", x / 65536.0);
+    while (n > 0 && expected[n - 1] == '0')
+    {
+        expected[--n] = '\0';
+    }
+    if (n > 0 && expected[n - 1] == '.')
+    {
+        expected[--n] = '\0';
+    }
+    if (len != n || SDL_strcmp(text, expected) != 0)
+    {
+        return false;
+    }
+
+    double value = SDL_strtod(text, NULL);
+    double scaled = SDL_floor(SDL_fabs(value) * 65536.0 + 0.5);
+    fix32_t nearest = (fix32_t)(uint32_t)(int64_t)(value < 0 ? -scaled : scaled);
+    if (!lua_string2number(text, len, &parsed) || parsed != nearest)
+    {
+        return false;
+    }
+
+    uint32_t bits = (uint32_t)x;
+    n = SDL_snprintf(hex, sizeof(hex), "0x%04x.%04x", bits >> 16, bits & 0xffff);
+    return lua_string2number(hex, n, &parsed) && parsed == x;
+}
+
+// Checks the integer-only number parser and formatter against the C library.
+// The full run covers all 2^32 values and takes a while, so by default only
+// every fraction around zero and a spread of the other values are checked.
+static int test_number_conversion(bool exhaustive)
+{
+    static const struct
+    {
+        const char* text;
+        fix32_t value;
+
+    } literals[] = {
+        { "0.1", 0x0000199a },
+        { "-0.1", (fix32_t)0xffffe666 },
+        { "  1.5e2 ", 0x00960000 },
+        { "25e-3", 0x00000666 },
+        { ".999995", 0x00010000 },
+        { "32768", (fix32_t)0x80000000 },
+        { "65537.25", 0x00014000 },
+        { "0.00000762939453125", 0x00000001 },
+        { "0.0000076293945312", 0x00000000 },
+    };
+    int failed = 0;
+
+    for (size_t i = 0; i < SDL_arraysize(literals); i++)
+    {
+        fix32_t parsed;
+        bool ok = lua_string2number(literals[i].text, SDL_strlen(literals[i].text), &parsed)
+            && parsed == literals[i].value;
+        if (!ok)
+        {
+            SDL_Log("  '%s' parsed as 0x%08x", literals[i].text, (uint32_t)parsed);
+        }
+        failed += check(ok, "number literal");
+    }
+
+    uint32_t mismatches = 0;
+    for (uint64_t bits = 0; bits <= UINT32_MAX; )
+    {
+        if (!check_number((fix32_t)(uint32_t)bits) && mismatches++ < 8)
+        {
+            SDL_Log("  0x%08x converts wrongly", (uint32_t)bits);
+        }
+        bits += (exhaustive || bits < 0x10000 || bits >= 0xffff0000) ? 1 : 0x10001;
+    }
+    failed += check(mismatches == 0, "number conversion round trip");
+
+    return failed;
+}
+
+int main(int argc, char* argv[])
+{
+    int failed = test_decompression();
+    failed += test_text_cart();
+    failed += test_cart_cache();
+    failed += test_heap_limit();
+    failed += test_heap_limit_slabs();
+    failed += test_frame_allocations();
+    failed += test_chunked_source();
+    failed += test_cart_libs();
+    failed += test_run_restart();
+    failed += test_async_hook();
+    failed += test_number_conversion(argc > 1 && SDL_strcmp(argv[1], "--long") == 0);
+
+    pool_t pool;
+    init_pool(&pool);
+    lua_State* vm = lua_newstate(pool_allocator, &pool);
+    if (!vm)
     {
         SDL_Log("Couldn't create Lua state.");
         return EXIT_FAILURE;
     }
-    lua_setpico8memory(vm, ram);
+    lua_setpico8memory(vm, pico8_ram);
     luaL_openlibs(vm);
     init_api(vm);
 
@@ -41,6 +850,7 @@ int main()
         {
             lua_pop(vm, 1);
             lua_close(vm);
+            destroy_pool(&pool);
             return EXIT_FAILURE;
         }
     }
@@ -51,6 +861,7 @@ int main()
 
     lua_pop(vm, 1);
     lua_close(vm);
+    destroy_pool(&pool);
 
-    return EXIT_SUCCESS;
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
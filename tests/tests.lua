@@ -144,6 +144,36 @@ function test_relational_operations()
     assert_true(4 > 3, "4 > 3")
     assert_true(3 <= 3, "3 <= 3")
     assert_true(4 >= 3, "4 >= 3")
+
+    -- Register against constant, on either side.
+    local x = 3
+    assert_true(x == 3 and 3 == x, "x == 3")
+    assert_false(x ~= 3 or 3 ~= x, "x ~= 3")
+    assert_true(x < 4 and 2 < x, "x < 4, 2 < x")
+    assert_false(x < 3 or 3 < x, "x < 3, 3 < x")
+    assert_true(x <= 3 and 3 <= x, "x <= 3, 3 <= x")
+    assert_true(x > 2 and 4 > x, "x > 2, 4 > x")
+    assert_true(x >= 3 and 3 >= x, "x >= 3, 3 >= x")
+    assert_equal(x + 1, 4, "x + 1")
+    assert_equal(x - 1, 2, "x - 1")
+    assert_equal(x * 2, 6, "x * 2")
+    assert_false(x == "3", "x == \"3\"")
+
+    local s = "play"
+    assert_true(s == "play" and "menu" ~= s, "s == \"play\"")
+    assert_true(s < "z" and "a" < s, "s < \"z\", \"a\" < s")
+
+    -- Metamethods see the operands in source order.
+    local order = ""
+    local v = setmetatable({}, { __lt = function(a, b)
+        order ..= type(a) .. " "
+        return type(a) == "number"
+    end })
+    assert_true(1 < v, "1 < v")
+    assert_false(v < 1, "v < 1")
+    assert_false(v <= 1, "v <= 1")
+    assert_true(1 <= v, "1 <= v")
+    assert_true(order == "number table number table ", "comparison order")
 end
 
 -- Logical operations.
@@ -179,6 +209,28 @@ function test_control_flow()
         sum = sum + i
     end
     assert_equal(sum, 6, "for loop")
+
+    local step = 2
+    local total = 0
+    for i = 1, 3 do
+        if i == 1 then total += step elseif i == 2 then total -= 1 else total *= step end
+    end
+    assert_equal(total, 2, "compound assignment in if chain")
+
+    if (total > 0) total = step + 1
+    assert_equal(total, 3, "short if")
+
+    local k = 10
+    local function bump() k += 1 end
+    bump()
+    assert_equal(k + 1, 12, "local assigned by a closure")
+
+    local s = "a"
+    s ..= "b"
+    assert_string_equal(s, "ab", "concatenation assignment")
+
+    local function pick(c) if c then return 1 else return 2 end end
+    assert_equal(pick(true) + pick(false), 3, "if-else returns")
 end
 
 -- Co-Routines.
@@ -294,6 +346,36 @@ function test_coroutines()
         "dead",
         "status after error"
     )
+
+    -- recycled threads start afresh and never take over live handles.
+    local failed = co
+    local finished = cocreate(function() return 1 end)
+    coresume(finished)
+
+    local sum = 0
+    for i = 1, 50 do
+        local c = cocreate(function(x)
+            local y = yield(x * 2)
+            return x + y
+        end)
+        local _, doubled = coresume(c, i)
+        local _, added = coresume(c, 1)
+        sum += doubled + added
+        if i % 10 == 0 then
+            collectgarbage()
+        end
+    end
+
+    assert_equal(sum, 3875, "recycled coroutines")
+
+    co = cocreate(function(...) return select("#", ...) end)
+    ok,a = coresume(co)
+    assert_equal(a, 0, "recycled coroutine starts with an empty stack")
+
+    assert_string_equal(costatus(failed), "dead", "failed coroutine stays dead")
+    assert_string_equal(costatus(finished), "dead", "finished coroutine stays dead")
+    ok,msg = coresume(finished)
+    assert_false(ok, "finished coroutine cannot resume")
 end
 
 -- Graphics.
@@ -339,6 +421,20 @@ function test_graphics()
 
     local crc = crc32(0x6000, 0x2000);
     assert_equal(0x440c2f00, crc, "Graphics, CRC")
+
+    -- pcall() goes through the regular entry point of a builtin, a plain
+    -- call with number arguments through the direct one.
+    pset(3, 3, 7)
+    local _, color = pcall(pget, 3, 3)
+    assert_equal(color, 7, "pget, regular entry")
+    assert_equal(pget(3, 3), 7, "pget, direct entry")
+    local _, flag = pcall(fget, 1, 0)
+    assert_true(flag == fget(1, 0), "fget, both entries")
+    local _, pressed = pcall(btn, 0)
+    assert_true(pressed == btn(0), "btn, both entries")
+    local _, mask = pcall(btnp)
+    assert_true(mask == btnp(), "btnp, both entries")
+    assert_true(pack(pset(0, 0)).n == 0, "pset, no result")
 end
 
 -- Math.
@@ -488,6 +584,41 @@ function test_memory()
     assert_equal(peek2(0x6040), 0xf9f9, "memset(0x6040, 0xf9, 0x1fc0)")
     memcpy(0x6000,0x6040,0x1fc0)
     assert_equal(peek2(0x6000), 0xf9f9, "memcpy(0x6000, 0x6040, 0x1fc0)")
+
+    poke(0x4300, 0x12, 0x34)
+    local addr = 0x4300
+    assert_equal(@0x4300, 0x12, "@0x4300")
+    assert_equal(%addr, 0x3412, "%addr, constant local")
+
+    poke(0x4300, 0x1ff)
+    assert_equal(peek(0x4300), 0xff, "poke(0x4300, 0x1ff)")
+    poke2(0x4300, 0x1234)
+    assert_equal(peek(0x4300), 0x12, "poke2(0x4300, 0x1234)")
+    assert_equal(peek2(0x4300), 0x1234, "peek2 after poke2")
+    poke4(0x4300, 0x1234)
+    assert_equal(peek(0x4302), 0x12, "poke4(0x4300, 0x1234)")
+    assert_equal(peek(0x4303), 0x34, "poke4(0x4300, 0x1234)")
+    poke(0x7fff, 0)
+    poke2(0x7fff, 0xffff)
+    assert_equal(peek(0x7fff), 0, "poke2(0x7fff, 0xffff) is clipped")
+    assert_equal(poke(0x4300, 1), nil, "poke returns nothing")
+
+    local builtin = poke
+    local poked = nil
+    poke = function(a, v) poked = v end
+    poke(0x4300, 2)
+    poke = builtin
+    assert_equal(poked, 2, "reassigned poke is called")
+    assert_equal(peek(0x4300), 1, "reassigned poke does not store")
+
+    collectgarbage("stop")
+    local used = stat(0)
+    heap_probe = {}
+    for i = 1, 1000 do heap_probe[i] = {} end
+    assert_equal(stat(0) > used, true, "stat(0) grows with the heap")
+    assert_equal(stat(0) > 16 and stat(0) < 2048, true, "stat(0) is in KB")
+    heap_probe = nil
+    collectgarbage("restart")
 end
 
 -- Operators.
@@ -563,6 +694,12 @@ function test_strings()
     assert_string_equal(test, "hi", "sub(s,-4,-3)")
     test = sub(s,-2,nil) -- Get the last two characters.
     assert_string_equal(test, "ng", "sub(s,-2,nil)")
+    assert_string_equal(sub(s,5,3), "", "sub(s,5,3)")
+    assert_string_equal(sub(s,20), "", "sub(s,20)")
+    assert_string_equal(sub(s,9,9), "g", "sub(s,9,9)")
+    assert_equal(ord("a"), 97, "ord(\"a\")")
+    assert_equal(ord(s, 2), 111, "ord(s,2)")
+    assert_equal(ord(s, 10), nil, "ord(s,10)")
 
     local str = "a,b,c"
 
@@ -592,6 +729,69 @@ function test_strings()
 
     t = split("ab", 1)
     assert_table_equal(t, { "a", "b" }, "split by N=1")
+
+    t = split("0.5,-2,0x10, 1e2")
+    assert_table_equal(t, { 0.5, -2, 16, 100 }, "split converts like tonum")
+
+    t = split("1.2.3", ".")
+    assert_table_equal(t, { 1, 2, 3 }, "split('.')")
+
+    t = split("102", "0")
+    assert_table_equal(t, { 1, 2 }, "split('0')")
+
+    t = split("1234", 2)
+    assert_table_equal(t, { 12, 34 }, "split by N=2")
+
+    t = split("a::b::c", "::")
+    assert_table_equal(t, { "a", "b", "c" }, "split('::')")
+
+    assert_equal(0.1, 0x0.199a, "0.1 rounds to nearest")
+    assert_equal(tonum("-0.1"), 0xffff.e666, "tonum rounds to nearest")
+    assert_string_equal(tostr(0.1, true), "0x0000.199a", "tostr(0.1, true)")
+    assert_string_equal(tostr(-1.5), "-1.5", "tostr(-1.5)")
+    assert_string_equal(tostr(1/3), "0.3333", "tostr(1/3)")
+    assert_string_equal(tostr(0x0.ffff), "1", "tostr rounds up into the integer part")
+
+    assert_string_equal("" .. 5, "5", "\"\" .. 5")
+    assert_string_equal(5 .. "", "5", "5 .. \"\"")
+    assert_string_equal(1 .. 2, "12", "1 .. 2")
+    assert_string_equal("x" .. -1.5 .. "y" .. 0x0.8, "x-1.5y0.5", "concat numbers")
+    local long = ""
+    for i = 1, 20 do long = long .. i .. "," end
+    assert_string_equal(long, "1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,", "concat long")
+    local keys = { [long] = true }
+    assert_equal(keys["1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,"], true, "concat long key")
+
+    -- Appending in place must never show through another reference.
+    local s = ""
+    for i = 1, 200 do s = s .. "x" end
+    assert_equal(#s, 200, "append in place")
+    local copy = s
+    s = s .. "y"
+    assert_equal(#copy, 200, "append keeps a local copy")
+    local held, up = {}, s
+    local function get() return up end
+    for i = 1, 20 do
+        s = s .. "z"
+        held[i] = s
+        up = s
+    end
+    assert_true(#held[1] == 202 and #held[20] == 221 and #get() == 221, "append keeps stored copies")
+    local function pass(x) return x end
+    local back = pass(s)
+    s = s .. "w"
+    assert_true(#back == 221 and #s == 222, "append keeps returned copies")
+    s = s .. s
+    assert_true(#s == 444 and sub(s, 223, 224) == "xx", "append to itself")
+    keys[s] = 1
+    local key = s
+    s = s .. "v"
+    assert_true(keys[key] == 1 and keys[s] == nil, "append keeps table keys")
+    local co = cocreate(function(x) while true do x = yield(#x) end end)
+    local _, n = coresume(co, s)
+    s = s .. "u"
+    local _, m = coresume(co, s)
+    assert_true(n == 445 and m == 446, "append across coroutines")
 end
 
 -- Tables.
@@ -625,6 +825,27 @@ function test_tables()
     assert_equal(tbl[1], 0x11, "tbl[1] == 0x11")
     assert_equal(tbl[2], 0x44, "tbl[2] == 0x44")
 
+    tbl = {1, 2, 3, 2, 4}
+    assert_equal(del(tbl, 2), 2, "del(tbl, 2) returns the value")
+    assert_equal(#tbl, 4, "del(tbl, 2) shortens tbl")
+    assert_equal(tbl[2], 3, "del(tbl, 2) shifts the rest down")
+    assert_equal(tbl[3], 2, "del(tbl, 2) removes the first match only")
+    assert_equal(tbl[5], nil, "del(tbl, 2) clears the last slot")
+    assert_equal(del(tbl, 9), nil, "del(tbl, 9) without a match")
+    assert_equal(count(tbl), 4, "count(tbl)")
+    assert_equal(count(tbl, 2), 1, "count(tbl, 2)")
+    assert_equal(count(tbl, 9), 0, "count(tbl, 9)")
+
+    -- The same through the hash part.
+    tbl = {[1] = 2, [2] = 4, [3] = 6, [4] = 8, [5] = 10, [6] = 12, [7] = 14, [8] = 16}
+    del(tbl, 6)
+    assert_equal(#tbl, 7, "del from hash part shortens tbl")
+    assert_equal(tbl[3], 8, "del from hash part shifts the rest down")
+    assert_equal(tbl[8], nil, "del from hash part clears the last slot")
+    add(tbl, 6)
+    assert_equal(tbl[8], 6, "add to hash part appends")
+    assert_equal(count(tbl, 6), 1, "count(tbl, 6) through hash part")
+
     tbl = {}
     tbl = { 1, 3, 5 }
     local tmp = 1 + 3 + 5
@@ -668,6 +889,33 @@ function test_tables()
         n += 1
     end
 
+    -- Deleting the current element during foreach() skips nothing.
+    tbl = {1, 2, 3, 4}
+    local seen = {}
+    foreach(tbl, function(v)
+        add(seen, v)
+        if v == 2 then del(tbl, v) end
+    end)
+    assert_equal(#seen, 4, "foreach mutation: length")
+    assert_equal(seen[3], 3, "foreach mutation: value after del")
+
+    -- all() and foreach() allocate nothing once warmed up.
+    tbl = {1, 2, 3, 4, 5, 6, 7, 8}
+    local total = 0
+    local function add_to_total(v) total += v end
+    for v in all(tbl) do total += v end
+    foreach(tbl, add_to_total)
+    collectgarbage("stop")
+    local kb, b = collectgarbage("count")
+    for i = 1, 100 do
+        for v in all(tbl) do total += v end
+        foreach(tbl, add_to_total)
+    end
+    local kb2, b2 = collectgarbage("count")
+    collectgarbage("restart")
+    assert_true(kb == kb2 and b == b2, "all() and foreach() allocate nothing")
+    assert_equal(total, 202 * 36, "all() and foreach() sum")
+
     tbl = {}
 
     -- inext and ipairs tests.
@@ -894,6 +1142,42 @@ function test_tables()
     setmetatable(t3, nil)
 
     assert_true(t3.missing == nil, "metatable removed")
+
+    -- Constant keys are cached per function; the cache must follow
+    -- rehashes, removals and metatable changes.
+
+    local function get_k(t) return t.k end
+
+    local t4 = {k = 1}
+    assert_equal(get_k(t4), 1, "cached key")
+    for i = 1, 20 do t4["x" .. i] = i end
+    assert_equal(get_k(t4), 1, "cached key after rehash")
+    assert_equal(get_k({a = 0, b = 0, k = 2}), 2, "cached key, other table")
+    t4.k = nil
+    assert_true(get_k(t4) == nil, "cached key removed")
+    setmetatable(t4, {__index = {k = 3}})
+    assert_equal(get_k(t4), 3, "cached key from __index")
+    t4.k = 4
+    assert_equal(get_k(t4), 4, "cached key shadows __index")
+    setmetatable(t4, {__index = function() return 5 end})
+    t4.k = nil
+    assert_equal(get_k(t4), 5, "cached key from __index function")
+
+    -- Integer keys in the array part take a shortcut that must still
+    -- defer to __index and __newindex for empty slots.
+
+    local t5 = {1, 2, 3}
+    t5[2] = nil
+    local i = 2
+    assert_true(t5[i] == nil, "empty array slot")
+    setmetatable(t5, {__index = function(t, k) return k * 10 end,
+                      __newindex = function(t, k, v) rawset(t, k, v + 1) end})
+    assert_equal(t5[i], 20, "__index for empty array slot")
+    assert_equal(t5[i + 0.5], 25, "__index for fractional key")
+    t5[i] = 7
+    assert_equal(t5[i], 8, "__newindex for empty array slot")
+    t5[i] = 7
+    assert_equal(t5[i], 7, "no __newindex for used array slot")
 end
 
 -- Palette transparency (palt).